@@ -0,0 +1,101 @@
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<std::uint64_t> g_allocs{0};
+
+std::uint64_t bench_alloc_count(){
+    return g_allocs.load(std::memory_order_relaxed);
+}
+
+void* operator new(std::size_t n){
+    g_allocs.fetch_add(1,std::memory_order_relaxed);
+    if(n == 0) n = 1;
+    if(void* p = std::malloc(n))return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n){
+    return ::operator new(n);
+}
+
+void operator delete(void* p) noexcept{
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept{
+    std::free(p);
+}
+
+void operator delete(void* p,std::size_t) noexcept{
+    std::free(p);
+}
+
+void operator delete[](void* p,std::size_t) noexcept{
+    std::free(p);
+}
+
+// Types such as HotFields are over-aligned, so their allocations take these overloads.
+void* operator new(std::size_t n,std::align_val_t al){
+    g_allocs.fetch_add(1,std::memory_order_relaxed);
+    const auto a = static_cast<std::size_t>(al);
+    if(n == 0) n = 1;
+    // aligned_alloc wants the size to be a multiple of the alignment.
+    if(void* p = std::aligned_alloc(a,(n + a - 1) / a * a))return p;
+    throw std::bad_alloc();
+}
+
+void* operator new[](std::size_t n,std::align_val_t al){
+    return ::operator new(n,al);
+}
+
+void operator delete(void* p,std::align_val_t) noexcept{
+    std::free(p);
+}
+
+void operator delete[](void* p,std::align_val_t) noexcept{
+    std::free(p);
+}
+
+void operator delete(void* p,std::size_t,std::align_val_t) noexcept{
+    std::free(p);
+}
+
+void operator delete[](void* p,std::size_t,std::align_val_t) noexcept{
+    std::free(p);
+}
+
+void* operator new(std::size_t n,const std::nothrow_t&) noexcept{
+    try{ return ::operator new(n); }
+    catch(...){ return nullptr; }
+}
+
+void* operator new[](std::size_t n,const std::nothrow_t&) noexcept{
+    return ::operator new(n,std::nothrow);
+}
+
+void* operator new(std::size_t n,std::align_val_t al,const std::nothrow_t&) noexcept{
+    try{ return ::operator new(n,al); }
+    catch(...){ return nullptr; }
+}
+
+void* operator new[](std::size_t n,std::align_val_t al,const std::nothrow_t&) noexcept{
+    return ::operator new(n,al,std::nothrow);
+}
+
+void operator delete(void* p,const std::nothrow_t&) noexcept{
+    std::free(p);
+}
+
+void operator delete[](void* p,const std::nothrow_t&) noexcept{
+    std::free(p);
+}
+
+void operator delete(void* p,std::align_val_t,const std::nothrow_t&) noexcept{
+    std::free(p);
+}
+
+void operator delete[](void* p,std::align_val_t,const std::nothrow_t&) noexcept{
+    std::free(p);
+}
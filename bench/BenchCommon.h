@@ -0,0 +1,175 @@
+
+#ifndef BANK_ACCOUNT_BENCH_COMMON_H
+#define BANK_ACCOUNT_BENCH_COMMON_H
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <linux/perf_event.h>
+#include <malloc.h>
+#include <sys/ioctl.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "Account.h"
+#include "Utils.h"
+
+// Defined in BenchAlloc.cpp, which replaces the global operator new.
+std::uint64_t bench_alloc_count();
+
+using BenchClock = std::chrono::steady_clock;
+
+static inline std::uint64_t elapsed_ns(BenchClock::time_point a,BenchClock::time_point b){
+    return static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(b - a).count());
+}
+
+static inline long peak_rss_kb(){
+    rusage ru{};
+    getrusage(RUSAGE_SELF,&ru);
+    return ru.ru_maxrss;
+}
+
+// Resident set right now, after returning free heap pages to the kernel.
+static inline long current_rss_kb(){
+    malloc_trim(0);
+    long pages = 0,resident = 0;
+    if(std::FILE* f = std::fopen("/proc/self/statm","r")){
+        if(std::fscanf(f,"%ld %ld",&pages,&resident) != 2) resident = 0;
+        std::fclose(f);
+    }
+    return resident * (sysconf(_SC_PAGESIZE) / 1024);
+}
+
+
+// One hardware counter of the calling thread (user space only) via perf_event_open.
+// Valid() is false where the kernel or the container does not allow it.
+class PerfCounter{
+public:
+    PerfCounter(std::uint32_t type,std::uint64_t config){
+        perf_event_attr attr{};
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open,&attr,0,-1,-1,0));
+    }
+    ~PerfCounter(){ if(fd >= 0) close(fd); }
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    // Last-level cache misses and L1 data read misses.
+    static PerfCounter CacheMisses(){ return {PERF_TYPE_HARDWARE,PERF_COUNT_HW_CACHE_MISSES}; }
+    static PerfCounter L1dMisses(){
+        return {PERF_TYPE_HW_CACHE,PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                                   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16)};
+    }
+
+    [[nodiscard]] bool Valid()const{ return fd >= 0; }
+    void Start(){
+        if(fd < 0)return;
+        ioctl(fd,PERF_EVENT_IOC_RESET,0);
+        ioctl(fd,PERF_EVENT_IOC_ENABLE,0);
+    }
+    // Count since Start, or -1 when the counter is unavailable.
+    double Stop(){
+        if(fd < 0)return -1;
+        ioctl(fd,PERF_EVENT_IOC_DISABLE,0);
+        std::uint64_t v = 0;
+        return read(fd,&v,sizeof(v)) == static_cast<ssize_t>(sizeof(v)) ? static_cast<double>(v) : -1;
+    }
+
+private:
+    int fd{-1};
+};
+
+
+class ZipfGenerator{
+public:
+    ZipfGenerator(std::size_t n,double theta) : cdf(n){
+        double sum = 0;
+        for(std::size_t i=0; i<n; ++i){
+            sum += theta > 0 ? 1.0 / std::pow(static_cast<double>(i + 1),theta) : 1.0;
+            cdf[i] = sum;
+        }
+        for(auto& c : cdf) c /= sum;
+    }
+
+    template<class Rng>
+    std::size_t operator()(Rng& rng){
+        double u = std::uniform_real_distribution<double>(0.0,1.0)(rng);
+        auto it = std::lower_bound(cdf.begin(),cdf.end(),u);
+        if(it == cdf.end())return cdf.size() - 1;
+        return static_cast<std::size_t>(it - cdf.begin());
+    }
+
+private:
+    std::vector<double> cdf;
+};
+
+
+// Day counter -> Account::Date, starting at 01/01/2025.
+static inline Account::Date bench_date(int day){
+    int y = 2025, m = 1;
+    while(day >= days_in_month(m,y)){
+        day -= days_in_month(m,y);
+        if(++m > 12){ m = 1; ++y; }
+    }
+    return Account::Date{pad2(day + 1),pad2(m),std::to_string(y)};
+}
+
+
+struct BenchResult{
+    std::string name;
+    std::uint64_t ops{},ok{},failed{};
+    std::uint64_t ns{};
+    std::uint64_t allocs{};
+    std::vector<std::pair<std::string,double>> extra{};
+
+    void Add(bool success,std::uint64_t took_ns,std::uint64_t alloc_delta){
+        ++ops;
+        if(success) ++ok; else ++failed;
+        ns += took_ns;
+        allocs += alloc_delta;
+    }
+};
+
+static inline void write_json_results(std::FILE* out,const std::vector<std::pair<std::string,double>>& config,
+                                      const std::vector<BenchResult>& results,const std::string& metrics_json = {}){
+    std::fprintf(out,"{\n  \"config\": {");
+    for(std::size_t i=0; i<config.size(); ++i){
+        std::fprintf(out,"%s\n    \"%s\": %.17g",i ? "," : "",config[i].first.c_str(),config[i].second);
+    }
+    std::fprintf(out,"\n  },\n  \"results\": {");
+    for(std::size_t i=0; i<results.size(); ++i){
+        const BenchResult& r = results[i];
+        double ops = r.ops ? static_cast<double>(r.ops) : 1.0;
+        double secs = static_cast<double>(r.ns) / 1e9;
+        std::fprintf(out,"%s\n    \"%s\": {",i ? "," : "",r.name.c_str());
+        std::fprintf(out,"\"ops\": %llu, \"ok\": %llu, \"failed\": %llu, ",
+                     static_cast<unsigned long long>(r.ops),static_cast<unsigned long long>(r.ok),
+                     static_cast<unsigned long long>(r.failed));
+        std::fprintf(out,"\"ops_per_sec\": %.1f, \"ns_per_op\": %.1f, \"allocs_per_op\": %.3f",
+                     secs > 0 ? static_cast<double>(r.ops) / secs : 0.0,static_cast<double>(r.ns) / ops,
+                     static_cast<double>(r.allocs) / ops);
+        for(const auto& kv : r.extra){
+            std::fprintf(out,", \"%s\": %.17g",kv.first.c_str(),kv.second);
+        }
+        std::fprintf(out,"}");
+    }
+    std::fprintf(out,"\n  },\n  \"peak_rss_kb\": %ld",peak_rss_kb());
+    if(!metrics_json.empty()) std::fprintf(out,",\n  \"metrics\": %s",metrics_json.c_str());
+    std::fprintf(out,"\n}\n");
+}
+
+
+#endif //BANK_ACCOUNT_BENCH_COMMON_H
@@ -0,0 +1,2049 @@
+#include "Bank Management.h"
+#include "BenchCommon.h"
+#include "Metrics.h"
+#include "TransactionStream.h"
+#include "AccountPolicy.h"
+#include "Screening.h"
+#include "StandingOrders.h"
+#include "PartitionedBank.h"
+#include <atomic>
+#include <functional>
+#include <numeric>
+#include <set>
+#include <tuple>
+#include <unordered_set>
+#include <thread>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <unistd.h>
+#include <sstream>
+
+
+struct BenchConfig{
+    std::size_t accounts = 20000;
+    std::size_t ops = 200000;
+    // deposit, withdraw, transfer, close, ledger scan, serialization
+    double mix[6] = {35,25,30,1,6,3};
+    double zipf = 0.99;
+    double fail_rate = 0.05;
+    unsigned seed = 42;
+    std::vector<std::string> suites;
+    std::string out;
+    bool metrics = false;
+    std::size_t consumers = 4;
+    std::size_t ring = 1u << 16;
+    string stream_policy = "block";
+    std::size_t threads = std::max(1u,std::thread::hardware_concurrency());
+    std::size_t journal_records = 4000000;
+    std::size_t index_keys = 5000000;
+    std::size_t orders = 2000000;
+    std::size_t hot_accounts = 1000000;
+    std::size_t nodes = 2;
+    std::size_t fx_accounts = 50000000;
+};
+
+enum MixOp{MixDeposit,MixWithdraw,MixTransfer,MixClose,MixScan,MixSerialize,MixCount};
+
+static const char* const MixNames[MixCount] = {
+        "DepositAccount","WithdrawFromAccount","TransferBetweenAccounts","CloseAccount","LedgerScan","Serialize"
+};
+
+
+static void usage(){
+    std::fprintf(stderr,
+                 "usage: bank_bench [--accounts N] [--ops N] [--mix d,w,t,c,s,z] [--zipf THETA]\n"
+                 "                  [--fail RATE] [--seed N] [--suite NAME]... [--out FILE]\n"
+                 "                  [--metrics] [--consumers N] [--ring N] [--stream-policy block|drop|spill]\n"
+                 "                  [--threads N] [--journal-records N] [--index-keys N] [--orders N]\n"
+                 "                  [--hot-accounts N] [--nodes N] [--fx-accounts N]\n"
+                 "suites: mixed stream statements policies dedup velocity screening graph journal members checkpoint archive search payroll orders hotcold numa query fx\n");
+}
+
+static bool parse_args(int argc,char** argv,BenchConfig& cfg){
+    for(int i=1; i<argc; ++i){
+        std::string a = argv[i];
+        auto next = [&]()->const char*{
+            return i + 1 < argc ? argv[++i] : nullptr;
+        };
+        const char* v = nullptr;
+        if(a == "--help" || a == "-h")return false;
+        if(a == "--metrics"){
+            cfg.metrics = true;
+            continue;
+        }
+        if(!(v = next()))return false;
+        if(a == "--accounts") cfg.accounts = std::strtoull(v,nullptr,10);
+        else if(a == "--ops") cfg.ops = std::strtoull(v,nullptr,10);
+        else if(a == "--zipf") cfg.zipf = std::strtod(v,nullptr);
+        else if(a == "--fail") cfg.fail_rate = std::strtod(v,nullptr);
+        else if(a == "--seed") cfg.seed = static_cast<unsigned>(std::strtoul(v,nullptr,10));
+        else if(a == "--suite") cfg.suites.emplace_back(v);
+        else if(a == "--out") cfg.out = v;
+        else if(a == "--consumers") cfg.consumers = std::strtoull(v,nullptr,10);
+        else if(a == "--ring") cfg.ring = std::strtoull(v,nullptr,10);
+        else if(a == "--stream-policy") cfg.stream_policy = v;
+        else if(a == "--threads") cfg.threads = std::max<std::size_t>(1,std::strtoull(v,nullptr,10));
+        else if(a == "--journal-records") cfg.journal_records = std::strtoull(v,nullptr,10);
+        else if(a == "--index-keys") cfg.index_keys = std::strtoull(v,nullptr,10);
+        else if(a == "--orders") cfg.orders = std::strtoull(v,nullptr,10);
+        else if(a == "--nodes") cfg.nodes = std::max<std::size_t>(1,std::strtoull(v,nullptr,10));
+        else if(a == "--fx-accounts") cfg.fx_accounts = std::max<std::size_t>(1,std::strtoull(v,nullptr,10));
+        else if(a == "--hot-accounts") cfg.hot_accounts = std::max<std::size_t>(1,std::strtoull(v,nullptr,10));
+        else if(a == "--mix"){
+            std::stringstream ss(v);
+            std::string part;
+            for(double& m : cfg.mix){
+                if(!std::getline(ss,part,','))return false;
+                m = std::strtod(part.c_str(),nullptr);
+            }
+        }
+        else return false;
+    }
+    // IdCodes are at most 5 digits and every account gets its own member.
+    if(cfg.accounts < 2 || cfg.accounts > 99999){
+        std::fprintf(stderr,"--accounts must be in [2, 99999]\n");
+        return false;
+    }
+    return true;
+}
+
+static bool suite_enabled(const BenchConfig& cfg,const char* name){
+    if(cfg.suites.empty())return true;
+    return std::find(cfg.suites.begin(),cfg.suites.end(),name) != cfg.suites.end();
+}
+
+
+static string bench_id(std::size_t i){
+    string id = std::to_string(i + 1);
+    id.insert(0,5 - id.size(),'0');
+    return id;
+}
+
+static Person bench_person(std::size_t i){
+    Person p;
+    p.SetName("Bench",nullptr);
+    p.SetFamilyName("Owner",nullptr);
+    p.SetNationality("German",nullptr);
+    p.SetIdCode(bench_id(i),nullptr);
+    return p;
+}
+
+static Account::AccountType bench_type(std::size_t i){
+    switch (i % 3) {
+        case 0:return Account::AccountType::CheckingAccount;
+        case 1:return Account::AccountType::SavingAccount;
+        default:return Account::AccountType::FixedDepositAccount;
+    }
+}
+
+// Opens cfg.accounts accounts and returns their numbers in opening order.
+static std::vector<string> open_accounts(Management& bank,const BenchConfig& cfg,BenchResult* res){
+    std::vector<Person> people;
+    people.reserve(cfg.accounts);
+    for(std::size_t i=0; i<cfg.accounts; ++i) people.push_back(bench_person(i));
+
+    std::vector<string> numbers;
+    numbers.reserve(cfg.accounts);
+    const Account::Date date = bench_date(0);
+    string err;
+    for(std::size_t i=0; i<cfg.accounts; ++i){
+        std::uint64_t a0 = bench_alloc_count();
+        auto t0 = BenchClock::now();
+        bool ok = bank.OpenAccount(people[i],1000.0L,bench_type(i),date,&err);
+        auto t1 = BenchClock::now();
+        if(res) res->Add(ok,elapsed_ns(t0,t1),bench_alloc_count() - a0);
+        if(ok) numbers.push_back(bank.GetAccountsOf(people[i].GetIdCode())->back());
+    }
+    return numbers;
+}
+
+
+struct MixedOp{
+    MixOp op;
+    std::uint32_t a,b;
+    long double amount;
+    bool inject_failure;
+    int day;
+};
+
+static std::vector<MixedOp> generate_ops(const BenchConfig& cfg,std::size_t n_accounts){
+    std::mt19937_64 rng(cfg.seed);
+    ZipfGenerator zipf(n_accounts,cfg.zipf);
+    std::discrete_distribution<int> pick(std::begin(cfg.mix),std::end(cfg.mix));
+    std::bernoulli_distribution fail(cfg.fail_rate);
+    std::uniform_real_distribution<double> amount(1.0,200.0);
+
+    // Zipf ranks map to a shuffled account order so hot accounts are spread out.
+    std::vector<std::uint32_t> order(n_accounts);
+    for(std::size_t i=0; i<n_accounts; ++i) order[i] = static_cast<std::uint32_t>(i);
+    std::shuffle(order.begin(),order.end(),rng);
+
+    std::vector<MixedOp> ops(cfg.ops);
+    const std::size_t per_day = std::max<std::size_t>(1,cfg.ops / 365);
+    for(std::size_t i=0; i<cfg.ops; ++i){
+        MixedOp& m = ops[i];
+        m.op = static_cast<MixOp>(pick(rng));
+        m.a = order[zipf(rng)];
+        do{ m.b = order[zipf(rng)]; } while (m.b == m.a);
+        m.amount = std::round(amount(rng) * 100.0) / 100.0;
+        m.inject_failure = fail(rng);
+        m.day = static_cast<int>(i / per_day);
+    }
+    return ops;
+}
+
+// Runs the mixed workload. With a label only the aggregate result is reported;
+// attach is called on the bank after accounts are opened and before the timed loop,
+// after once the loop has finished.
+static void run_mixed(const BenchConfig& cfg,std::vector<BenchResult>& results,const char* label = nullptr,
+                      const std::function<void(Management&)>& attach = {},
+                      const std::function<void(Management&)>& after = {}){
+    Management bank;
+    BenchResult open{"OpenAccount"};
+    std::vector<string> numbers = open_accounts(bank,cfg,&open);
+    if(!label) results.push_back(open);
+    if(attach) attach(bank);
+
+    std::vector<MixedOp> ops = generate_ops(cfg,numbers.size());
+    std::vector<string> owners(numbers.size());
+    for(std::size_t i=0; i<owners.size(); ++i) owners[i] = bench_id(i);
+    std::vector<BenchResult> per_op(MixCount);
+    for(int i=0; i<MixCount; ++i) per_op[i].name = MixNames[i];
+
+    const string missing = "missing";
+    std::ostringstream sink;
+    string err;
+    long double checksum = 0;
+    int last_day = -1;
+    Account::Date date;
+
+    auto t_start = BenchClock::now();
+    for(const MixedOp& m : ops){
+        if(m.day != last_day){
+            date = bench_date(m.day);
+            last_day = m.day;
+        }
+        const string& a = m.inject_failure ? missing : numbers[m.a];
+        const string& b = numbers[m.b];
+        bool ok = false;
+
+        std::uint64_t a0 = bench_alloc_count();
+        auto t0 = BenchClock::now();
+        switch (m.op) {
+            case MixDeposit:
+                ok = bank.DepositAccount(a,m.amount,date,&err);
+                break;
+            case MixWithdraw:
+                ok = bank.WithdrawFromAccount(a,m.amount,date,&err);
+                break;
+            case MixTransfer:
+                ok = bank.TransferBetweenAccounts(a,b,m.amount,date,&err);
+                break;
+            case MixClose:
+                ok = bank.CloseAccount(owners[m.a],a,date,&err);
+                break;
+            case MixScan:
+                if(const Account* acc = bank.GetAccount(a)){
+                    for(const auto& t : acc->GetTransactions()) checksum += t.amount;
+                    ok = true;
+                }
+                break;
+            case MixSerialize:
+                if(const Account* acc = bank.GetAccount(a)){
+                    sink.str(string());
+                    acc->SaveToFile(sink);
+                    ok = true;
+                }
+                break;
+            case MixCount:
+                break;
+        }
+        auto t1 = BenchClock::now();
+        per_op[m.op].Add(ok,elapsed_ns(t0,t1),bench_alloc_count() - a0);
+    }
+    auto t_end = BenchClock::now();
+
+    BenchResult total{label ? label : "Mixed"};
+    for(auto& r : per_op){
+        if(r.ops == 0)continue;
+        total.ops += r.ops;
+        total.ok += r.ok;
+        total.failed += r.failed;
+        total.allocs += r.allocs;
+        if(!label) results.push_back(r);
+    }
+    total.ns = elapsed_ns(t_start,t_end);
+    total.extra.emplace_back("checksum",static_cast<double>(checksum));
+    results.push_back(total);
+    if(after) after(bank);
+}
+
+
+// Mixed ingest with cfg.consumers threads draining a TransactionStream in batches.
+static void run_stream(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    using Backpressure = TransactionStream::Backpressure;
+    Backpressure policy = Backpressure::Block;
+    if(cfg.stream_policy == "drop") policy = Backpressure::Drop;
+    else if(cfg.stream_policy == "spill") policy = Backpressure::Spill;
+    const string spill_path = "bank_bench_spill.bin";
+
+    run_mixed(cfg,results,"IngestNoStream");
+
+    TransactionStream stream(cfg.ring,policy,spill_path);
+    std::atomic<bool> done{false};
+    std::vector<std::thread> workers;
+    std::vector<std::uint64_t> consumed(cfg.consumers,0),gaps(cfg.consumers,0);
+    std::vector<int> ids;
+    for(std::size_t i=0; i<cfg.consumers; ++i) ids.push_back(stream.Subscribe());
+
+    for(std::size_t i=0; i<cfg.consumers; ++i){
+        workers.emplace_back([&,i]{
+            std::vector<TransactionEvent> batch(256);
+            std::uint64_t expect = 0;
+            for(;;){
+                bool finished = done.load(std::memory_order_acquire);
+                std::size_t n = stream.Poll(ids[i],batch.data(),batch.size());
+                for(std::size_t k=0; k<n; ++k){
+                    if(batch[k].Lost || batch[k].Sequence != expect) ++gaps[i];
+                    expect = batch[k].Sequence + 1;
+                }
+                consumed[i] += n;
+                if(n == 0){
+                    if(finished)break;
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+
+    char label[64];
+    std::snprintf(label,sizeof(label),"IngestWith%zuConsumers",cfg.consumers);
+    run_mixed(cfg,results,label,[&](Management& bank){ bank.AttachStream(&stream); });
+    done.store(true,std::memory_order_release);
+    for(auto& w : workers) w.join();
+
+    TransactionStream::Stats st = stream.GetStats();
+    BenchResult& r = results.back();
+    r.extra.emplace_back("events_published",static_cast<double>(st.Published));
+    r.extra.emplace_back("events_dropped",static_cast<double>(st.Dropped));
+    r.extra.emplace_back("events_spilled",static_cast<double>(st.Spilled));
+    for(std::size_t i=0; i<cfg.consumers; ++i){
+        r.extra.emplace_back("consumer" + std::to_string(i) + "_events",static_cast<double>(consumed[i]));
+        r.extra.emplace_back("consumer" + std::to_string(i) + "_gaps",static_cast<double>(gaps[i]));
+    }
+    if(policy == Backpressure::Spill) std::remove(spill_path.c_str());
+}
+
+
+// Full statement run: the iostream SaveToFile path against StatementWriter exports.
+static void run_statements(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    const string path = "bank_bench_statements.out";
+    auto file_size = [&]{
+        std::ifstream in(path,std::ios::binary | std::ios::ate);
+        return static_cast<double>(in.tellg());
+    };
+    auto finish = [&](BenchResult r,std::uint64_t ns,std::size_t accounts){
+        r.ops = r.ok = accounts;
+        r.ns = ns;
+        double bytes = file_size();
+        r.extra.emplace_back("bytes",bytes);
+        r.extra.emplace_back("mb_per_sec",ns ? bytes / 1e6 / (static_cast<double>(ns) / 1e9) : 0.0);
+        results.push_back(r);
+    };
+
+    run_mixed(cfg,results,"StatementsPopulate",{},[&](Management& bank){
+        std::vector<const Account*> accounts;
+        for(std::size_t i=0; i<cfg.accounts; ++i){
+            // Re-derive the numbers through the owner index, as a statement run would.
+            if(const auto* list = bank.GetAccountsOf(bench_id(i)))
+                for(const auto& n : *list) accounts.push_back(bank.GetAccount(n));
+        }
+
+        {
+            std::uint64_t a0 = bench_alloc_count();
+            auto t0 = BenchClock::now();
+            std::ofstream os(path,std::ios::trunc);
+            for(const Account* acc : accounts) acc->SaveToFile(os);
+            os.close();
+            BenchResult r{"StatementsIostream"};
+            r.allocs = bench_alloc_count() - a0;
+            finish(r,elapsed_ns(t0,BenchClock::now()),accounts.size());
+        }
+
+        struct Variant{ const char* name; StatementWriter::Format fmt; std::size_t threads; };
+        const Variant variants[] = {
+                {"StatementsTextWriter1T",StatementWriter::Format::Text,1},
+                {"StatementsTextWriterNT",StatementWriter::Format::Text,cfg.threads},
+                {"StatementsCsvWriterNT",StatementWriter::Format::Csv,cfg.threads},
+                {"StatementsJsonWriterNT",StatementWriter::Format::Json,cfg.threads},
+        };
+        for(const Variant& v : variants){
+            int fd = ::open(path.c_str(),O_WRONLY | O_CREAT | O_TRUNC,0644);
+            if(fd < 0){
+                std::perror(path.c_str());
+                return;
+            }
+            string err;
+            std::uint64_t a0 = bench_alloc_count();
+            auto t0 = BenchClock::now();
+            bool ok = bank.ExportStatements(fd,v.fmt,v.threads,&err);
+            ::close(fd);
+            BenchResult r{v.name};
+            r.allocs = bench_alloc_count() - a0;
+            r.extra.emplace_back("threads",static_cast<double>(v.threads));
+            if(!ok) std::fprintf(stderr,"%s: %s\n",v.name,err.c_str());
+            finish(r,elapsed_ns(t0,BenchClock::now()),accounts.size());
+        }
+        std::remove(path.c_str());
+    });
+}
+
+
+// Mixed-type accounts: random type order with per-call dispatch, against storage
+// grouped by type and driven by one monomorphic loop per type.
+static void run_policies(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    const Account::Date opened = bench_date(0);
+    const std::size_t rounds = std::max<std::size_t>(1,cfg.ops / cfg.accounts);
+
+    // Fresh accounts per measurement so ledger growth does not favour either side.
+    auto make_accounts = [&](bool grouped){
+        std::mt19937_64 rng(cfg.seed);
+        std::vector<Account> accounts(cfg.accounts);
+        for(std::size_t i=0; i<accounts.size(); ++i){
+            accounts[i].SetAccountNumber();
+            accounts[i].SetInitialBalance(1e9L);
+            accounts[i].SetAccountType(bench_type(i));
+            accounts[i].SetOpeningsDate(opened.day,opened.month,opened.year);
+        }
+        std::shuffle(accounts.begin(),accounts.end(),rng);
+        if(grouped){
+            std::stable_sort(accounts.begin(),accounts.end(),[](const Account& a,const Account& b){
+                return account_type_index(a.GetAccountType()) < account_type_index(b.GetAccountType());
+            });
+        }
+        return accounts;
+    };
+    auto type_range = [](std::vector<Account>& accounts,Account::AccountType t){
+        auto lo = std::partition_point(accounts.begin(),accounts.end(),[&](const Account& a){
+            return account_type_index(a.GetAccountType()) < account_type_index(t);
+        });
+        auto hi = std::partition_point(lo,accounts.end(),[&](const Account& a){
+            return account_type_index(a.GetAccountType()) <= account_type_index(t);
+        });
+        return std::make_pair(lo,hi);
+    };
+    auto measure = [&](const char* name,bool grouped,auto&& body){
+        std::vector<Account> accounts = make_accounts(grouped);
+        BenchResult r{name};
+        std::uint64_t a0 = bench_alloc_count();
+        auto t0 = BenchClock::now();
+        std::size_t ok = 0;
+        for(std::size_t round=0; round<rounds; ++round) ok += body(accounts,bench_date(static_cast<int>(round % 365)));
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.allocs = bench_alloc_count() - a0;
+        r.ops = rounds * accounts.size();
+        r.ok = ok;
+        r.failed = r.ops - ok;
+        results.push_back(r);
+    };
+    // Runs fn(policy, first, last) once per account type over grouped storage.
+    auto for_each_group = [&](std::vector<Account>& accounts,auto&& fn){
+        std::size_t ok = 0;
+        for(Account::AccountType t : {Account::AccountType::CheckingAccount,Account::AccountType::SavingAccount,
+                                      Account::AccountType::FixedDepositAccount}){
+            auto range = type_range(accounts,t);
+            ok += with_policy(t,[&](auto policy){ return fn(policy,range.first,range.second); });
+        }
+        return ok;
+    };
+
+    measure("WithdrawDispatchPerCall",false,[&](std::vector<Account>& accounts,const Account::Date& d){
+        std::size_t ok = 0;
+        for(auto& acc : accounts) ok += acc.Withdraw(1.0L,d);
+        return ok;
+    });
+    measure("WithdrawGroupedByType",true,[&](std::vector<Account>& accounts,const Account::Date& d){
+        return for_each_group(accounts,[&](auto policy,auto first,auto last){
+            using Policy = decltype(policy);
+            std::size_t ok = 0;
+            for(auto it=first; it!=last; ++it) ok += it->template WithdrawAs<Policy>(1.0L,d);
+            return ok;
+        });
+    });
+    measure("InterestDispatchPerCall",false,[&](std::vector<Account>& accounts,const Account::Date& d){
+        std::size_t ok = 0;
+        for(auto& acc : accounts) ok += acc.PostInterest(d);
+        return ok;
+    });
+    measure("InterestGroupedByType",true,[&](std::vector<Account>& accounts,const Account::Date& d){
+        return for_each_group(accounts,[&](auto policy,auto first,auto last){
+            using Policy = decltype(policy);
+            std::size_t ok = 0;
+            for(auto it=first; it!=last; ++it) ok += it->template PostInterestAs<Policy>(d);
+            return ok;
+        });
+    });
+
+    Management bank;
+    open_accounts(bank,cfg,nullptr);
+    measure("ManagementApplyMonthlyInterest",false,[&](std::vector<Account>&,const Account::Date& d){
+        bank.ApplyMonthlyInterest(d);
+        return cfg.accounts;
+    });
+}
+
+
+// Dedup cache cost on its own (1M keys) and on keyed Management deposits with retries.
+static void run_dedup(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    const std::size_t keys = std::max<std::size_t>(cfg.ops,1000000);
+    DedupCache cache(keys);
+    std::mt19937_64 rng(cfg.seed);
+    std::vector<std::uint64_t> ids(keys);
+    for(auto& id : ids) id = rng() | 1;
+
+    const string failure = "Error! insufficient funds.";
+    {
+        BenchResult r{"DedupMissAndInsert"};
+        auto t0 = BenchClock::now();
+        for(std::size_t i=0; i<keys; ++i){
+            bool ok;
+            bool seen = cache.Lookup(ids[i],ok);
+            if(!seen) cache.Insert(ids[i],(i & 7) != 0,(i & 7) ? string() : failure);
+            r.Add(!seen,0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        results.push_back(r);
+    }
+    {
+        BenchResult r{"DedupHit"};
+        std::shuffle(ids.begin(),ids.end(),rng);
+        string err;
+        auto t0 = BenchClock::now();
+        for(std::size_t i=0; i<keys; ++i){
+            bool ok;
+            r.Add(cache.Lookup(ids[i],ok,&err),0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        DedupCache::Stats st = cache.GetStats();
+        r.extra.emplace_back("capacity",static_cast<double>(cache.Capacity()));
+        r.extra.emplace_back("evictions",static_cast<double>(st.Evictions));
+        results.push_back(r);
+    }
+
+    Management bank;
+    std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+    bank.EnableIdempotency(cfg.ops);
+    const Account::Date date = bench_date(1);
+    std::uniform_int_distribution<std::size_t> pick(0,numbers.size() - 1);
+    std::vector<std::size_t> targets(cfg.ops);
+    for(auto& t : targets) t = pick(rng);
+
+    auto run = [&](const char* name,bool keyed,double retry_rate){
+        std::bernoulli_distribution retry(retry_rate);
+        BenchResult r{name};
+        string err;
+        long double before = 0,after = 0;
+        for(const auto& n : numbers) before += bank.GetAccount(n)->GetBalance();
+        std::uint64_t key_base = keyed ? (rng() << 20) : 0;
+        std::uint64_t a0 = bench_alloc_count();
+        auto t0 = BenchClock::now();
+        for(std::size_t i=0; i<targets.size(); ++i){
+            // A retry re-sends the previous request with the same key.
+            std::size_t k = (i > 0 && retry(rng)) ? i - 1 : i;
+            bool ok = keyed ? bank.DepositAccount(key_base + k + 1,numbers[targets[k]],1.0L,date,&err)
+                            : bank.DepositAccount(numbers[targets[k]],1.0L,date,&err);
+            r.Add(ok,0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.allocs = bench_alloc_count() - a0;
+        for(const auto& n : numbers) after += bank.GetAccount(n)->GetBalance();
+        r.extra.emplace_back("credited",static_cast<double>(after - before));
+        results.push_back(r);
+    };
+    run("DepositUnkeyed",false,0.0);
+    run("DepositKeyed",true,0.0);
+    run("DepositKeyed10PctRetries",true,0.1);
+}
+
+
+// Daily-limit checks on accounts with long ledgers: full ledger scan vs the velocity window.
+static void run_velocity(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    const std::size_t n_accounts = 100;
+    const std::size_t history = std::max<std::size_t>(1000,cfg.ops / 4);
+    const int days = 365;
+    std::vector<Account> accounts(n_accounts);
+    std::vector<Account::Date> dates;
+    for(int d=0; d<days; ++d) dates.push_back(bench_date(d));
+    for(auto& acc : accounts){
+        acc.SetAccountNumber();
+        acc.SetInitialBalance(1e12L);
+        acc.SetOpeningsDate(dates[0].day,dates[0].month,dates[0].year);
+        for(std::size_t i=0; i<history; ++i){
+            const Account::Date& d = dates[i * days / history];
+            if(i & 1) acc.Withdraw(5.0L,d);
+            else acc.Deposit(7.0L,d);
+        }
+    }
+
+    const Account::Date& today = dates.back();
+    const int32_t today_days = date_to_days(today);
+    const std::size_t checks = cfg.ops;
+    std::vector<long double> scan_totals(n_accounts),window_totals(n_accounts);
+
+    {
+        BenchResult r{"LimitCheckLedgerScan"};
+        r.extra.emplace_back("history",static_cast<double>(history));
+        auto t0 = BenchClock::now();
+        // A scan per check is O(ledger); cap the work so the suite stays short.
+        const std::size_t scans = std::min<std::size_t>(checks,20000);
+        for(std::size_t i=0; i<scans; ++i){
+            const Account& acc = accounts[i % n_accounts];
+            long double total = 0;
+            for(const auto& t : acc.GetTransactions()){
+                if(t.type == Account::TransactionTypes::Withdraw && t.trans.day == today.day &&
+                   t.trans.month == today.month && t.trans.year == today.year) total += t.amount;
+            }
+            scan_totals[i % n_accounts] = total;
+            r.Add(true,0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        results.push_back(r);
+    }
+    {
+        BenchResult r{"LimitCheckVelocityWindow"};
+        auto t0 = BenchClock::now();
+        for(std::size_t i=0; i<checks; ++i){
+            const Account& acc = accounts[i % n_accounts];
+            window_totals[i % n_accounts] = acc.GetVelocity().Today(date_to_days(today),VelocityWindow::Withdraw).Amount;
+            r.Add(true,0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        std::size_t mismatches = 0,replay_mismatches = 0;
+        for(std::size_t i=0; i<n_accounts; ++i) mismatches += scan_totals[i] != window_totals[i];
+        // Replaying the persisted ledger must rebuild the same window.
+        for(auto& acc : accounts){
+            VelocityWindow live = acc.GetVelocity();
+            acc.RebuildVelocity();
+            for(std::size_t d=0; d<VelocityWindow::Days; ++d){
+                auto day = today_days - static_cast<int32_t>(d);
+                replay_mismatches += live.Today(day,VelocityWindow::Withdraw).Amount !=
+                                     acc.GetVelocity().Today(day,VelocityWindow::Withdraw).Amount;
+            }
+        }
+        r.extra.emplace_back("mismatches_vs_scan",static_cast<double>(mismatches));
+        r.extra.emplace_back("replay_mismatches",static_cast<double>(replay_mismatches));
+        results.push_back(r);
+    }
+    {
+        BenchResult r{"WithdrawWithDailyLimit"};
+        for(auto& acc : accounts) acc.SetDailyLimits(1000.0L,1000.0L);
+        string err;
+        std::uint64_t a0 = bench_alloc_count();
+        auto t0 = BenchClock::now();
+        for(std::size_t i=0; i<checks; ++i){
+            r.Add(accounts[i % n_accounts].Withdraw(1.0L,today,&err),0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.allocs = bench_alloc_count() - a0;
+        results.push_back(r);
+    }
+}
+
+
+// Transfers with injected fan-out, round-trip and drain patterns, ingested with and
+// without the screening pipeline attached.
+static void run_screening(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    enum Kind{Normal,FanOut,RoundTrip,Drain};
+    struct ScreenOp{
+        Kind kind;
+        std::uint32_t a,b;
+        long double amount;
+        int day;
+    };
+    std::mt19937_64 rng(cfg.seed);
+    std::uniform_int_distribution<std::uint32_t> pick(0,static_cast<std::uint32_t>(cfg.accounts - 1));
+    std::uniform_real_distribution<double> amount(150.0,400.0);
+    const std::size_t per_day = std::max<std::size_t>(1,cfg.ops / 30);
+    const std::size_t inject_every = 500;
+    std::vector<ScreenOp> ops;
+    ops.reserve(cfg.ops + cfg.ops / inject_every * 12);
+    std::size_t injected[4] = {};
+    for(std::size_t i=0; i<cfg.ops; ++i){
+        const int day = static_cast<int>(i / per_day);
+        std::uint32_t a = pick(rng),b;
+        do{ b = pick(rng); } while (b == a);
+        if(i % inject_every != inject_every - 1){
+            ops.push_back({Normal,a,b,std::round(amount(rng) * 100.0) / 100.0,day});
+            continue;
+        }
+        Kind k = static_cast<Kind>(1 + i / inject_every % 3);
+        ++injected[k];
+        if(k == FanOut){
+            for(int n=0; n<12; ++n){
+                do{ b = pick(rng); } while (b == a);
+                ops.push_back({FanOut,a,b,20.0L,day});
+            }
+        }
+        else if(k == RoundTrip){
+            ops.push_back({RoundTrip,a,b,300.0L,day});
+            ops.push_back({RoundTrip,b,a,290.0L,day});
+        }
+        else{
+            ops.push_back({Drain,a,b,0.95L,day});
+        }
+    }
+    std::vector<Account::Date> dates;
+    for(int d=0; d<=ops.back().day; ++d) dates.push_back(bench_date(d));
+
+    auto ingest = [&](Management& bank,const std::vector<string>& numbers,BenchResult& r){
+        string err;
+        auto t0 = BenchClock::now();
+        for(const ScreenOp& op : ops){
+            long double amt = op.amount;
+            // Injected legs are funded first so a short balance cannot hide the pattern;
+            // the drain deposit also lifts the balance over DrainMinimum.
+            if(op.kind != Normal) bank.DepositAccount(numbers[op.a],op.kind == Drain ? 5000.0L : amt,dates[op.day],&err);
+            if(op.kind == Drain) amt = std::floor(bank.GetAccount(numbers[op.a])->GetBalance() * op.amount);
+            r.Add(bank.TransferBetweenAccounts(numbers[op.a],numbers[op.b],amt,dates[op.day],&err),0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+    };
+
+    {
+        Management bank;
+        std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+        BenchResult r{"ScreeningIngestNoStream"};
+        ingest(bank,numbers,r);
+        results.push_back(r);
+    }
+
+    Management bank;
+    std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+    TransactionStream stream(cfg.ring,TransactionStream::Backpressure::Drop);
+    ScreeningConfig sc;
+    sc.Workers = std::max<std::size_t>(1,std::min(cfg.threads,TransactionStream::MaxConsumers));
+    ScreeningPipeline pipeline(stream,sc);
+    string err;
+    if(!pipeline.Start(&err)){
+        std::fprintf(stderr,"%s\n",err.c_str());
+        return;
+    }
+    bank.AttachStream(&stream);
+
+    BenchResult r{"ScreeningIngestWithPipeline"};
+    auto t0 = BenchClock::now();
+    ingest(bank,numbers,r);
+    pipeline.Stop();
+    const std::uint64_t drained_ns = elapsed_ns(t0,BenchClock::now());
+
+    ScreeningPipeline::Stats st = pipeline.GetStats();
+    TransactionStream::Stats ss = stream.GetStats();
+    std::vector<ScreeningAlert> alerts = pipeline.TakeAlerts();
+
+    // An injected pattern counts as detected when its originating account raised the matching alert.
+    std::set<std::pair<int,std::uint64_t>> raised;
+    for(const auto& a : alerts) raised.emplace(static_cast<int>(a.Type),a.Account);
+    std::size_t detected[4] = {};
+    std::set<std::pair<int,std::uint32_t>> seen;
+    for(const ScreenOp& op : ops){
+        if(op.kind == Normal || !seen.emplace(op.kind,op.a).second)continue;
+        auto type = op.kind == FanOut ? ScreeningAlert::Kind::FanOut :
+                    op.kind == RoundTrip ? ScreeningAlert::Kind::RoundTrip : ScreeningAlert::Kind::BalanceDrain;
+        detected[op.kind] += raised.count({static_cast<int>(type),pack_account_number(numbers[op.a])});
+    }
+
+    r.extra.emplace_back("workers",static_cast<double>(sc.Workers));
+    r.extra.emplace_back("events_published",static_cast<double>(ss.Published));
+    r.extra.emplace_back("events_dropped",static_cast<double>(ss.Dropped));
+    r.extra.emplace_back("events_screened",static_cast<double>(st.Events));
+    r.extra.emplace_back("screened_per_sec",drained_ns ? st.Events / (static_cast<double>(drained_ns) / 1e9) : 0.0);
+    r.extra.emplace_back("drain_ns",static_cast<double>(drained_ns - r.ns));
+    r.extra.emplace_back("tracked_accounts",static_cast<double>(st.TrackedAccounts));
+    r.extra.emplace_back("tracked_pairs",static_cast<double>(st.TrackedPairs));
+    r.extra.emplace_back("expired_entries",static_cast<double>(st.Expired));
+    for(int k=FanOut; k<=Drain; ++k){
+        const char* name = ScreeningAlert::KindToString(static_cast<ScreeningAlert::Kind>(k - 1));
+        r.extra.emplace_back(string("injected_") + name,static_cast<double>(injected[k]));
+        r.extra.emplace_back(string("detected_") + name,static_cast<double>(detected[k]));
+        r.extra.emplace_back(string("alerts_") + name,static_cast<double>(st.Alerts[k - 1]));
+    }
+    results.push_back(r);
+
+    // Round-trip recall across workers: both legs of each pair land on different workers
+    // as often as not, so state must outlive a day until every worker has moved past it.
+    const int recall_days = 300;
+    const std::size_t recall_pairs = 100;
+    BenchConfig rc = cfg;
+    rc.accounts = recall_pairs * 2;
+    const std::size_t many = std::min<std::size_t>(std::max<std::size_t>(4,cfg.threads),TransactionStream::MaxConsumers);
+    for(std::size_t workers : {std::size_t{1},many}){
+        Management rbank;
+        std::vector<string> rnumbers = open_accounts(rbank,rc,nullptr);
+        TransactionStream rstream(cfg.ring,TransactionStream::Backpressure::Block);
+        ScreeningConfig rsc;
+        rsc.Workers = workers;
+        ScreeningPipeline rpipeline(rstream,rsc);
+        if(!rpipeline.Start(&err)){
+            std::fprintf(stderr,"%s\n",err.c_str());
+            return;
+        }
+        rbank.AttachStream(&rstream);
+
+        BenchResult rr{"ScreeningRoundTripRecall"};
+        std::vector<std::uint32_t> perm(rnumbers.size());
+        std::vector<std::pair<std::uint32_t,std::uint32_t>> legs;
+        auto rt0 = BenchClock::now();
+        for(int d=0; d<recall_days; ++d){
+            std::iota(perm.begin(),perm.end(),0u);
+            std::shuffle(perm.begin(),perm.end(),rng);
+            legs.clear();
+            for(std::size_t p=0; p+1<perm.size(); p+=2){
+                legs.emplace_back(perm[p],perm[p + 1]);
+                legs.emplace_back(perm[p + 1],perm[p]);
+            }
+            std::shuffle(legs.begin(),legs.end(),rng);
+            const Account::Date date = bench_date(d);
+            for(const auto& leg : legs)
+                rr.Add(rbank.TransferBetweenAccounts(rnumbers[leg.first],rnumbers[leg.second],50.0L,date,&err),0,0);
+        }
+        rpipeline.Stop();
+        rr.ns = elapsed_ns(rt0,BenchClock::now());
+
+        std::set<std::tuple<std::uint32_t,std::uint64_t,std::uint64_t>> found;
+        for(const auto& a : rpipeline.TakeAlerts()){
+            if(a.Type == ScreeningAlert::Kind::RoundTrip)
+                found.emplace(a.Date,std::min(a.Account,a.Counterparty),std::max(a.Account,a.Counterparty));
+        }
+        rr.extra.emplace_back("workers",static_cast<double>(workers));
+        rr.extra.emplace_back("injected_RoundTrip",static_cast<double>(recall_days * recall_pairs));
+        rr.extra.emplace_back("detected_RoundTrip",static_cast<double>(found.size()));
+        rr.extra.emplace_back("expired_entries",static_cast<double>(rpipeline.GetStats().Expired));
+        results.push_back(rr);
+    }
+}
+
+
+// Transfer graph: parallel CSR build over a date range, then counterparty, owner-flow and
+// reachability queries against the same questions answered by full ledger scans.
+static void run_graph(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    Management bank;
+    std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+    {
+        std::mt19937_64 rng(cfg.seed);
+        ZipfGenerator zipf(numbers.size(),cfg.zipf);
+        std::uniform_real_distribution<double> amount(1.0,50.0);
+        std::vector<Account::Date> dates;
+        for(int d=0; d<365; ++d) dates.push_back(bench_date(d));
+        const std::size_t per_day = std::max<std::size_t>(1,cfg.ops / 365);
+        for(std::size_t i=0; i<cfg.ops; ++i){
+            std::size_t a = zipf(rng),b;
+            do{ b = zipf(rng); } while (b == a);
+            bank.TransferBetweenAccounts(numbers[a],numbers[b],std::round(amount(rng) * 100.0) / 100.0,
+                                         dates[std::min<std::size_t>(364,i / per_day)]);
+        }
+    }
+    const Account::Date from = bench_date(90),to = bench_date(179);
+    const uint32_t lo = pack_date(from),hi = pack_date(to);
+
+    TransferGraph graph;
+    for(std::size_t threads : {std::size_t{1},cfg.threads}){
+        BenchResult r{threads == 1 ? "GraphBuild1Thread" : "GraphBuildThreads"};
+        auto t0 = BenchClock::now();
+        r.Add(bank.BuildTransferGraph(from,to,threads,graph),0,0);
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.extra.emplace_back("threads",static_cast<double>(threads));
+        r.extra.emplace_back("vertices",static_cast<double>(graph.VertexCount()));
+        r.extra.emplace_back("edges",static_cast<double>(graph.EdgeCount()));
+        r.extra.emplace_back("transfers",static_cast<double>(graph.TransferCount()));
+        results.push_back(r);
+        if(cfg.threads == 1)break;
+    }
+
+    const std::size_t k = 10;
+    std::vector<const Account*> all;
+    for(const auto& n : numbers) all.push_back(bank.GetAccount(n));
+    // Hot accounts first: low Zipf ranks carry most of the traffic.
+    const std::size_t scans = std::min<std::size_t>(20,numbers.size());
+    std::vector<std::vector<long double>> scan_top(scans);
+    {
+        BenchResult r{"TopCounterpartiesLedgerScan"};
+        auto t0 = BenchClock::now();
+        for(std::size_t q=0; q<scans; ++q){
+            const string& me = numbers[q];
+            std::unordered_map<string,long double> totals;
+            for(const Account* acc : all){
+                for(const auto& tx : acc->GetTransactions()){
+                    if(tx.type != Account::TransactionTypes::TransferOut)continue;
+                    const uint32_t day = pack_date(tx.trans);
+                    if(day < lo || day > hi)continue;
+                    if(tx.source == me) totals[tx.destination] += tx.amount;
+                    else if(tx.destination == me) totals[tx.source] += tx.amount;
+                }
+            }
+            for(const auto& [n,amt] : totals) scan_top[q].push_back(amt);
+            std::sort(scan_top[q].rbegin(),scan_top[q].rend());
+            if(scan_top[q].size() > k) scan_top[q].resize(k);
+            r.Add(true,0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        results.push_back(r);
+    }
+    {
+        BenchResult r{"TopCounterpartiesGraph"};
+        const std::size_t queries = std::max<std::size_t>(scans,cfg.ops / 10);
+        std::size_t mismatches = 0;
+        auto t0 = BenchClock::now();
+        for(std::size_t q=0; q<queries; ++q){
+            auto top = graph.TopCounterparties(numbers[q % numbers.size()],k);
+            if(q < scans){
+                mismatches += top.size() != scan_top[q].size();
+                for(std::size_t i=0; i<top.size() && i<scan_top[q].size(); ++i)
+                    mismatches += std::fabs(static_cast<double>(top[i].Amount - scan_top[q][i])) > 0.005;
+            }
+            r.Add(!top.empty(),0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.extra.emplace_back("mismatches_vs_scan",static_cast<double>(mismatches));
+        results.push_back(r);
+    }
+    {
+        BenchResult r{"OwnerFlowGraph"};
+        TransferGraph::Flow f;
+        long double total_in = 0;
+        auto t0 = BenchClock::now();
+        for(std::size_t i=0; i<numbers.size(); ++i){
+            bool ok = bank.OwnerFlow(graph,bench_id(i),f);
+            total_in += f.In;
+            r.Add(ok,0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.extra.emplace_back("total_in",static_cast<double>(total_in));
+        results.push_back(r);
+    }
+    {
+        BenchResult r{"Reachable3HopsGraph"};
+        const std::size_t queries = std::min<std::size_t>(200,numbers.size());
+        std::size_t reached = 0;
+        auto t0 = BenchClock::now();
+        // Cold accounts from the tail of the Zipf order, so the walk has to fan out.
+        for(std::size_t q=0; q<queries; ++q){
+            reached += graph.ReachableWithin(numbers[numbers.size() - 1 - q],3).size();
+            r.Add(true,0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.extra.emplace_back("avg_reached",queries ? static_cast<double>(reached) / queries : 0.0);
+        results.push_back(r);
+    }
+}
+
+
+// Bank-wide date range queries: every ledger of every account against the global journal,
+// first on a bank populated through Management, then on a large synthetic journal.
+static void run_journal(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    std::vector<Account::Date> dates;
+    for(int d=0; d<365; ++d) dates.push_back(bench_date(d));
+    const uint32_t lo = pack_date(dates[59]),hi = pack_date(dates[60]);
+
+    Journal journal(std::max<std::size_t>(cfg.journal_records,cfg.ops * 4));
+    Management bank;
+    bank.AttachJournal(&journal);
+    std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+    {
+        BenchResult r{"JournalIngest"};
+        std::mt19937_64 rng(cfg.seed);
+        ZipfGenerator zipf(numbers.size(),cfg.zipf);
+        const std::size_t per_day = std::max<std::size_t>(1,cfg.ops / 365);
+        auto t0 = BenchClock::now();
+        for(std::size_t i=0; i<cfg.ops; ++i){
+            std::size_t a = zipf(rng),b;
+            do{ b = zipf(rng); } while (b == a);
+            r.Add(bank.TransferBetweenAccounts(numbers[a],numbers[b],5.0L,dates[std::min<std::size_t>(364,i / per_day)]),0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.extra.emplace_back("journal_records",static_cast<double>(journal.Size()));
+        results.push_back(r);
+    }
+
+    std::uint64_t scan_matched = 0;
+    {
+        BenchResult r{"RangeQueryAllLedgers"};
+        auto t0 = BenchClock::now();
+        for(const auto& n : numbers){
+            for(const auto& tx : bank.GetAccount(n)->GetTransactions()){
+                const uint32_t day = pack_date(tx.trans);
+                scan_matched += day >= lo && day <= hi;
+            }
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.Add(true,0,0);
+        r.extra.emplace_back("matched",static_cast<double>(scan_matched));
+        results.push_back(r);
+    }
+    {
+        BenchResult r{"RangeQueryJournal"};
+        int64_t cents = 0;
+        auto t0 = BenchClock::now();
+        std::uint64_t matched = journal.ForEachInRange(lo,hi,[&](uint64_t,const Journal::Record& rec){ cents += rec.Cents; });
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.Add(matched == scan_matched,0,0);
+        r.extra.emplace_back("matched",static_cast<double>(matched));
+        r.extra.emplace_back("blocks_read",static_cast<double>(journal.BlocksInRange(lo,hi)));
+        r.extra.emplace_back("blocks_total",static_cast<double>((journal.Size() + Journal::BlockRecords - 1) / Journal::BlockRecords));
+        results.push_back(r);
+    }
+    {
+        BenchResult r{"AccountHistoryJournal"};
+        std::size_t mismatches = 0;
+        auto t0 = BenchClock::now();
+        for(const auto& n : numbers){
+            const Account* acc = bank.GetAccount(n);
+            std::uint64_t walked = journal.ForEachOfAccount(acc->GetJournalHead(),[](uint64_t,const Journal::Record&){});
+            mismatches += walked != acc->GetTransactions().size();
+            r.Add(true,0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.extra.emplace_back("mismatches_vs_ledger",static_cast<double>(mismatches));
+        results.push_back(r);
+    }
+
+    // Synthetic journal: dates advance with the sequence, a few entries are backdated.
+    Journal big(cfg.journal_records);
+    {
+        BenchResult r{"JournalAppendSynthetic"};
+        std::mt19937_64 rng(cfg.seed);
+        std::vector<uint64_t> heads(cfg.accounts,Journal::None);
+        const std::size_t per_day = std::max<std::size_t>(1,cfg.journal_records / 365);
+        auto t0 = BenchClock::now();
+        for(std::size_t i=0; i<cfg.journal_records; ++i){
+            std::size_t day = i / per_day;
+            if(rng() % 100 == 0 && day >= 3) day -= rng() % 3;
+            const std::size_t a = rng() % cfg.accounts;
+            Journal::Record rec;
+            rec.Account = a + 1;
+            rec.Cents = 500;
+            rec.Prev = heads[a];
+            rec.Date = pack_date(dates[std::min<std::size_t>(364,day)]);
+            rec.Type = Account::TransactionTypes::Deposit;
+            heads[a] = big.Append(rec);
+            r.Add(heads[a] != Journal::None,0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.extra.emplace_back("bytes_per_record",static_cast<double>(sizeof(Journal::Record)));
+        results.push_back(r);
+    }
+    {
+        BenchResult r{"RangeQueryJournalSynthetic"};
+        const int queries = 20;
+        std::uint64_t matched = 0;
+        auto t0 = BenchClock::now();
+        for(int q=0; q<queries; ++q){
+            const uint32_t from = pack_date(dates[q * 17]),to = pack_date(dates[q * 17 + 1]);
+            matched += big.ForEachInRange(from,to,[](uint64_t,const Journal::Record&){});
+            r.Add(true,0,0);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        r.extra.emplace_back("records",static_cast<double>(big.Size()));
+        r.extra.emplace_back("avg_matched",static_cast<double>(matched) / queries);
+        const uint32_t from = pack_date(dates[0]),to = pack_date(dates[1]);
+        r.extra.emplace_back("blocks_read",static_cast<double>(big.BlocksInRange(from,to)));
+
+        // The same query without the index: every record checked.
+        std::uint64_t full_matched = 0;
+        auto t1 = BenchClock::now();
+        big.ForEachInRange(0,UINT32_MAX,[&](uint64_t,const Journal::Record& rec){
+            full_matched += rec.Date >= from && rec.Date <= to;
+        });
+        r.extra.emplace_back("full_scan_ns",static_cast<double>(elapsed_ns(t1,BenchClock::now())));
+        r.extra.emplace_back("full_scan_matched",static_cast<double>(full_matched));
+        results.push_back(r);
+    }
+}
+
+
+// Five accounts per member, each referencing the one shared member record.
+static void run_members(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    const std::size_t per_member = 5;
+    const std::size_t members = std::max<std::size_t>(1,cfg.accounts / per_member);
+    std::vector<Person> people;
+    for(std::size_t i=0; i<members; ++i) people.push_back(bench_person(i));
+    const Account::Date date = bench_date(0);
+
+    Management bank;
+    BenchResult r{"OpenAccountSharedMember"};
+    const long rss0 = peak_rss_kb();
+    string err;
+    std::uint64_t a0 = bench_alloc_count();
+    auto t0 = BenchClock::now();
+    for(std::size_t i=0; i<members * per_member; ++i){
+        r.Add(bank.OpenAccount(people[i % members],1000.0L,bench_type(i),date,&err),0,0);
+    }
+    r.ns = elapsed_ns(t0,BenchClock::now());
+    r.allocs = bench_alloc_count() - a0;
+
+    // Old layout: a Person inside every Account instead of the store pointer and id.
+    const double saved = static_cast<double>(sizeof(Person)) - static_cast<double>(sizeof(const MemberStore*) + sizeof(MemberId));
+    r.extra.emplace_back("members",static_cast<double>(bank.GetMembers().Size()));
+    r.extra.emplace_back("sizeof_account",static_cast<double>(sizeof(Account)));
+    r.extra.emplace_back("sizeof_person",static_cast<double>(sizeof(Person)));
+    r.extra.emplace_back("bytes_saved_per_account",saved);
+    r.extra.emplace_back("saved_mb_at_10m_accounts",saved * 10e6 / (1024.0 * 1024.0));
+    r.extra.emplace_back("rss_growth_kb",static_cast<double>(peak_rss_kb() - rss0));
+    results.push_back(r);
+
+    BenchResult q{"ResolveOwner"};
+    std::size_t resolved = 0;
+    auto t1 = BenchClock::now();
+    for(std::size_t i=0; i<members; ++i){
+        if(const auto* list = bank.GetAccountsOf(people[i].GetIdCode())){
+            for(const auto& n : *list){
+                const Person* owner = bank.GetAccount(n)->GetOwner();
+                resolved += owner && owner->GetIdCode() == people[i].GetIdCode();
+                q.Add(owner != nullptr,0,0);
+            }
+        }
+    }
+    q.ns = elapsed_ns(t1,BenchClock::now());
+    q.extra.emplace_back("resolved",static_cast<double>(resolved));
+    results.push_back(q);
+}
+
+
+// Transfer traffic with an incremental checkpoint every ops/20 operations, against the
+// same traffic without checkpoints and a stop-the-world SaveToFile of every account.
+// Set by checks that invalidate the run; main then exits non-zero after writing results.
+static bool run_failed = false;
+
+static void run_checkpoint(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    const string path = "bank_bench_checkpoint.out";
+    std::vector<Account::Date> dates;
+    for(int d=0; d<365; ++d) dates.push_back(bench_date(d));
+    const std::size_t per_day = std::max<std::size_t>(1,cfg.ops / 365);
+    const std::size_t every = std::max<std::size_t>(1,cfg.ops / 20);
+
+    auto traffic = [&](Management& bank,const std::vector<string>& numbers,BenchResult& r,
+                       const std::function<void(std::size_t)>& tick){
+        std::mt19937_64 rng(cfg.seed);
+        ZipfGenerator zipf(numbers.size(),cfg.zipf);
+        auto t0 = BenchClock::now();
+        for(std::size_t i=0; i<cfg.ops; ++i){
+            std::size_t a = zipf(rng),b;
+            do{ b = zipf(rng); } while (b == a);
+            r.Add(bank.TransferBetweenAccounts(numbers[a],numbers[b],5.0L,dates[std::min<std::size_t>(364,i / per_day)]),0,0);
+            if(tick) tick(i);
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+    };
+
+    {
+        // Same journal cost as below, so the difference is the checkpointing alone.
+        Journal journal(cfg.ops * 4 + cfg.accounts * 2);
+        Management bank;
+        bank.AttachJournal(&journal);
+        std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+        BenchResult r{"TrafficNoCheckpoint"};
+        traffic(bank,numbers,r,{});
+        results.push_back(r);
+
+        BenchResult full{"FullSnapshotStopTheWorld"};
+        std::ofstream os(path,std::ios::trunc);
+        auto t0 = BenchClock::now();
+        for(const auto& n : numbers) bank.GetAccount(n)->SaveToFile(os);
+        os.flush();
+        full.ns = elapsed_ns(t0,BenchClock::now());
+        full.Add(true,0,0);
+        results.push_back(full);
+    }
+
+    std::remove(path.c_str());
+    Journal journal(cfg.ops * 4 + cfg.accounts * 2);
+    Management bank;
+    bank.AttachJournal(&journal);
+    std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+    Checkpointer checkpointer(path,&journal);
+    checkpointer.Checkpoint(bank);
+    checkpointer.Wait();
+
+    BenchResult r{"TrafficWithCheckpoints"};
+    std::size_t skipped = 0;
+    traffic(bank,numbers,r,[&](std::size_t i){
+        if(i % every == every - 1 && !checkpointer.Checkpoint(bank)) ++skipped;
+    });
+    // The last cut must not be skipped as busy, or the file misses the newest changes.
+    string err;
+    bool ok = checkpointer.Wait(&err) && checkpointer.Checkpoint(bank,&err) && checkpointer.Wait(&err);
+    if(!ok){
+        std::fprintf(stderr,"%s\n",err.c_str());
+        run_failed = true;
+    }
+
+    Checkpointer::Stats st = checkpointer.GetStats();
+    std::ifstream in(path,std::ios::binary | std::ios::ate);
+    r.extra.emplace_back("checkpoints",static_cast<double>(st.Checkpoints));
+    r.extra.emplace_back("skipped_busy",static_cast<double>(skipped));
+    r.extra.emplace_back("write_ok",ok ? 1.0 : 0.0);
+    r.extra.emplace_back("avg_accounts_per_checkpoint",static_cast<double>(st.Accounts) / st.Checkpoints);
+    r.extra.emplace_back("entries_written",static_cast<double>(st.Entries));
+    r.extra.emplace_back("max_pause_ns",static_cast<double>(st.MaxPauseNs));
+    r.extra.emplace_back("avg_pause_ns",static_cast<double>(st.TotalPauseNs) / st.Checkpoints);
+    r.extra.emplace_back("avg_write_ns",static_cast<double>(st.TotalWriteNs) / st.Checkpoints);
+    r.extra.emplace_back("file_bytes",static_cast<double>(in.tellg()));
+    r.extra.emplace_back("journal_records",static_cast<double>(journal.Size()));
+    r.extra.emplace_back("journal_truncated_to",static_cast<double>(journal.FirstRetained()));
+
+    // Round trip: the file read back must match the bank it was cut from.
+    CheckpointState restored;
+    BenchResult load{"CheckpointLoad"};
+    auto t0 = BenchClock::now();
+    const bool loaded = Checkpointer::Load(path,restored,&err);
+    load.Add(ok && loaded,elapsed_ns(t0,BenchClock::now()),0);
+    if(!loaded){
+        std::fprintf(stderr,"%s\n",err.c_str());
+        run_failed = true;
+    }
+    std::size_t mismatches = 0;
+    for(const auto& img : restored.Accounts){
+        const Account* acc = bank.GetAccount(img.Number);
+        if(!acc || std::llround(acc->GetBalance() * 100.0L) != std::llround(img.Balance * 100.0L) ||
+           acc->is_closed() != img.Closed || acc->GetTransactions().size() != img.Entries.size()){
+            ++mismatches;
+            continue;
+        }
+        const auto& ledger = acc->GetTransactions();
+        for(std::size_t i=0; i<ledger.size(); ++i){
+            if(ledger[i].type != img.Entries[i].type ||
+               std::llround(ledger[i].amount * 100.0L) != std::llround(img.Entries[i].amount * 100.0L)){
+                ++mismatches;
+                break;
+            }
+        }
+    }
+    load.extra.emplace_back("accounts",static_cast<double>(restored.Accounts.size()));
+    load.extra.emplace_back("missing_accounts",static_cast<double>(numbers.size() - std::min(numbers.size(),restored.Accounts.size())));
+    load.extra.emplace_back("mismatches",static_cast<double>(mismatches));
+    results.push_back(r);
+    results.push_back(load);
+    std::remove(path.c_str());
+}
+
+static void run_archive(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    const string path = "bank_bench_archive.out";
+    std::remove(path.c_str());
+    constexpr int Days = 3 * 365;
+    constexpr uint32_t RetainDays = 365;
+    std::vector<Account::Date> dates;
+    for(int d=0; d<Days; ++d) dates.push_back(bench_date(d));
+    const std::size_t per_day = std::max<std::size_t>(1,cfg.ops / Days);
+
+    const string checkpoint_path = path + ".ckpt";
+    std::remove(checkpoint_path.c_str());
+    Management bank;
+    std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+    // Checkpointed halfway, so the archive takes both checkpointed and newer entries.
+    Checkpointer checkpointer(checkpoint_path);
+    std::mt19937_64 rng(cfg.seed);
+    std::uniform_int_distribution<std::size_t> pick(0,numbers.size() - 1);
+    for(std::size_t i=0; i<cfg.ops; ++i){
+        std::size_t a = pick(rng),b;
+        do{ b = pick(rng); } while (b == a);
+        bank.TransferBetweenAccounts(numbers[a],numbers[b],5.0L,dates[std::min<std::size_t>(Days - 1,i / per_day)]);
+        if(i == cfg.ops / 2){
+            checkpointer.Checkpoint(bank);
+            checkpointer.Wait();
+        }
+    }
+
+    // Every tenth account is emptied into its neighbour and closed.
+    const Account::Date& today = dates.back();
+    std::size_t closed = 0;
+    for(std::size_t i=0; i + 1<numbers.size(); i+=10){
+        const Account* acc = bank.GetAccount(numbers[i]);
+        if(acc->GetBalance() > 0) bank.TransferBetweenAccounts(numbers[i],numbers[i + 1],acc->GetBalance(),today);
+        closed += bank.CloseAccount(acc->GetOwner()->GetIdCode(),numbers[i],today);
+    }
+
+    auto scan = [&](BenchResult& r){
+        uint64_t entries = 0;
+        auto t0 = BenchClock::now();
+        for(const auto& n : numbers) r.Add(bank.ForEachTransaction(n,[&](const Account::Transaction& t){ entries += t.amount >= 0; }),0,0);
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        return entries;
+    };
+
+    // Statements and the transfer graph must see the same history once it is archived.
+    const string export_path = path + ".csv";
+    auto history_views = [&](){
+        std::pair<std::uint64_t,std::uint64_t> out{};
+        int fd = ::open(export_path.c_str(),O_RDWR | O_CREAT | O_TRUNC,0644);
+        if(fd >= 0){
+            if(bank.ExportStatements(fd,StatementWriter::Format::Csv,cfg.threads))
+                out.first = static_cast<std::uint64_t>(::lseek(fd,0,SEEK_END));
+            ::close(fd);
+        }
+        TransferGraph graph;
+        if(bank.BuildTransferGraph(dates.front(),today,cfg.threads,graph)) out.second = graph.TransferCount();
+        std::remove(export_path.c_str());
+        return out;
+    };
+    const auto views_before = history_views();
+
+    const long rss_before = current_rss_kb();
+    BenchResult before{"FullHistoryScanInMemory"};
+    const uint64_t entries_before = scan(before);
+    before.extra.emplace_back("entries",static_cast<double>(entries_before));
+    before.extra.emplace_back("rss_kb",static_cast<double>(rss_before));
+    results.push_back(before);
+
+    BenchResult archive{"ArchiveLedgers"};
+    Management::ArchiveStats st;
+    string err;
+    auto t0 = BenchClock::now();
+    bool ok = bank.EnableArchive(path,&err) && bank.ArchiveLedgers(today,RetainDays,&st,&err);
+    archive.ns = elapsed_ns(t0,BenchClock::now());
+    archive.Add(ok,archive.ns,0);
+    const long rss_after = current_rss_kb();
+    archive.extra.emplace_back("accounts_closed",static_cast<double>(closed));
+    archive.extra.emplace_back("accounts_archived",static_cast<double>(st.Accounts));
+    archive.extra.emplace_back("closed_accounts_archived",static_cast<double>(st.ClosedAccounts));
+    archive.extra.emplace_back("entries_archived",static_cast<double>(st.Entries));
+    archive.extra.emplace_back("file_bytes",static_cast<double>(st.Bytes));
+    archive.extra.emplace_back("rss_before_kb",static_cast<double>(rss_before));
+    archive.extra.emplace_back("rss_after_kb",static_cast<double>(rss_after));
+    results.push_back(archive);
+
+    BenchResult after{"FullHistoryScanArchived"};
+    const uint64_t entries_after = scan(after);
+    after.extra.emplace_back("entries",static_cast<double>(entries_after));
+    after.extra.emplace_back("matches_in_memory",entries_after == entries_before ? 1.0 : 0.0);
+    const auto views_after = history_views();
+    after.extra.emplace_back("statement_matches",views_after.first == views_before.first ? 1.0 : 0.0);
+    after.extra.emplace_back("graph_transfers",static_cast<double>(views_after.second));
+    after.extra.emplace_back("graph_matches",views_after.second == views_before.second ? 1.0 : 0.0);
+    after.extra.emplace_back("rss_kb",static_cast<double>(current_rss_kb()));
+    results.push_back(after);
+
+    // A checkpoint cut after archiving must still read back as each account's full history.
+    BenchResult reload{"CheckpointLoadAfterArchive"};
+    CheckpointState restored;
+    t0 = BenchClock::now();
+    const bool loaded = checkpointer.Checkpoint(bank,&err) && checkpointer.Wait(&err) &&
+                        Checkpointer::Load(checkpoint_path,restored,&err);
+    reload.Add(loaded,elapsed_ns(t0,BenchClock::now()),0);
+    if(!loaded) std::fprintf(stderr,"%s\n",err.c_str());
+    std::size_t mismatches = 0;
+    for(const auto& img : restored.Accounts){
+        const Account* acc = bank.GetAccount(img.Number);
+        mismatches += !acc || acc->GetArchivedCount() + acc->GetTransactions().size() != img.Entries.size() ||
+                      std::llround(acc->GetBalance() * 100.0L) != std::llround(img.Balance * 100.0L);
+    }
+    reload.extra.emplace_back("accounts",static_cast<double>(restored.Accounts.size()));
+    reload.extra.emplace_back("mismatches",static_cast<double>(mismatches));
+    results.push_back(reload);
+    std::remove(checkpoint_path.c_str());
+    std::remove(path.c_str());
+}
+
+static void run_search(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    constexpr std::size_t Limit = 20;
+    constexpr std::size_t Queries = 2000;
+    Management bank;
+    std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+    std::mt19937_64 rng(cfg.seed);
+    std::vector<string> prefixes;
+    for(std::size_t i=0; i<Queries; ++i) prefixes.push_back(numbers[rng() % numbers.size()].substr(0,3 + i % 5));
+
+    // What the support desk did before: compare every account number.
+    BenchResult scan{"AccountPrefixFullScan"};
+    std::size_t scan_hits = 0;
+    auto t0 = BenchClock::now();
+    for(std::size_t q=0; q<Queries; q+=10){
+        std::size_t found = 0;
+        for(const auto& n : numbers) if(found < Limit && n.compare(0,prefixes[q].size(),prefixes[q]) == 0) ++found;
+        scan_hits += found;
+        scan.Add(found > 0,0,0);
+    }
+    scan.ns = elapsed_ns(t0,BenchClock::now());
+    results.push_back(scan);
+
+    BenchResult idx{"AccountPrefixIndexed"};
+    std::size_t idx_hits = 0;
+    std::vector<string> out;
+    std::uint64_t a0 = bench_alloc_count();
+    t0 = BenchClock::now();
+    for(std::size_t q=0; q<Queries; ++q){
+        out.clear();
+        bool ok = bank.FindAccountsByPrefix(prefixes[q],Limit,out);
+        if(q % 10 == 0) idx_hits += out.size();
+        idx.Add(ok && !out.empty(),0,0);
+    }
+    idx.ns = elapsed_ns(t0,BenchClock::now());
+    idx.allocs = bench_alloc_count() - a0;
+    idx.extra.emplace_back("matches_full_scan",idx_hits == scan_hits ? 1.0 : 0.0);
+    results.push_back(idx);
+
+    BenchResult members{"MemberPrefixIndexed"};
+    t0 = BenchClock::now();
+    for(std::size_t q=0; q<Queries; ++q){
+        out.clear();
+        members.Add(bank.FindMembersByPrefix(std::to_string(q % 1000),Limit,out),0,0);
+    }
+    members.ns = elapsed_ns(t0,BenchClock::now());
+    results.push_back(members);
+
+    // The index alone at a larger scale, fed incrementally like OpenAccount does.
+    PrefixIndex big(10);
+    std::vector<string> keys;
+    keys.reserve(cfg.index_keys);
+    for(std::size_t i=0; i<cfg.index_keys; ++i) keys.push_back(unpack_account_number(rng() % 10000000000ull));
+    BenchResult insert{"PrefixIndexInsert"};
+    const long rss0 = peak_rss_kb();
+    t0 = BenchClock::now();
+    for(const auto& k : keys) insert.Add(big.Insert(k),0,0);
+    insert.ns = elapsed_ns(t0,BenchClock::now());
+    insert.extra.emplace_back("keys",static_cast<double>(big.Size()));
+    insert.extra.emplace_back("rss_growth_kb",static_cast<double>(peak_rss_kb() - rss0));
+    results.push_back(insert);
+
+    BenchResult query{"PrefixIndexQuery"};
+    std::size_t checked = 0,agree = 0;
+    t0 = BenchClock::now();
+    for(std::size_t q=0; q<Queries * 10; ++q){
+        out.clear();
+        query.Add(big.Find(keys[rng() % keys.size()].substr(0,3 + q % 6),Limit,out),0,0);
+    }
+    query.ns = elapsed_ns(t0,BenchClock::now());
+    for(std::size_t q=0; q<5; ++q){
+        const string p = keys[q].substr(0,4);
+        std::unordered_set<string> brute;   // random keys may repeat
+        for(const auto& k : keys) if(k.compare(0,p.size(),p) == 0) brute.insert(k);
+        ++checked;
+        agree += brute.size() == big.CountPrefix(p) && big.Contains(keys[q]);
+    }
+    query.extra.emplace_back("count_checks_passed",static_cast<double>(agree) / checked);
+    results.push_back(query);
+}
+
+static void run_payroll(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    constexpr std::size_t Months = 12;
+    const std::size_t employees = std::min<std::size_t>(10000,cfg.accounts - 1);
+    Journal journal(std::max<std::size_t>(cfg.journal_records,(employees * 2 + 1) * Months * 3 + cfg.accounts * 2));
+    Management bank;
+    bank.AttachJournal(&journal);
+    std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+    const string& employer = numbers[0];
+    bank.DepositAccount(employer,1e9L,bench_date(0));
+
+    std::vector<Management::TransferLeg> legs;
+    for(std::size_t i=1; i<=employees; ++i) legs.push_back({employer,numbers[i],2000.0L + static_cast<long double>(i % 500)});
+
+    // Leg by leg through the two-account API: fast, but a failure midway leaves a partial payroll.
+    BenchResult single{"PayrollSingleTransfers"};
+    auto t0 = BenchClock::now();
+    for(std::size_t m=0; m<Months; ++m){
+        const Account::Date date = bench_date(static_cast<int>(m * 30));
+        std::uint64_t a0 = bench_alloc_count();
+        for(const auto& leg : legs) bank.TransferBetweenAccounts(leg.Source,leg.Destination,leg.Amount,date);
+        single.allocs += bench_alloc_count() - a0;
+        single.ops += legs.size();
+        single.ok += legs.size();
+    }
+    single.ns = elapsed_ns(t0,BenchClock::now());
+    results.push_back(single);
+
+    BenchResult multi{"PayrollMultiLeg"};
+    std::size_t contiguous = 0;
+    t0 = BenchClock::now();
+    for(std::size_t m=0; m<Months; ++m){
+        const Account::Date date = bench_date(static_cast<int>(m * 30 + 1));
+        uint64_t seq = Journal::None;
+        std::uint64_t a0 = bench_alloc_count();
+        bool ok = bank.TransferMultiLeg(legs,date,&seq);
+        // Allocations after the first month (scratch and ledgers warmed up), per leg.
+        if(m) multi.allocs += bench_alloc_count() - a0;
+        contiguous += ok && journal.Size() - seq == legs.size() * 2;
+        for(std::size_t i=0; i<legs.size(); ++i) multi.Add(ok,0,0);
+    }
+    multi.ns = elapsed_ns(t0,BenchClock::now());
+    multi.extra.emplace_back("legs_per_transfer",static_cast<double>(legs.size()));
+    multi.extra.emplace_back("ns_per_transfer",static_cast<double>(multi.ns) / Months);
+    multi.extra.emplace_back("allocs_per_leg_after_first",static_cast<double>(multi.allocs) / (legs.size() * (Months - 1)));
+    multi.extra.emplace_back("journal_contiguous",static_cast<double>(contiguous) / Months);
+    multi.allocs = 0;
+    results.push_back(multi);
+
+    // The last leg cannot be funded: nothing may change.
+    BenchResult rejected{"PayrollRejectedAllOrNothing"};
+    const Account* payer = bank.GetAccount(employer);
+    legs.back().Amount = payer->GetBalance();
+    const long double balance = payer->GetBalance();
+    const std::size_t ledger = payer->GetTransactions().size();
+    const uint64_t journal_size = journal.Size();
+    t0 = BenchClock::now();
+    string err;
+    bool ok = bank.TransferMultiLeg(legs,bench_date(364),nullptr,&err);
+    rejected.ns = elapsed_ns(t0,BenchClock::now());
+    rejected.Add(!ok,rejected.ns,0);
+    rejected.extra.emplace_back("unchanged",payer->GetBalance() == balance && payer->GetTransactions().size() == ledger &&
+                                            journal.Size() == journal_size ? 1.0 : 0.0);
+    results.push_back(rejected);
+}
+
+static void run_orders(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    constexpr int Days = 31;
+    Management bank;
+    std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+    std::mt19937_64 rng(cfg.seed);
+
+    // Monthly orders spread over days 1-28; one in ten is a deposit.
+    StandingOrders orders;
+    BenchResult add{"StandingOrderAdd"};
+    std::vector<int32_t> next_days;     // the same schedule as a flat array, for the scan baseline
+    next_days.reserve(cfg.orders);
+    std::vector<Account::Date> first;
+    for(int d=0; d<28; ++d) first.push_back(bench_date(d));
+    auto t0 = BenchClock::now();
+    for(std::size_t i=0; i<cfg.orders; ++i){
+        const Account::Date& date = first[i % 28];
+        const std::size_t a = rng() % numbers.size(),b = (a + 1 + rng() % (numbers.size() - 1)) % numbers.size();
+        const long double amount = 1.0L + static_cast<long double>(i % 400) / 100.0L;
+        StandingOrders::OrderId id = i % 10 == 0
+                ? orders.AddDeposit(numbers[a],amount,date,StandingOrders::Frequency::Monthly)
+                : orders.AddTransfer(numbers[a],numbers[b],amount,date,StandingOrders::Frequency::Monthly);
+        add.Add(id != StandingOrders::NoOrder,0,0);
+        next_days.push_back(date_to_days(date));
+    }
+    add.ns = elapsed_ns(t0,BenchClock::now());
+    results.push_back(add);
+
+    // Finding the due orders by looking at every order, once per day.
+    BenchResult scan{"FindDueFullScan"};
+    std::size_t scanned_due = 0;
+    t0 = BenchClock::now();
+    for(int d=0; d<Days; ++d){
+        const int32_t day = date_to_days(bench_date(d));
+        for(int32_t next : next_days) scanned_due += next == day;
+        scan.Add(true,0,0);
+    }
+    scan.ns = elapsed_ns(t0,BenchClock::now());
+    scan.extra.emplace_back("due",static_cast<double>(scanned_due));
+    results.push_back(scan);
+
+    BenchResult run{"RunDueDaily"};
+    StandingOrders::RunStats total,st;
+    uint64_t max_day_ns = 0;
+    for(int d=0; d<Days; ++d){
+        auto a = BenchClock::now();
+        run.Add(orders.RunDue(bank,bench_date(d),cfg.threads,&st),0,0);
+        const uint64_t ns = elapsed_ns(a,BenchClock::now());
+        run.ns += ns;
+        max_day_ns = std::max(max_day_ns,ns);
+        total.Due += st.Due;
+        total.Executed += st.Executed;
+        total.Failed += st.Failed;
+        total.Skipped += st.Skipped;
+        total.FindNs += st.FindNs;
+        total.PrepareNs += st.PrepareNs;
+        total.ApplyNs += st.ApplyNs;
+    }
+    run.extra.emplace_back("orders",static_cast<double>(orders.Size()));
+    run.extra.emplace_back("due",static_cast<double>(total.Due));
+    run.extra.emplace_back("matches_scan",total.Due == scanned_due ? 1.0 : 0.0);
+    run.extra.emplace_back("executed",static_cast<double>(total.Executed));
+    run.extra.emplace_back("failed",static_cast<double>(total.Failed));
+    run.extra.emplace_back("find_ns_per_day",static_cast<double>(total.FindNs) / Days);
+    run.extra.emplace_back("scan_ns_per_day",static_cast<double>(scan.ns) / Days);
+    run.extra.emplace_back("prepare_ns_per_order",static_cast<double>(total.PrepareNs) / std::max<std::size_t>(1,total.Due));
+    run.extra.emplace_back("apply_ns_per_order",static_cast<double>(total.ApplyNs) / std::max<std::size_t>(1,total.Due));
+    run.extra.emplace_back("max_day_ns",static_cast<double>(max_day_ns));
+    results.push_back(run);
+
+    // RunDue only every fifth day: each missed occurrence must still run, and no order
+    // may be left scheduled on or before the last run day.
+    constexpr int GapDays = 60,Stride = 5;
+    StandingOrders gap;
+    std::vector<StandingOrders::OrderId> gap_ids;
+    std::size_t expected = 0;
+    for(std::size_t i=0; i<std::min<std::size_t>(cfg.orders,10000); ++i){
+        const int first_day = static_cast<int>(i % 7);
+        const bool daily = i % 2 == 0;
+        gap_ids.push_back(gap.AddDeposit(numbers[i % numbers.size()],1.0L,bench_date(first_day),
+                                         daily ? StandingOrders::Frequency::Daily : StandingOrders::Frequency::Weekly));
+        expected += daily ? GapDays - first_day : (GapDays - 1 - first_day) / 7 + 1;
+    }
+    BenchResult gapped{"RunDueEveryFifthDay"};
+    std::size_t gap_due = 0;
+    t0 = BenchClock::now();
+    for(int d=Stride - 1; d<GapDays; d+=Stride){
+        gapped.Add(gap.RunDue(bank,bench_date(d),cfg.threads,&st),0,0);
+        gap_due += st.Due;
+    }
+    gapped.ns = elapsed_ns(t0,BenchClock::now());
+    const int32_t last_day = date_to_days(bench_date(GapDays - 1));
+    std::size_t behind = 0;
+    for(StandingOrders::OrderId id : gap_ids) behind += gap.NextRun(id) <= last_day;
+    gapped.extra.emplace_back("due",static_cast<double>(gap_due));
+    gapped.extra.emplace_back("expected",static_cast<double>(expected));
+    gapped.extra.emplace_back("matches_expected",gap_due == expected ? 1.0 : 0.0);
+    gapped.extra.emplace_back("behind_calendar",static_cast<double>(behind));
+    results.push_back(gapped);
+}
+
+// Uniformly random balance checks and deposits over cfg.hot_accounts accounts, so nearly
+// every access misses the cache; cache misses come from perf counters where permitted.
+static void run_hotcold(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    // IdCodes have 5 digits, so members own several accounts each.
+    const std::size_t members = std::min<std::size_t>(cfg.hot_accounts,99999);
+    std::vector<Person> people;
+    people.reserve(members);
+    for(std::size_t i=0; i<members; ++i) people.push_back(bench_person(i));
+    const Account::Date date = bench_date(0);
+
+    Management bank;
+    std::vector<string> numbers;
+    numbers.reserve(cfg.hot_accounts);
+    string err;
+    auto t0 = BenchClock::now();
+    for(std::size_t i=0; i<cfg.hot_accounts; ++i){
+        if(bank.OpenAccount(people[i % members],1000.0L,bench_type(i),date,&err)){
+            numbers.push_back(bank.GetAccountsOf(people[i % members].GetIdCode())->back());
+        }
+    }
+    const uint64_t open_ns = elapsed_ns(t0,BenchClock::now());
+    std::vector<const Account*> resolved;
+    resolved.reserve(numbers.size());
+    for(const auto& n : numbers) resolved.push_back(bank.GetAccount(n));
+
+    std::mt19937_64 rng(cfg.seed);
+    std::vector<std::uint32_t> picks(cfg.ops);
+    for(auto& p : picks) p = static_cast<std::uint32_t>(rng() % numbers.size());
+
+    PerfCounter llc = PerfCounter::CacheMisses(),l1d = PerfCounter::L1dMisses();
+    auto measure = [&](BenchResult& r,auto&& op){
+        llc.Start();
+        l1d.Start();
+        auto a = BenchClock::now();
+        for(std::uint32_t p : picks) r.Add(op(p),0,0);
+        r.ns = elapsed_ns(a,BenchClock::now());
+        const double ops = static_cast<double>(std::max<std::size_t>(1,picks.size()));
+        const double misses = l1d.Stop(),llc_misses = llc.Stop();
+        r.extra.emplace_back("l1d_misses_per_op",misses < 0 ? -1 : misses / ops);
+        r.extra.emplace_back("cache_misses_per_op",llc_misses < 0 ? -1 : llc_misses / ops);
+    };
+
+    // Balance from the hot record alone.
+    BenchResult check{"HotColdBalanceCheck"};
+    long double sum = 0;
+    measure(check,[&](std::uint32_t p){
+        long double balance = 0;
+        const bool ok = bank.GetBalance(numbers[p],balance);
+        sum += balance;
+        return ok;
+    });
+    check.extra.emplace_back("accounts",static_cast<double>(numbers.size()));
+    check.extra.emplace_back("open_ns_per_account",static_cast<double>(open_ns) / static_cast<double>(numbers.size()));
+    check.extra.emplace_back("sizeof_account",static_cast<double>(sizeof(Account)));
+    check.extra.emplace_back("sizeof_hot_record",static_cast<double>(sizeof(Account::HotFields)));
+    check.extra.emplace_back("hot_store_mb",static_cast<double>(bank.GetHotStore().Bytes()) / (1024.0 * 1024.0));
+    check.extra.emplace_back("perf_counters",llc.Valid() ? 1.0 : 0.0);
+    results.push_back(check);
+
+    // Balance, status and type through the Account object, as GetAccount callers do.
+    BenchResult via{"HotColdAccountCheck"};
+    measure(via,[&](std::uint32_t p){
+        const Account* acc = bank.GetAccount(numbers[p]);
+        sum += acc->GetBalance();
+        return !acc->is_closed() && acc->GetAccountType() != Account::AccountType::FixedDepositAccount;
+    });
+    results.push_back(via);
+
+    // Account pointers resolved up front: only the record layout is measured.
+    BenchResult direct{"HotColdBalanceCheckResolved"};
+    measure(direct,[&](std::uint32_t p){
+        const Account* acc = resolved[p];
+        sum += acc->GetBalance();
+        return !acc->is_closed() && acc->GetAccountType() != Account::AccountType::FixedDepositAccount;
+    });
+    results.push_back(direct);
+
+    BenchResult deposit{"HotColdDeposit"};
+    measure(deposit,[&](std::uint32_t p){
+        return bank.DepositAccount(numbers[p],1.0L,date,&err);
+    });
+    deposit.extra.emplace_back("checksum",static_cast<double>(sum));
+    deposit.extra.emplace_back("rss_kb",static_cast<double>(current_rss_kb()));
+    results.push_back(deposit);
+}
+
+
+// The same deposits, withdrawals and transfers against one Management on the calling
+// thread and against a PartitionedBank with local and with interleaved placement, in
+// batches of 10000. With a single real node, cfg.nodes nodes are simulated.
+static void run_numa(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    using Kind = PartitionedBank::Op::Kind;
+    NumaTopology topology = NumaTopology::Detect();
+    if(topology.NodeCount() < 2) topology = NumaTopology::Simulated(cfg.nodes);
+    constexpr std::size_t Batch = 10000;
+    const Account::Date date = bench_date(0);
+
+    struct Pick{
+        Kind Type;
+        std::uint32_t A,B;
+        long double Amount;
+    };
+    std::mt19937_64 rng(cfg.seed);
+    std::vector<Pick> picks(cfg.ops);
+    for(auto& p : picks){
+        const auto r = rng() % 10;
+        p.Type = r < 4 ? Kind::Deposit : r < 6 ? Kind::Withdraw : Kind::Transfer;
+        p.A = static_cast<std::uint32_t>(rng() % cfg.accounts);
+        p.B = static_cast<std::uint32_t>((p.A + 1 + rng() % (cfg.accounts - 1)) % cfg.accounts);
+        p.Amount = 1.0L + static_cast<long double>(rng() % 5000) / 100.0L;
+    }
+    auto to_batches = [&](const std::vector<string>& numbers){
+        std::vector<std::vector<PartitionedBank::Op>> batches;
+        for(std::size_t i=0; i<picks.size(); ++i){
+            if(i % Batch == 0) batches.emplace_back();
+            const Pick& p = picks[i];
+            batches.back().push_back({p.Type,numbers[p.A],p.Type == Kind::Transfer ? numbers[p.B] : string(),p.Amount});
+        }
+        return batches;
+    };
+    // Deposits add and withdrawals remove money; transfers must not change the total.
+    auto expected_total = [&](const std::vector<uint8_t>& ok){
+        long double total = 1000.0L * static_cast<long double>(cfg.accounts);
+        for(std::size_t i=0; i<picks.size(); ++i){
+            if(!ok[i])continue;
+            if(picks[i].Type == Kind::Deposit) total += picks[i].Amount;
+            if(picks[i].Type == Kind::Withdraw) total -= picks[i].Amount;
+        }
+        return total;
+    };
+
+    {
+        Management bank;
+        std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+        const auto batches = to_batches(numbers);
+        std::vector<uint8_t> ok;
+        ok.reserve(picks.size());
+        BenchResult r{"NumaSingleManagement"};
+        auto t0 = BenchClock::now();
+        for(const auto& batch : batches){
+            for(const auto& op : batch){
+                bool done = false;
+                switch (op.Type) {
+                    case Kind::Deposit: done = bank.DepositAccount(op.Source,op.Amount,date); break;
+                    case Kind::Withdraw: done = bank.WithdrawFromAccount(op.Source,op.Amount,date); break;
+                    case Kind::Transfer: done = bank.TransferBetweenAccounts(op.Source,op.Destination,op.Amount,date); break;
+                }
+                ok.push_back(done);
+                r.Add(done,0,0);
+            }
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        long double total = 0,balance = 0;
+        for(const auto& n : numbers) total += bank.GetBalance(n,balance) ? balance : 0.0L;
+        r.extra.emplace_back("balance_conserved",std::fabs(static_cast<double>(total - expected_total(ok))) < 1e-3 ? 1.0 : 0.0);
+        results.push_back(r);
+    }
+
+    for(auto placement : {PartitionedBank::Placement::Local,PartitionedBank::Placement::Interleaved}){
+        PartitionedBank bank(topology,placement);
+        std::vector<string> numbers;
+        string number,err;
+        for(std::size_t i=0; i<cfg.accounts; ++i){
+            if(bank.OpenAccount(bench_person(i),1000.0L,bench_type(i),date,&number,&err)) numbers.push_back(number);
+        }
+        const auto batches = to_batches(numbers);
+        std::vector<uint8_t> ok,batch_ok;
+        ok.reserve(picks.size());
+        PartitionedBank::BatchStats st,total_st;
+        BenchResult r{placement == PartitionedBank::Placement::Local ? "NumaPartitionedLocal" : "NumaPartitionedInterleaved"};
+        auto t0 = BenchClock::now();
+        for(const auto& batch : batches){
+            bank.RunBatch(batch,date,&batch_ok,&st);
+            ok.insert(ok.end(),batch_ok.begin(),batch_ok.end());
+            total_st.CrossNode += st.CrossNode;
+            total_st.Refunded += st.Refunded;
+        }
+        r.ns = elapsed_ns(t0,BenchClock::now());
+        for(uint8_t done : ok) r.Add(done,0,0);
+        long double total = 0,balance = 0;
+        for(const auto& n : numbers) total += bank.Shard(bank.NodeOf(n)).GetBalance(n,balance) ? balance : 0.0L;
+        r.extra.emplace_back("nodes",static_cast<double>(bank.NodeCount()));
+        r.extra.emplace_back("simulated",topology.IsSimulated() ? 1.0 : 0.0);
+        r.extra.emplace_back("pinned",bank.Pinned() ? 1.0 : 0.0);
+        r.extra.emplace_back("memory_policy",bank.MemoryPolicyApplied() ? 1.0 : 0.0);
+        r.extra.emplace_back("cross_node_fraction",static_cast<double>(total_st.CrossNode) / static_cast<double>(std::max<std::size_t>(1,picks.size())));
+        r.extra.emplace_back("refunded",static_cast<double>(total_st.Refunded));
+        r.extra.emplace_back("balance_conserved",std::fabs(static_cast<double>(total - expected_total(ok))) < 1e-3 ? 1.0 : 0.0);
+        results.push_back(r);
+    }
+}
+
+// A year of traffic in date order, then typical statement queries through LedgerQuery
+// against the hand-written loops over GetTransactions() they replace.
+static void run_query(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    using Types = Account::TransactionTypes;
+    constexpr int Days = 365;
+    Management bank;
+    std::vector<string> numbers = open_accounts(bank,cfg,nullptr);
+    std::mt19937_64 rng(cfg.seed);
+    string err;
+    for(int d=0; d<Days; ++d){
+        const Account::Date date = bench_date(d);
+        for(std::size_t i=0; i<cfg.ops / Days; ++i){
+            const std::size_t a = rng() % numbers.size(),b = (a + 1 + rng() % (numbers.size() - 1)) % numbers.size();
+            const long double amount = 1.0L + static_cast<long double>(rng() % 10000) / 100.0L;
+            switch (rng() % 3) {
+                case 0: bank.DepositAccount(numbers[a],amount,date,&err); break;
+                case 1: bank.WithdrawFromAccount(numbers[a],amount,date,&err); break;
+                default: bank.TransferBetweenAccounts(numbers[a],numbers[b],amount,date,&err); break;
+            }
+        }
+    }
+    const Account::Date from = bench_date(151),to = bench_date(180);   // June
+    const uint32_t lo = pack_date(from),hi = pack_date(to);
+
+    // Money in during one month, for every account.
+    LedgerQuery statement;
+    statement.OfType(Types::Deposit).OfType(Types::TransferIn).Between(from,to);
+    BenchResult q{"QueryMonthlyStatement"};
+    LedgerQuery::Summary s,total;
+    auto t0 = BenchClock::now();
+    for(const auto& n : numbers){
+        q.Add(bank.Summarize(n,statement,s),0,0);
+        total.Merge(s);
+    }
+    q.ns = elapsed_ns(t0,BenchClock::now());
+
+    BenchResult h{"HandLoopMonthlyStatement"};
+    LedgerQuery::Summary hand;
+    t0 = BenchClock::now();
+    for(const auto& n : numbers){
+        const Account* acc = bank.GetAccount(n);
+        for(const auto& t : acc->GetTransactions()){
+            if(t.type != Types::Deposit && t.type != Types::TransferIn)continue;
+            const uint32_t day = pack_date(t.trans);
+            if(day < lo || day > hi)continue;
+            hand.Add(t.amount,t.currency);
+        }
+        h.Add(acc != nullptr,0,0);
+    }
+    h.ns = elapsed_ns(t0,BenchClock::now());
+    q.extra.emplace_back("matches",static_cast<double>(total.Count));
+    std::size_t entries = 0;
+    for(const auto& n : numbers) entries += bank.GetAccount(n)->GetTransactions().size();
+    q.extra.emplace_back("same_as_hand_loop",total.Count == hand.Count && std::fabs(static_cast<double>(total.Total - hand.Total)) < 1e-6 ? 1.0 : 0.0);
+    q.extra.emplace_back("entries_per_account",static_cast<double>(entries) / static_cast<double>(numbers.size()));
+    results.push_back(q);
+    results.push_back(h);
+
+    // Large transfers out to one counterparty over the whole history; no date pushdown.
+    const string& counterparty = numbers[0];
+    LedgerQuery large;
+    large.OfType(Types::TransferOut).WithCounterparty(counterparty).AmountAtLeast(50.0L);
+    BenchResult lq{"QueryLargeTransfersTo"};
+    uint64_t found = 0;
+    t0 = BenchClock::now();
+    for(const auto& n : numbers){
+        lq.Add(bank.Query(n,large,[&](const Account::Transaction&){ ++found; }),0,0);
+    }
+    lq.ns = elapsed_ns(t0,BenchClock::now());
+    BenchResult lh{"HandLoopLargeTransfersTo"};
+    uint64_t hand_found = 0;
+    t0 = BenchClock::now();
+    for(const auto& n : numbers){
+        const Account* acc = bank.GetAccount(n);
+        for(const auto& t : acc->GetTransactions()){
+            if(t.type == Types::TransferOut && t.amount >= 50.0L && (t.source == counterparty || t.destination == counterparty)) ++hand_found;
+        }
+        lh.Add(acc != nullptr,0,0);
+    }
+    lh.ns = elapsed_ns(t0,BenchClock::now());
+    lq.extra.emplace_back("matches",static_cast<double>(found));
+    lq.extra.emplace_back("same_as_hand_loop",found == hand_found ? 1.0 : 0.0);
+    results.push_back(lq);
+    results.push_back(lh);
+
+    // Bank-wide: withdrawals of at least 20 in one month.
+    LedgerQuery withdrawals;
+    withdrawals.OfType(Types::Withdraw).AmountAtLeast(20.0L).Between(from,to);
+    BenchResult aq{"QuerySummarizeAll"};
+    LedgerQuery::Summary all;
+    t0 = BenchClock::now();
+    aq.Add(bank.SummarizeAll(withdrawals,cfg.threads,all),0,0);
+    aq.ns = elapsed_ns(t0,BenchClock::now());
+    BenchResult ah{"HandLoopSummarizeAll"};
+    LedgerQuery::Summary all_hand;
+    t0 = BenchClock::now();
+    for(const auto& n : numbers){
+        for(const auto& t : bank.GetAccount(n)->GetTransactions()){
+            if(t.type != Types::Withdraw || t.amount < 20.0L)continue;
+            const uint32_t day = pack_date(t.trans);
+            if(day >= lo && day <= hi) all_hand.Add(t.amount,t.currency);
+        }
+    }
+    ah.Add(true,elapsed_ns(t0,BenchClock::now()),0);
+    aq.extra.emplace_back("threads",static_cast<double>(cfg.threads));
+    aq.extra.emplace_back("matches",static_cast<double>(all.Count));
+    aq.extra.emplace_back("same_as_hand_loop",all.Count == all_hand.Count ? 1.0 : 0.0);
+    results.push_back(aq);
+    results.push_back(ah);
+}
+
+// Bank-wide valuation in USD. The batch kernel values cfg.fx_accounts synthetic balances
+// (cents and a currency slot, 9 bytes each), against the per-account long double loop it
+// replaces; ValueInBase and cross-currency transfers run on cfg.hot_accounts accounts.
+static void run_fx(const BenchConfig& cfg,std::vector<BenchResult>& results){
+    const std::vector<Currency> currencies = {Currencies::USD,Currencies::EUR,Currencies::GBP,Currencies::JPY,
+                                              Currencies::CHF};
+    const long double rates[] = {1.0L,1.08L,1.27L,0.0067L,1.12L};
+    const Account::Date date = bench_date(0);
+    FxTable fx;
+    for(std::size_t k=1; k<currencies.size(); ++k) fx.SetRate(currencies[k],date,rates[k]);
+
+    std::mt19937_64 rng(cfg.seed);
+    std::vector<std::int64_t> cents(cfg.fx_accounts);
+    std::vector<std::uint8_t> slots(cfg.fx_accounts);
+    for(std::size_t i=0; i<cfg.fx_accounts; ++i){
+        const std::uint64_t r = rng();
+        cents[i] = static_cast<std::int64_t>(r % 10000000);
+        slots[i] = static_cast<std::uint8_t>(r >> 32) % 10 < 6 ? 0 : static_cast<std::uint8_t>(1 + (r >> 40) % 4);
+    }
+
+    BenchResult kernel{"FxValueBatch"};
+    FxTable::Valuation v;
+    std::uint64_t best = UINT64_MAX;
+    bool ok = true;
+    for(int rep=0; rep<3; ++rep){
+        auto t0 = BenchClock::now();
+        ok = fx.ValueBatch(cents.data(),slots.data(),cents.size(),currencies,date,v) && ok;
+        best = std::min(best,elapsed_ns(t0,BenchClock::now()));
+    }
+    kernel.Add(ok,best,0);
+    const double n = static_cast<double>(cfg.fx_accounts);
+    kernel.extra.emplace_back("accounts",n);
+    kernel.extra.emplace_back("ms",static_cast<double>(best) / 1e6);
+    kernel.extra.emplace_back("ns_per_account",static_cast<double>(best) / n);
+    kernel.extra.emplace_back("total_usd",static_cast<double>(v.TotalCents) / 100.0);
+
+    BenchResult naive{"FxValuePerAccountLongDouble"};
+    long double total = 0;
+    auto t0 = BenchClock::now();
+    for(std::size_t i=0; i<cents.size(); ++i) total += static_cast<long double>(cents[i]) / 100.0L * rates[slots[i]];
+    naive.Add(true,elapsed_ns(t0,BenchClock::now()),0);
+    naive.extra.emplace_back("ms",static_cast<double>(naive.ns) / 1e6);
+    naive.extra.emplace_back("ns_per_account",static_cast<double>(naive.ns) / n);
+    naive.extra.emplace_back("difference_cents",std::fabs(static_cast<double>(total * 100.0L) - static_cast<double>(v.TotalCents)));
+    results.push_back(kernel);
+    results.push_back(naive);
+    std::vector<std::int64_t>().swap(cents);
+    std::vector<std::uint8_t>().swap(slots);
+
+    // As in hotcold, members own several accounts each past 99999 accounts.
+    const std::size_t members = std::min<std::size_t>(cfg.hot_accounts,99999);
+    std::vector<Person> people;
+    people.reserve(members);
+    for(std::size_t i=0; i<members; ++i) people.push_back(bench_person(i));
+    Management bank;
+    bank.AttachFxTable(&fx);
+    std::vector<string> numbers;
+    numbers.reserve(cfg.hot_accounts);
+    string err;
+    for(std::size_t i=0; i<cfg.hot_accounts; ++i){
+        const Person& p = people[i % members];
+        if(bank.OpenAccount(p,1000.0L,bench_type(i),currencies[i % currencies.size()],date,&err)){
+            numbers.push_back(bank.GetAccountsOf(p.GetIdCode())->back());
+        }
+    }
+
+    BenchResult value{"FxValueInBase"};
+    FxTable::Valuation before;
+    t0 = BenchClock::now();
+    ok = bank.ValueInBase(fx,date,cfg.threads,before,&err);
+    value.Add(ok,elapsed_ns(t0,BenchClock::now()),0);
+    long double expected = 0;
+    for(std::size_t i=0; i<numbers.size(); ++i) expected += 1000.0L * rates[i % currencies.size()];
+    value.extra.emplace_back("threads",static_cast<double>(cfg.threads));
+    value.extra.emplace_back("accounts",static_cast<double>(before.Accounts));
+    value.extra.emplace_back("ns_per_account",static_cast<double>(value.ns) / static_cast<double>(std::max<std::size_t>(1,before.Accounts)));
+    value.extra.emplace_back("difference_cents",std::fabs(static_cast<double>(expected * 100.0L) - static_cast<double>(before.TotalCents)));
+
+    // Transfers between neighbours, which hold different currencies.
+    BenchResult xfer{"FxCrossCurrencyTransfer"};
+    for(std::size_t i=0; i<cfg.ops; ++i){
+        const std::size_t a = rng() % numbers.size(),b = (a + 1) % numbers.size();
+        const long double amount = 1.0L + static_cast<long double>(rng() % 10000) / 100.0L;
+        const std::uint64_t a0 = bench_alloc_count();
+        auto t1 = BenchClock::now();
+        const bool done = bank.TransferBetweenAccounts(numbers[a],numbers[b],amount,bench_date(1 + static_cast<int>(i % 300)),&err);
+        xfer.Add(done,elapsed_ns(t1,BenchClock::now()),bench_alloc_count() - a0);
+    }
+    FxTable::Valuation after;
+    bank.ValueInBase(fx,date,cfg.threads,after,&err);
+    // Only the rounding of each conversion to whole cents moves the bank's base value.
+    xfer.extra.emplace_back("base_drift_cents",static_cast<double>(after.TotalCents - before.TotalCents));
+    results.push_back(value);
+    results.push_back(xfer);
+}
+
+int main(int argc,char** argv){
+    BenchConfig cfg;
+    if(!parse_args(argc,argv,cfg)){
+        usage();
+        return 2;
+    }
+
+    std::vector<BenchResult> results;
+    if(suite_enabled(cfg,"mixed")) run_mixed(cfg,results);
+    if(suite_enabled(cfg,"stream")) run_stream(cfg,results);
+    if(suite_enabled(cfg,"statements")) run_statements(cfg,results);
+    if(suite_enabled(cfg,"policies")) run_policies(cfg,results);
+    if(suite_enabled(cfg,"dedup")) run_dedup(cfg,results);
+    if(suite_enabled(cfg,"velocity")) run_velocity(cfg,results);
+    if(suite_enabled(cfg,"screening")) run_screening(cfg,results);
+    if(suite_enabled(cfg,"graph")) run_graph(cfg,results);
+    if(suite_enabled(cfg,"journal")) run_journal(cfg,results);
+    if(suite_enabled(cfg,"members")) run_members(cfg,results);
+    if(suite_enabled(cfg,"checkpoint")) run_checkpoint(cfg,results);
+    if(suite_enabled(cfg,"archive")) run_archive(cfg,results);
+    if(suite_enabled(cfg,"search")) run_search(cfg,results);
+    if(suite_enabled(cfg,"payroll")) run_payroll(cfg,results);
+    if(suite_enabled(cfg,"orders")) run_orders(cfg,results);
+    if(suite_enabled(cfg,"hotcold")) run_hotcold(cfg,results);
+    if(suite_enabled(cfg,"numa")) run_numa(cfg,results);
+    if(suite_enabled(cfg,"query")) run_query(cfg,results);
+    if(suite_enabled(cfg,"fx")) run_fx(cfg,results);
+
+    std::vector<std::pair<std::string,double>> config = {
+            {"accounts",static_cast<double>(cfg.accounts)},
+            {"ops",static_cast<double>(cfg.ops)},
+            {"mix_deposit",cfg.mix[MixDeposit]},
+            {"mix_withdraw",cfg.mix[MixWithdraw]},
+            {"mix_transfer",cfg.mix[MixTransfer]},
+            {"mix_close",cfg.mix[MixClose]},
+            {"mix_scan",cfg.mix[MixScan]},
+            {"mix_serialize",cfg.mix[MixSerialize]},
+            {"zipf",cfg.zipf},
+            {"fail_rate",cfg.fail_rate},
+            {"seed",static_cast<double>(cfg.seed)},
+            {"consumers",static_cast<double>(cfg.consumers)},
+            {"ring",static_cast<double>(cfg.ring)},
+    };
+
+    std::FILE* out = stdout;
+    if(!cfg.out.empty() && !(out = std::fopen(cfg.out.c_str(),"w"))){
+        std::perror(cfg.out.c_str());
+        return 1;
+    }
+    string metrics_json;
+    if(cfg.metrics){
+        std::ostringstream os;
+        Metrics::DumpJson(os);
+        metrics_json = os.str();
+        metrics_json.pop_back();
+    }
+    write_json_results(out,config,results,metrics_json);
+    if(out != stdout) std::fclose(out);
+    return run_failed ? 1 : 0;
+}
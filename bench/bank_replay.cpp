@@ -0,0 +1,358 @@
+#include "Bank Management.h"
+#include "BenchCommon.h"
+#include "Trace.h"
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <unordered_map>
+
+
+struct ReplayConfig{
+    std::string trace;
+    std::string generate;
+    std::string out;
+    std::size_t accounts = 20000;
+    std::size_t ops = 200000;
+    std::size_t threads = 1;
+    unsigned seed = 42;
+};
+
+static void usage(){
+    std::fprintf(stderr,
+                 "usage: bank_replay TRACE [--threads N] [--out FILE]\n"
+                 "       bank_replay --generate TRACE [--accounts N] [--ops N] [--seed N]\n"
+                 "Replays a trace recorded with Management::AttachTrace against a fresh bank.\n"
+                 "One thread replays in trace order and must reproduce every outcome and final\n"
+                 "balance; more threads dispatch concurrently into the bank (calls serialised by\n"
+                 "a mutex, each waiting only for the OpenAccount it depends on).\n");
+}
+
+static bool parse_args(int argc,char** argv,ReplayConfig& cfg){
+    for(int i=1; i<argc; ++i){
+        std::string a = argv[i];
+        if(a == "--help" || a == "-h")return false;
+        if(a.compare(0,2,"--") != 0){
+            if(!cfg.trace.empty())return false;
+            cfg.trace = a;
+            continue;
+        }
+        if(i + 1 >= argc)return false;
+        const char* v = argv[++i];
+        if(a == "--generate") cfg.generate = v;
+        else if(a == "--accounts") cfg.accounts = std::strtoull(v,nullptr,10);
+        else if(a == "--ops") cfg.ops = std::strtoull(v,nullptr,10);
+        else if(a == "--threads") cfg.threads = std::max<std::size_t>(1,std::strtoull(v,nullptr,10));
+        else if(a == "--seed") cfg.seed = static_cast<unsigned>(std::strtoul(v,nullptr,10));
+        else if(a == "--out") cfg.out = v;
+        else return false;
+    }
+    if(cfg.generate.empty() == cfg.trace.empty())return false;
+    // IdCodes are at most 5 digits and every account gets its own member.
+    if(!cfg.generate.empty() && (cfg.accounts < 2 || cfg.accounts > 99999)){
+        std::fprintf(stderr,"--accounts must be in [2, 99999]\n");
+        return false;
+    }
+    return true;
+}
+
+
+// Records a synthetic day-by-day workload over a year through the traced Management API.
+static bool generate(const ReplayConfig& cfg){
+    Management bank;
+    TraceRecorder recorder;
+    string err;
+    if(!recorder.Open(cfg.generate,&err)){
+        std::fprintf(stderr,"%s\n",err.c_str());
+        return false;
+    }
+    bank.AttachTrace(&recorder);
+
+    std::vector<string> numbers;
+    for(std::size_t i=0; i<cfg.accounts; ++i){
+        Person p;
+        p.SetName("Replay",nullptr);
+        p.SetFamilyName("Owner",nullptr);
+        p.SetNationality("German",nullptr);
+        string id = std::to_string(i + 1);
+        p.SetIdCode(id.insert(0,5 - id.size(),'0'),nullptr);
+        p.SetGender(i % 2 ? "1" : "2",nullptr);
+        const auto type = static_cast<Account::AccountType>(i % 3);
+        if(bank.OpenAccount(p,1000.0L,type,bench_date(0))) numbers.push_back(bank.GetAccountsOf(p.GetIdCode())->back());
+    }
+
+    std::mt19937_64 rng(cfg.seed);
+    std::uniform_int_distribution<int> cents(1,50000);
+    ZipfGenerator zipf(numbers.size(),0.99);
+    const std::size_t per_day = std::max<std::size_t>(1,cfg.ops / 365);
+    for(std::size_t i=0; i<cfg.ops; ++i){
+        const int day = static_cast<int>(std::min<std::size_t>(364,i / per_day));
+        const Account::Date date = bench_date(day);
+        if(i % per_day == 0 && day % 30 == 29) bank.ApplyMonthlyInterest(date);
+
+        const std::size_t a = zipf(rng);
+        const long double amount = static_cast<long double>(cents(rng)) / 100.0L;
+        const unsigned pick = static_cast<unsigned>(rng() % 100);
+        if(pick < 35) bank.DepositAccount(numbers[a],amount,date);
+        else if(pick < 60) bank.WithdrawFromAccount(numbers[a],amount,date);
+        else if(pick < 99){
+            std::size_t b;
+            do{ b = zipf(rng); } while (b == a);
+            bank.TransferBetweenAccounts(numbers[a],numbers[b],amount,date);
+        }
+        else{
+            // Drain and close a random (not a hot) account; fixed deposits cannot withdraw
+            // cash, so their close is recorded as failing.
+            const string& number = numbers[rng() % numbers.size()];
+            const Account* acc = bank.GetAccount(number);
+            if(acc->GetBalance() > 0) bank.WithdrawFromAccount(number,acc->GetBalance(),date);
+            bank.CloseAccount(acc->GetOwner()->GetIdCode(),number,date);
+        }
+    }
+
+    const uint64_t recorded = recorder.Recorded();
+    if(!bank.FinishTrace(&err)){
+        std::fprintf(stderr,"%s\n",err.c_str());
+        return false;
+    }
+    std::fprintf(stderr,"recorded %llu calls and %zu balances to %s\n",
+                 static_cast<unsigned long long>(recorded),numbers.size(),cfg.generate.c_str());
+    return true;
+}
+
+
+// A trace call decoded ahead of time, so replay timing covers only the Management call.
+struct ReplayOp{
+    TraceOp::Kind Kind;
+    bool Ok;
+    Account::AccountType Type;
+    Account::Date Date;
+    long double Amount;
+    uint64_t Number,Counterparty;
+    Currency CurrencyCode;       // Open only
+    std::size_t PersonIndex;     // into Replayer::People
+    string Owner;
+    std::size_t DependsOn;       // OpenAccount that created the accounts used, or None
+};
+
+class Replayer{
+public:
+    static constexpr std::size_t None = SIZE_MAX;
+
+    bool Load(const std::vector<TraceOp>& trace,string* err){
+        std::unordered_map<uint64_t,std::size_t> opened;
+        std::unordered_map<uint64_t,Currency> currencies;
+        for(const TraceOp& t : trace){
+            if(t.Op == TraceOp::Kind::Balance){
+                Balances.push_back(t);
+                continue;
+            }
+            // The FX rates a converted transfer used are not in the trace.
+            if(t.Op == TraceOp::Kind::Transfer && t.Ok){
+                auto a = currencies.find(t.AccountNumber),b = currencies.find(t.Counterparty);
+                if(a != currencies.end() && b != currencies.end() && a->second != b->second){
+                    if(err) *err = "Error! trace has transfers between currencies, and FX rates are not recorded.";
+                    return false;
+                }
+            }
+            ReplayOp op{t.Op,t.Ok,t.Type,unpack_date(t.Date),t.Amount,
+                        t.AccountNumber,t.Counterparty,t.CurrencyCode,None,string(),None};
+            if(t.Op == TraceOp::Kind::AddPerson || t.Op == TraceOp::Kind::Open){
+                People.emplace_back();
+                if(!TraceOp::PersonFromStrings(t.Strings,People.back(),err))return false;
+                op.PersonIndex = People.size() - 1;
+            }
+            if(t.Op == TraceOp::Kind::Close && !t.Strings.empty()) op.Owner = t.Strings[0];
+            for(uint64_t number : {t.AccountNumber,t.Counterparty}){
+                auto it = opened.find(number);
+                if(t.Op != TraceOp::Kind::Open && it != opened.end())
+                    op.DependsOn = op.DependsOn == None ? it->second : std::max(op.DependsOn,it->second);
+            }
+            if(t.Op == TraceOp::Kind::Open && t.Ok){
+                opened.emplace(t.AccountNumber,Ops.size());
+                currencies[t.AccountNumber] = t.CurrencyCode;
+            }
+            Ops.push_back(std::move(op));
+        }
+        return true;
+    }
+
+    // Runs op i against the bank; the caller serialises calls.
+    bool Run(std::size_t i){
+        const ReplayOp& op = Ops[i];
+        switch(op.Kind){
+            case TraceOp::Kind::AddPerson:
+                return Bank.AddPerson(People[op.PersonIndex]);
+            case TraceOp::Kind::Open:{
+                const Person& p = People[op.PersonIndex];
+                if(!Bank.OpenAccount(p,op.Amount,op.Type,op.CurrencyCode,op.Date))return false;
+                Numbers[op.Number] = Bank.GetAccountsOf(p.GetIdCode())->back();
+                return true;
+            }
+            case TraceOp::Kind::Close:
+                return Bank.CloseAccount(op.Owner,Resolve(op.Number),op.Date);
+            case TraceOp::Kind::Deposit:
+                return Bank.DepositAccount(Resolve(op.Number),op.Amount,op.Date);
+            case TraceOp::Kind::Withdraw:
+                return Bank.WithdrawFromAccount(Resolve(op.Number),op.Amount,op.Date);
+            case TraceOp::Kind::Transfer:
+                return Bank.TransferBetweenAccounts(Resolve(op.Number),Resolve(op.Counterparty),op.Amount,op.Date);
+            case TraceOp::Kind::Interest:
+                return Bank.ApplyMonthlyInterest(op.Date);
+            default:
+                return false;
+        }
+    }
+
+    // Final balances against the trace; returns the number that differ.
+    std::size_t VerifyBalances(std::size_t& missing)const{
+        std::size_t mismatched = 0;
+        missing = 0;
+        for(const TraceOp& b : Balances){
+            auto it = Numbers.find(b.AccountNumber);
+            const Account* acc = it == Numbers.end() ? nullptr : Bank.GetAccount(it->second);
+            if(!acc){
+                ++missing;
+                continue;
+            }
+            mismatched += acc->GetBalance() != b.Amount || acc->is_closed() == b.Ok;
+        }
+        return mismatched;
+    }
+
+    std::vector<ReplayOp> Ops;
+    std::vector<TraceOp> Balances;
+    std::size_t Unresolved{0};
+
+private:
+    // Accounts opened before recording started are unknown here; their calls fail.
+    const string& Resolve(uint64_t recorded){
+        auto it = Numbers.find(recorded);
+        if(it != Numbers.end())return it->second;
+        ++Unresolved;
+        static const string unknown;
+        return unknown;
+    }
+
+    Management Bank;
+    std::vector<Person> People;
+    std::unordered_map<uint64_t,string> Numbers;   // recorded number -> number in this bank
+};
+
+
+static double percentile(std::vector<uint64_t>& v,double q){
+    if(v.empty())return 0;
+    const std::size_t k = std::min(v.size() - 1,static_cast<std::size_t>(q * static_cast<double>(v.size())));
+    std::nth_element(v.begin(),v.begin() + static_cast<std::ptrdiff_t>(k),v.end());
+    return static_cast<double>(v[k]);
+}
+
+static void add_latencies(BenchResult& r,std::vector<uint64_t>& ns){
+    r.extra.emplace_back("p50_ns",percentile(ns,0.50));
+    r.extra.emplace_back("p90_ns",percentile(ns,0.90));
+    r.extra.emplace_back("p99_ns",percentile(ns,0.99));
+    r.extra.emplace_back("p999_ns",percentile(ns,0.999));
+    r.extra.emplace_back("max_ns",ns.empty() ? 0.0 : static_cast<double>(*std::max_element(ns.begin(),ns.end())));
+}
+
+int main(int argc,char** argv){
+    ReplayConfig cfg;
+    if(!parse_args(argc,argv,cfg)){
+        usage();
+        return 2;
+    }
+    if(!cfg.generate.empty())return generate(cfg) ? 0 : 1;
+
+    std::vector<TraceOp> trace;
+    string err;
+    Replayer replay;
+    if(!ReadTrace(cfg.trace,trace,&err) || !replay.Load(trace,&err)){
+        std::fprintf(stderr,"%s: %s\n",cfg.trace.c_str(),err.c_str());
+        return 1;
+    }
+    trace.clear();
+    trace.shrink_to_fit();
+
+    const std::size_t n = replay.Ops.size();
+    std::vector<uint64_t> latency(n);
+    std::vector<uint8_t> outcome(n);
+    auto t0 = BenchClock::now();
+    if(cfg.threads == 1){
+        for(std::size_t i=0; i<n; ++i){
+            auto a = BenchClock::now();
+            outcome[i] = replay.Run(i);
+            latency[i] = elapsed_ns(a,BenchClock::now());
+        }
+    }
+    else{
+        std::unique_ptr<std::atomic<bool>[]> done(new std::atomic<bool>[n]);
+        for(std::size_t i=0; i<n; ++i) done[i].store(false,std::memory_order_relaxed);
+        std::atomic<std::size_t> next{0};
+        std::mutex bank_lock;
+        std::vector<std::thread> workers;
+        for(std::size_t t=0; t<cfg.threads; ++t){
+            workers.emplace_back([&]{
+                for(std::size_t i; (i = next.fetch_add(1,std::memory_order_relaxed)) < n; ){
+                    const std::size_t dep = replay.Ops[i].DependsOn;
+                    while(dep != Replayer::None && !done[dep].load(std::memory_order_acquire)) std::this_thread::yield();
+                    auto a = BenchClock::now();
+                    {
+                        std::lock_guard<std::mutex> g(bank_lock);
+                        outcome[i] = replay.Run(i);
+                    }
+                    latency[i] = elapsed_ns(a,BenchClock::now());
+                    done[i].store(true,std::memory_order_release);
+                }
+            });
+        }
+        for(auto& w : workers) w.join();
+    }
+    const uint64_t total_ns = elapsed_ns(t0,BenchClock::now());
+
+    std::vector<BenchResult> results;
+    std::size_t mismatches = 0;
+    for(std::size_t k=0; k<static_cast<std::size_t>(TraceOp::Kind::Balance); ++k){
+        BenchResult r{TraceOp::KindToString(static_cast<TraceOp::Kind>(k))};
+        std::vector<uint64_t> ns;
+        std::size_t differ = 0;
+        for(std::size_t i=0; i<n; ++i){
+            if(static_cast<std::size_t>(replay.Ops[i].Kind) != k)continue;
+            r.Add(outcome[i],latency[i],0);
+            ns.push_back(latency[i]);
+            differ += (outcome[i] != 0) != replay.Ops[i].Ok;
+        }
+        if(!r.ops)continue;
+        add_latencies(r,ns);
+        r.extra.emplace_back("outcome_mismatches",static_cast<double>(differ));
+        mismatches += differ;
+        results.push_back(r);
+    }
+
+    std::size_t missing = 0;
+    const std::size_t balance_mismatches = replay.VerifyBalances(missing);
+    BenchResult all{"Replay"};
+    for(std::size_t i=0; i<n; ++i) all.Add(outcome[i],0,0);
+    all.ns = total_ns;
+    add_latencies(all,latency);
+    all.extra.emplace_back("outcome_mismatches",static_cast<double>(mismatches));
+    all.extra.emplace_back("unresolved_accounts",static_cast<double>(replay.Unresolved));
+    all.extra.emplace_back("balances_checked",static_cast<double>(replay.Balances.size()));
+    all.extra.emplace_back("balances_missing",static_cast<double>(missing));
+    all.extra.emplace_back("balance_mismatches",static_cast<double>(balance_mismatches));
+    const bool verified = mismatches == 0 && missing == 0 && balance_mismatches == 0;
+    all.extra.emplace_back("verified",verified ? 1.0 : 0.0);
+    results.push_back(all);
+
+    std::vector<std::pair<std::string,double>> config = {
+            {"threads",static_cast<double>(cfg.threads)},
+            {"calls",static_cast<double>(n)},
+    };
+    std::FILE* out = stdout;
+    if(!cfg.out.empty() && !(out = std::fopen(cfg.out.c_str(),"w"))){
+        std::perror(cfg.out.c_str());
+        return 1;
+    }
+    write_json_results(out,config,results);
+    if(out != stdout) std::fclose(out);
+    // Only the in-order replay is expected to reproduce the recording exactly.
+    return verified || cfg.threads > 1 ? 0 : 1;
+}
@@ -2,28 +2,54 @@
 #define BANK_ACCOUNT_ACCOUNT_H
 
 #include "Person.h"
+#include "MemberStore.h"
+#include "VelocityWindow.h"
+#include "Currency.h"
 #include <iostream>
 #include <fstream>
+#include <memory>
 #include <string>
 #include <vector>
 
-
+class TransactionStream;
+class Journal;
+class LedgerArchive;
 
 class Account{
 public:
     Account()=default;
     enum class TransactionTypes{Deposit,Withdraw,TransferIn,TransferOut,Open,Close};
     enum class AccountType{CheckingAccount,SavingAccount,FixedDepositAccount};
+
+    // The fields every balance operation reads or writes, one cache line per account.
+    // Management keeps them densely in a HotStore; the rest of Account is the cold side.
+    struct alignas(64) HotFields{
+        long double Balance{};
+        long double DailyWithdrawLimit{};
+        long double DailyTransferLimit{};
+        AccountType Type{AccountType::CheckingAccount};
+        Currency CurrencyCode{Currencies::USD};
+        bool Closed{false};
+        bool Dirty{false};
+    };
     struct Date{
         string day,month,year;
     };
 
+    // Ledger length, balance and journal head, to undo appends made after it was taken.
+    struct LedgerMark{
+        size_t Entries{};
+        long double Balance{};
+        uint64_t JournalHead{};
+    };
+
     struct Transaction{
         Date trans;
         long double amount{};
         string source,destination;
         TransactionTypes type;
         long double balance_after{};
+        Currency currency{Currencies::USD};     // of amount and balance_after: the account's
 
     };
 
@@ -32,41 +58,142 @@ public:
     [[nodiscard]] string GetAccountNumber()const;
     [[nodiscard]] long double GetBalance()const;
     [[nodiscard]] AccountType GetAccountType()const;
+    [[nodiscard]] Currency GetCurrency()const;
     [[nodiscard]] static const char* AccountTypeToString(AccountType);
     [[nodiscard]] static const char* TransactionTypeToString(TransactionTypes);
     [[nodiscard]] const Date& GetOpeningsDate()const;
     [[nodiscard]] const vector<Transaction> &GetTransactions()const;
+    [[nodiscard]] MemberId GetOwnerId()const;
+    [[nodiscard]] const Person* GetOwner()const;
     [[nodiscard]] bool is_closed()const;
     void SetClosed(bool);
     void DisplayAccountInfo()const;
     void DisplayTransactions()const;
-    void SaveToFile(ostream&)const;
+    // Pass the bank's archive (Management::GetArchive) once entries have been archived,
+    // or only the in-memory part of the history is written.
+    void SaveToFile(ostream&,const LedgerArchive* archive = nullptr)const;
 
 
-    bool SetOwner(Person,std::string *err= nullptr);
+    bool SetOwner(const MemberStore&,MemberId,std::string *err= nullptr);
     bool SetInitialBalance(long double,string *err = nullptr);
     bool SetAccountNumber(string* err = nullptr);
     bool SetOpeningsDate(const string&,const string&,const string&,string* err = nullptr);
     bool Deposit(long double,const Date&,string* err = nullptr);
     bool Withdraw(long double,const Date&,string* err = nullptr);
     bool SetAccountType(AccountType,string* err = nullptr);
+    // Balance and ledger are kept in this currency; it can only change before the first entry.
+    bool SetCurrency(Currency,string* err = nullptr);
     bool Transfer(Account&,long double,const Date&,string* err = nullptr);
     bool CloseAccount(string* err = nullptr);
     bool AppendTransaction(TransactionTypes,long double,const string&,const string&,const Date&,string* err = nullptr);
+    bool PostInterest(const Date&,string* err = nullptr);
+
+    // Policy-specialised bodies (see AccountPolicy.h); the untemplated calls dispatch on AccType.
+    template<class Policy> bool WithdrawAs(long double,const Date&,string* err = nullptr);
+    template<class Policy> bool TransferAs(Account&,long double,const Date&,string* err = nullptr);
+    template<class Policy> bool PostInterestAs(const Date&,string* err = nullptr);
+    void AttachStream(TransactionStream*);
+    void AttachJournal(Journal*);
+    // Sequence of this account's newest journal record (Journal::None if none).
+    [[nodiscard]] uint64_t GetJournalHead()const;
+    // Checkpoint bookkeeping: MarkDirty returns true when the account was clean; the
+    // watermark is the number of ledger entries already in a checkpoint, counted over
+    // the full history including archived entries.
+    bool MarkDirty();
+    [[nodiscard]] size_t GetCheckpointWatermark()const;
+    void MarkCheckpointed();
+    // Drops the oldest n ledger entries once they are archived (see LedgerArchive) and
+    // returns their memory; GetTransactions then holds only the newer ones.
+    void ReleaseLedgerPrefix(size_t n);
+    [[nodiscard]] uint64_t GetArchivedCount()const;
+    // True while every entry was appended with a date no earlier than the one before,
+    // so the in-memory ledger can be searched by date (see LedgerQuery).
+    [[nodiscard]] bool LedgerInDateOrder()const;
+
+    // Whether `total` can leave by transfer on this date under the type's balance rules
+    // and the daily limit, without changing anything; used to validate multi-leg transfers.
+    // Funds are compared in whole cents.
+    bool CanTransferOut(long double total,const Date&,string* err = nullptr)const;
+    // Books a transfer of whole cents without Transfer's balance, limit and account
+    // checks, for callers that validated the whole operation in cents (CanTransferOut).
+    // The balances move by exactly the booked amount; sub-cent parts such as accrued
+    // interest are kept. Fails only if an entry is rejected (including a source that
+    // would end below zero), changing nothing.
+    bool ApplyTransfer(Account& destination,int64_t cents,const Date&,string* err = nullptr);
+    [[nodiscard]] LedgerMark GetLedgerMark()const;
+    // Drops entries appended since the mark and restores balance, velocity and journal
+    // head. A mark taken no later than DeferPublication also ends the deferral. Only
+    // unpublished entries may be rolled back: published ones are in the journal for good.
+    void RollbackTo(const LedgerMark&);
+    // Entries appended from here on reach the journal and the stream only at
+    // PublishDeferred, so an operation that rolls them back publishes nothing. Without
+    // a deferral each entry is published as it is appended.
+    void DeferPublication();
+    [[nodiscard]] bool IsDeferring()const;
+    // Publishes the deferred entries of the accounts, in order and with consecutive
+    // journal records, and ends their deferral. Publishes nothing and fails when the
+    // journal cannot take them all; the caller then rolls the entries back.
+    static bool PublishDeferred(Account* const* accounts,size_t n,string* err = nullptr);
+    void ReserveTransactions(size_t additional);
+    // The two halves of a transfer whose other account lives in another Management
+    // (see PartitionedBank); the counterparty is only named in the ledger entry.
+    bool TransferOutTo(const string& destination,long double,const Date&,string* err = nullptr);
+    bool TransferInFrom(const string& source,long double,const Date&,string* err = nullptr);
+
+    // Daily outflow limits checked in O(1) against the velocity window; 0 disables a limit.
+    bool SetDailyLimits(long double withdraw,long double transfer,string* err = nullptr);
+    [[nodiscard]] const VelocityWindow& GetVelocity()const;
+    // Recomputes the window from the ledger, e.g. after restoring persisted state.
+    void RebuildVelocity();
+    // Moves the hot fields into slot, which must outlive the account (see HotStore).
+    void BindHot(HotFields* slot);
 
 
 
 
 
 private:
+    // Points at a private HotFields until BindHot; a copy gets its own record, a move
+    // takes the pointer and leaves the source assignable only.
+    class HotHandle{
+    public:
+        HotHandle() : Own(make_unique<HotFields>()),Ptr(Own.get()){}
+        HotHandle(const HotHandle& o) : Own(make_unique<HotFields>(*o.Ptr)),Ptr(Own.get()){}
+        HotHandle(HotHandle&& o) noexcept : Own(std::move(o.Own)),Ptr(o.Ptr){ o.Ptr = nullptr; }
+        HotHandle& operator=(const HotHandle& o);
+        HotHandle& operator=(HotHandle&& o) noexcept;
+        void Bind(HotFields* slot);
+        HotFields* operator->()const{ return Ptr; }
+    private:
+        unique_ptr<HotFields> Own;
+        HotFields* Ptr;
+    };
+
+    HotHandle Hot;
     string AccountNumber;
-    Person person;
-    long double Balance{};
-    AccountType AccType{AccountType::CheckingAccount};
-    Date OpeningsDate;
-    bool Account_is_closed = {false};
     vector<Transaction> AccountTransactions;
+    Journal* JournalLog{nullptr};
+    uint64_t JournalHead{UINT64_MAX};
+    TransactionStream* Stream{nullptr};
+    const MemberStore* Members{nullptr};
+    MemberId Owner{MemberStore::NoMember};
+    size_t CheckpointWatermark{0};
+    uint64_t ArchivedEntries{0};
+    uint32_t NewestDate{0};
+    bool DateOrdered{true};
+    bool Deferring{false};
+    size_t DeferredFrom{0};
+    Date OpeningsDate;
+    VelocityWindow Velocity;
     static bool TransactionValidation(const Transaction&,string* err = nullptr);
+    void RecordVelocity(const Transaction&);
+    // Sends entries [first, end) to the journal and the stream; fails, sending nothing,
+    // when the journal is full.
+    bool Publish(size_t first,string* err);
+    // Sets both balances and appends the two entries of a transfer, publishing them
+    // together unless a caller is deferring.
+    bool Book(Account& destination,long double amount,long double balance,long double destination_balance,
+              const Date&,string* err);
 
 };
 
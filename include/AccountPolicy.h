@@ -0,0 +1,52 @@
+
+#ifndef BANK_ACCOUNT_ACCOUNT_POLICY_H
+#define BANK_ACCOUNT_ACCOUNT_POLICY_H
+
+#include "Account.h"
+
+// Per-type rules resolved at compile time. Account dispatches on AccType once per
+// call (or Management once per type group) and runs a specialised body.
+struct CheckingPolicy{
+    static constexpr Account::AccountType Type = Account::AccountType::CheckingAccount;
+    static constexpr long double MinimumBalance = 0.0L;
+    static constexpr long double Overdraft = 0.0L;
+    static constexpr bool AllowsCashWithdraw = true;
+    static constexpr long double AnnualInterest = 0.0L;
+};
+
+struct SavingPolicy{
+    static constexpr Account::AccountType Type = Account::AccountType::SavingAccount;
+    static constexpr long double MinimumBalance = 0.0L;
+    static constexpr long double Overdraft = 0.0L;
+    static constexpr bool AllowsCashWithdraw = true;
+    static constexpr long double AnnualInterest = 0.015L;
+};
+
+// Funds leave a fixed deposit only by transfer, never as cash.
+struct FixedDepositPolicy{
+    static constexpr Account::AccountType Type = Account::AccountType::FixedDepositAccount;
+    static constexpr long double MinimumBalance = 0.0L;
+    static constexpr long double Overdraft = 0.0L;
+    static constexpr bool AllowsCashWithdraw = false;
+    static constexpr long double AnnualInterest = 0.03L;
+};
+
+constexpr std::size_t AccountTypeCount = 3;
+
+static inline std::size_t account_type_index(Account::AccountType t){
+    return static_cast<std::size_t>(t);
+}
+
+// Calls fn with the policy object matching t.
+template<class Fn>
+decltype(auto) with_policy(Account::AccountType t,Fn&& fn){
+    switch (t) {
+        case Account::AccountType::SavingAccount:return fn(SavingPolicy{});
+        case Account::AccountType::FixedDepositAccount:return fn(FixedDepositPolicy{});
+        case Account::AccountType::CheckingAccount:break;
+    }
+    return fn(CheckingPolicy{});
+}
+
+
+#endif //BANK_ACCOUNT_ACCOUNT_POLICY_H
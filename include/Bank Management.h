@@ -5,27 +5,206 @@
 
 #include <iostream>
 #include <string>
+#include <array>
+#include <deque>
+#include <memory>
 #include <unordered_map>
 
 #include "Person.h"
 #include "Account.h"
+#include "StatementWriter.h"
+#include "AccountPolicy.h"
+#include "DedupCache.h"
+#include "TransferGraph.h"
+#include "Journal.h"
+#include "MemberStore.h"
+#include "Checkpointer.h"
+#include "LedgerArchive.h"
+#include "PrefixIndex.h"
+#include "HotStore.h"
+#include "LedgerQuery.h"
+#include "FxTable.h"
 
 using Date = Account::Date;
 
+class TraceRecorder;
+
 class Management{
+public:
+    struct TransferLeg{
+        string Source,Destination;
+        long double Amount{};
+    };
+
 private:
-    unordered_map<string,Account> KeepAccounts;
+    // Account i keeps its hot fields in HotRecords.At(i); Accounts is the cold side.
+    // The index holds the pointer too, so a lookup does not go through the deque map.
+    struct AccountRef{
+        Account* Cold;
+        uint32_t Index;
+    };
+    HotStore HotRecords;
+    deque<Account> Accounts;
+    unordered_map<string,AccountRef> AccountIndex;
     unordered_map<string,vector<string>> AccountsByOwner;
-    unordered_map<string,Person> MembersById;
+    unique_ptr<MemberStore> Members{make_unique<MemberStore>()};  // heap-held: accounts point at it
+    array<vector<Account*>,AccountTypeCount> AccountsByType;
+    TransactionStream* Stream{nullptr};
+    Journal* JournalLog{nullptr};
+    TraceRecorder* Trace{nullptr};
+    const FxTable* Fx{nullptr};
+    // Scratch reused by TransferMultiLeg: one claim per account it touches.
+    struct LegClaim{
+        uint64_t Key;            // packed account number, the canonical order
+        Account* Acc;
+        int64_t Out,In;          // cents
+        size_t Entries;
+        Account::LedgerMark Mark;
+    };
+    vector<LegClaim> Claims;
+    vector<pair<Account*,Account*>> LegAccounts;
+    vector<Account*> ClaimedAccounts;   // Claims' accounts, for Account::PublishDeferred
+    unique_ptr<DedupCache> Dedup;
+    vector<Account*> DirtyAccounts;
+    unique_ptr<LedgerArchive> Archive;
+    PrefixIndex AccountNumbers{10};
+    PrefixIndex IdCodes{5};
+    uint32_t NumberPart{0},NumberParts{1};
+
+    template<class Fn>
+    bool RunOnce(uint64_t key,string* err,Fn&& op);
+    void MarkDirty(Account&);
+    // Adds a member whose IdCode is known to be new and not empty.
+    bool RegisterPerson(const Person&,string* err);
+    Account* FindAccount(const string&);
+    bool TransferConverted(Account& source,Account& destination,long double,const Date&,string* err);
+    template<class Fn>
+    size_t QueryAccount(const Account&,const LedgerQuery&,Fn& fn)const;
 
 
 public:
     bool OpenAccount(const Person&,long double,Account::AccountType,const Date&,string* err = nullptr);
+    // Opens the account in a currency other than the default USD. Traces do not record
+    // the currency, so a replay reopens such accounts in USD.
+    bool OpenAccount(const Person&,long double,Account::AccountType,Currency,const Date&,string* err = nullptr);
     bool CloseAccount(const string&,const string&,const Date&,string* err = nullptr);
     bool DepositAccount(const string&,long double,const Date&,string* err = nullptr);
     bool WithdrawFromAccount(const string&,long double,const Date&,string* err = nullptr);
+    // Between accounts of different currencies the amount is in the source currency and
+    // the destination is credited the amount converted at the attached FxTable's rates
+    // for the date (see AttachFxTable).
     bool TransferBetweenAccounts(const string&,const string&,long double,const Date&,string* err = nullptr);
     bool AddPerson(const Person&,string* err = nullptr);
+    // Applies every leg or none (payroll, split payments). All legs must be in one
+    // currency and are booked in whole cents. They are validated first, with each
+    // account's outgoing legs summed; credits do not fund debits of the same call. The accounts are claimed in
+    // account-number order. Entries reach the journal and the stream only once every
+    // leg is booked, each account's together and in that order, as consecutive journal
+    // records; sequence gets the first one. On failure nothing is published.
+    bool TransferMultiLeg(const vector<TransferLeg>&,const Date&,uint64_t* sequence = nullptr,string* err = nullptr);
+    // Credits a month of interest, one monomorphic loop per account type.
+    bool ApplyMonthlyInterest(const Date&,size_t* credited = nullptr,string* err = nullptr);
+
+    // Idempotent variants: a repeated non-zero key returns the first call's result
+    // (bool and error text) without executing again. Key 0 means "no key".
+    bool OpenAccount(uint64_t key,const Person&,long double,Account::AccountType,const Date&,string* err = nullptr);
+    bool CloseAccount(uint64_t key,const string&,const string&,const Date&,string* err = nullptr);
+    bool DepositAccount(uint64_t key,const string&,long double,const Date&,string* err = nullptr);
+    bool WithdrawFromAccount(uint64_t key,const string&,long double,const Date&,string* err = nullptr);
+    bool TransferBetweenAccounts(uint64_t key,const string&,const string&,long double,const Date&,string* err = nullptr);
+    bool AddPerson(uint64_t key,const Person&,string* err = nullptr);
+    bool ApplyMonthlyInterest(uint64_t key,const Date&,string* err = nullptr);
+
+    bool SetDailyLimits(const string&,long double withdraw,long double transfer,string* err = nullptr);
+
+    // Debit and credit halves of a transfer whose other account is in another
+    // Management (PartitionedBank). Not idempotent and not traced. TransferIn takes the
+    // remote account's currency and refuses a credit in another currency.
+    bool TransferOut(const string& source,const string& remote_destination,long double,const Date&,string* err = nullptr);
+    bool TransferIn(const string& destination,const string& remote_source,long double,Currency remote_currency,
+                    const Date&,string* err = nullptr);
+    // New account numbers n satisfy n % parts == part, so a partitioned bank can tell
+    // the owning partition from the number alone.
+    bool SetNumberPartition(uint32_t part,uint32_t parts,string* err = nullptr);
+
+    // Sizes the dedup cache (created with 64K entries on first keyed call otherwise).
+    void EnableIdempotency(size_t capacity,uint32_t bucket_seconds = 60,uint32_t buckets = 10);
+    [[nodiscard]] DedupCache* GetDedupCache()const;
+
+    [[nodiscard]] const Account* GetAccount(const string&)const;
+    // Reads only the account's hot record, not the Account object.
+    bool GetBalance(const string&,long double& out,string* err = nullptr)const;
+    [[nodiscard]] const vector<string>* GetAccountsOf(const string&)const;
+    [[nodiscard]] size_t AccountCount()const;
+    [[nodiscard]] const HotStore& GetHotStore()const;
+    [[nodiscard]] const MemberStore& GetMembers()const;
+    // Up to limit account numbers / member IdCodes starting with prefix, ascending.
+    bool FindAccountsByPrefix(const string& prefix,size_t limit,vector<string>& out,string* err = nullptr)const;
+    bool FindMembersByPrefix(const string& prefix,size_t limit,vector<string>& out,string* err = nullptr)const;
+
+    // Formats every account (ordered by number) on up to `threads` threads into
+    // per-thread buffers and writes each round with a single writev to fd.
+    bool ExportStatements(int fd,StatementWriter::Format,size_t threads,string* err = nullptr)const;
+
+    // Values every open account in the FX table's base currency on a date, on up to
+    // `threads` threads: balances are gathered from the hot records as cents in chunks
+    // and summed per currency by FxTable::AccumulateBySlot, then each currency's total
+    // is converted once.
+    bool ValueInBase(const FxTable&,const Date&,size_t threads,FxTable::Valuation& out,string* err = nullptr)const;
+
+    // Builds the transfer graph of all accounts for [from, to] on up to `threads` threads;
+    // fails when they are in more than one currency. The second form takes only the
+    // accounts held in `currency`.
+    bool BuildTransferGraph(const Date& from,const Date& to,size_t threads,TransferGraph& out,string* err = nullptr)const;
+    bool BuildTransferGraph(const Date& from,const Date& to,Currency,size_t threads,TransferGraph& out,
+                            string* err = nullptr)const;
+    // Money in and out of all accounts of an owner, transfers between them excluded.
+    bool OwnerFlow(const TransferGraph&,const string& owner,TransferGraph::Flow& out,string* err = nullptr)const;
+
+    // Copies the accounts changed since the last capture (and their new ledger entries)
+    // into cut and marks them clean. Costs O(changed), not O(accounts); see Checkpointer.
+    void CaptureCheckpoint(CheckpointCut& cut);
+
+    struct ArchiveStats{
+        size_t Accounts{};          // accounts that moved entries out
+        size_t ClosedAccounts{};    // of those, closed accounts emptied entirely
+        uint64_t Entries{};
+        uint64_t Bytes{};           // archive file growth
+    };
+    // Opens (or reopens) the archive file that ArchiveLedgers moves old entries into.
+    bool EnableArchive(const string& path,string* err = nullptr);
+    [[nodiscard]] const LedgerArchive* GetArchive()const;
+    // Moves the whole ledger of closed accounts, and the entries of open accounts dated
+    // more than max_age_days before today, into the archive; memory is released only
+    // after the archive write is synced.
+    bool ArchiveLedgers(const Date& today,uint32_t max_age_days,ArchiveStats* stats = nullptr,string* err = nullptr);
+    // Calls fn(const Account::Transaction&) for an account's full history, archived
+    // entries first; GetTransactions holds only the part still in memory.
+    template<class Fn>
+    bool ForEachTransaction(const string& account_number,Fn&& fn,string* err = nullptr)const;
+
+    // Runs a LedgerQuery over an account's full history, archived part first; archive
+    // segments outside the query's dates are not read. fn(const Account::Transaction&)
+    // is called for each match.
+    template<class Fn>
+    bool Query(const string& account_number,const LedgerQuery&,Fn&& fn,string* err = nullptr)const;
+    bool Summarize(const string& account_number,const LedgerQuery&,LedgerQuery::Summary& out,string* err = nullptr)const;
+    // The query's matches over every account, on up to `threads` threads (Limit applies
+    // per account). Fails when they are in more than one currency; see InCurrency.
+    bool SummarizeAll(const LedgerQuery&,size_t threads,LedgerQuery::Summary& out,string* err = nullptr)const;
+
+    // Publishes every ledger entry of existing and future accounts; nullptr detaches.
+    void AttachStream(TransactionStream*);
+    // Appends every later ledger entry to the journal; nullptr detaches.
+    void AttachJournal(Journal*);
+    // Rates for cross-currency transfers; the table must outlive the attachment and
+    // nullptr detaches.
+    void AttachFxTable(const FxTable*);
+    // Records every later call (arguments and outcome) for bank_replay; nullptr detaches.
+    // Attach to an empty bank so the replay can rebuild the same state from the trace.
+    void AttachTrace(TraceRecorder*);
+    // Appends the final balance of every account, closes the trace and detaches it.
+    bool FinishTrace(string* err = nullptr);
 
 
 
@@ -33,6 +212,58 @@ public:
 };
 
 
+template<class Fn>
+bool Management::ForEachTransaction(const string &account_number, Fn &&fn, string *err) const {
+    const Account* acc = GetAccount(account_number);
+    if(!acc){
+        if(err) *err = "Error! account not found.";
+        return false;
+    }
+    if(Archive && acc->GetArchivedCount()){
+        Account::Transaction t;
+        Archive->ForEach(account_number,[&](const PackedTransaction& p){
+            p.UnpackInto(t);
+            fn(static_cast<const Account::Transaction&>(t));
+        });
+    }
+    for(const auto& t : acc->GetTransactions()) fn(t);
+    if(err) err->clear();
+    return true;
+}
+
+template<class Fn>
+size_t Management::QueryAccount(const Account &acc, const LedgerQuery &q, Fn &fn) const {
+    size_t matches = 0;
+    const size_t limit = q.GetLimit();
+    if(Archive && acc.GetArchivedCount()){
+        const uint32_t from = q.FromDate(),to = q.ToDate();
+        Account::Transaction t;
+        auto visit = [&](const PackedTransaction& p){
+            if(matches >= limit || p.Date < from || p.Date > to)return;
+            p.UnpackInto(t);
+            if(!q.Matches(t))return;
+            fn(static_cast<const Account::Transaction&>(t));
+            ++matches;
+        };
+        if(q.HasDateRange()) Archive->ForEachOverlapping(acc.GetAccountNumber(),from,to,visit);
+        else Archive->ForEach(acc.GetAccountNumber(),visit);
+    }
+    if(matches < limit) matches += q.Run(acc,fn,limit - matches);
+    return matches;
+}
+
+template<class Fn>
+bool Management::Query(const string &account_number, const LedgerQuery &q, Fn &&fn, string *err) const {
+    const Account* acc = GetAccount(account_number);
+    if(!acc){
+        if(err) *err = "Error! account not found.";
+        return false;
+    }
+    QueryAccount(*acc,q,fn);
+    if(err) err->clear();
+    return true;
+}
+
 
 
 
@@ -0,0 +1,110 @@
+
+#ifndef BANK_ACCOUNT_CHECKPOINTER_H
+#define BANK_ACCOUNT_CHECKPOINTER_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Account.h"
+#include "PackedTransaction.h"
+
+class Management;
+class Journal;
+
+// Everything that changed since the previous checkpoint, copied out of the bank in one
+// step. Entries hold only the ledger suffix each account appended since then, in a
+// fixed-size form so the copy does not touch strings.
+struct CheckpointCut{
+    struct AccountImage{
+        string Number;
+        string Owner;
+        long double Balance{};
+        Account::AccountType Type{};
+        Currency CurrencyCode{};
+        bool Closed{};
+        Account::Date OpeningsDate;
+        size_t FirstEntry{};     // full-history index of Entries[EntryBegin], archived entries included
+        size_t EntryBegin{},EntryEnd{};
+    };
+    vector<AccountImage> Accounts;
+    vector<PackedTransaction> Entries;
+    uint64_t JournalSequence{};  // journal records before this are covered once written
+    uint64_t Number{};           // assigned by the Checkpointer
+};
+
+
+// What a checkpoint file holds once its cuts are replayed in order: the newest image of
+// every account and its whole ledger.
+struct CheckpointState{
+    struct AccountState{
+        string Number;
+        string Owner;
+        long double Balance{};
+        Account::AccountType Type{};
+        Currency CurrencyCode{};
+        bool Closed{};
+        Account::Date OpeningsDate;
+        vector<Account::Transaction> Entries;
+    };
+    vector<AccountState> Accounts;   // in the order they first appear
+    uint64_t Checkpoints{};
+    uint64_t JournalSequence{};      // journal records before this are in the file
+};
+
+
+// Incremental snapshots on a background thread. Checkpoint() captures the dirty accounts
+// on the caller's thread (the only pause, proportional to what changed), then a writer
+// thread appends the cut to the checkpoint file and fsyncs it. Writers keep running
+// while the file is written. The journal prefix a durable cut covers is truncated on
+// the caller's thread, by the next Checkpoint() or Wait(), since Truncate must not run
+// alongside journal readers.
+class Checkpointer{
+public:
+    struct Stats{
+        uint64_t Checkpoints{},Accounts{},Entries{},Bytes{};
+        uint64_t LastPauseNs{},LastWriteNs{},MaxPauseNs{},TotalPauseNs{},TotalWriteNs{};
+        uint64_t JournalTruncatedTo{};
+    };
+
+    // journal may be nullptr; otherwise it is truncated once a checkpoint is durable.
+    explicit Checkpointer(string path,Journal* journal = nullptr);
+    ~Checkpointer();
+    Checkpointer(const Checkpointer&) = delete;
+    Checkpointer& operator=(const Checkpointer&) = delete;
+
+    // Fails without capturing when the previous checkpoint is still being written.
+    // Cuts whose write failed are kept and written again ahead of the next one.
+    bool Checkpoint(Management&,string* err = nullptr);
+    // Waits for the write in flight, if any, and returns its outcome.
+    bool Wait(string* err = nullptr);
+    [[nodiscard]] bool Busy()const;
+    [[nodiscard]] Stats GetStats()const;
+
+    // Reads a checkpoint file back. Fails on a malformed file or a cut whose ledger
+    // suffix does not continue the account's earlier entries.
+    static bool Load(const string& path,CheckpointState& out,string* err = nullptr);
+
+private:
+    void Write(vector<CheckpointCut> cuts);
+    // Truncates the journal up to the last durable cut; caller's thread only.
+    void TruncateJournal();
+
+    string Path;
+    Journal* JournalLog;
+    CheckpointCut Spare;      // buffers handed back by the writer, reused by the next capture
+    std::thread Writer;
+    std::atomic<bool> Writing{false};
+    bool WriteOk{true};
+    string WriteError;
+    vector<CheckpointCut> Retry;
+    uint64_t Durable{0};      // journal sequence the written cuts cover
+    mutable std::mutex StatsLock;
+    Stats Totals;
+};
+
+
+#endif //BANK_ACCOUNT_CHECKPOINTER_H
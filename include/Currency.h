@@ -0,0 +1,64 @@
+#ifndef BANK_ACCOUNT_CURRENCY_H
+#define BANK_ACCOUNT_CURRENCY_H
+
+#include <cctype>
+#include <cstdint>
+#include <string>
+
+// ISO 4217 code ("EUR") packed into an integer, so it fits the hot record and compares
+// as one word. 0 is no currency.
+using Currency = uint32_t;
+
+constexpr Currency make_currency(const char (&code)[4]){
+    return (static_cast<uint32_t>(static_cast<unsigned char>(code[0])) << 16) |
+           (static_cast<uint32_t>(static_cast<unsigned char>(code[1])) << 8) |
+           static_cast<uint32_t>(static_cast<unsigned char>(code[2]));
+}
+
+namespace Currencies{
+    constexpr Currency USD = make_currency("USD");
+    constexpr Currency EUR = make_currency("EUR");
+    constexpr Currency GBP = make_currency("GBP");
+    constexpr Currency JPY = make_currency("JPY");
+    constexpr Currency CHF = make_currency("CHF");
+}
+
+// Three upper-case letters.
+static inline bool is_currency(Currency c){
+    for(int shift : {16,8,0}){
+        const uint32_t ch = (c >> shift) & 0xFF;
+        if(ch < 'A' || ch > 'Z')return false;
+    }
+    return (c >> 24) == 0;
+}
+
+static inline bool parse_currency(const std::string& code,Currency& out,std::string* err = nullptr){
+    Currency c = 0;
+    if(code.size() == 3){
+        for(unsigned char ch : code) c = (c << 8) | static_cast<uint32_t>(std::toupper(ch));
+    }
+    if(!is_currency(c)){
+        if(err) *err = "Error! currency must be a 3-letter code (e.g. EUR).";
+        return false;
+    }
+    out = c;
+    if(err) err->clear();
+    return true;
+}
+
+// Writes the three letters (no terminator), "???" for an invalid code.
+static inline void currency_to_chars(Currency c,char* out){
+    if(!is_currency(c)) c = make_currency("???");
+    out[0] = static_cast<char>(c >> 16);
+    out[1] = static_cast<char>(c >> 8);
+    out[2] = static_cast<char>(c);
+}
+
+static inline std::string currency_code(Currency c){
+    char buf[3];
+    currency_to_chars(c,buf);
+    return std::string(buf,3);
+}
+
+
+#endif //BANK_ACCOUNT_CURRENCY_H
@@ -0,0 +1,73 @@
+
+#ifndef BANK_ACCOUNT_DEDUP_CACHE_H
+#define BANK_ACCOUNT_DEDUP_CACHE_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace std;
+
+// Fixed-memory cache of operation results keyed by idempotency key.
+// Sharded, 4-way set associative with one 64-byte set per cache line; entries older
+// than `buckets` time buckets count as free, so eviction is a comparison, not a sweep.
+// Error texts are interned once and referenced by id.
+class DedupCache{
+public:
+    static constexpr size_t Ways = 4;
+    static constexpr size_t Shards = 64;
+
+    struct Stats{
+        uint64_t Hits{},Misses{},Inserts{},Evictions{};
+    };
+
+    DedupCache(size_t capacity,uint32_t bucket_seconds = 60,uint32_t buckets = 10);
+
+    // True when key was seen within the retention window; ok/err receive the stored result.
+    bool Lookup(uint64_t key,bool& ok,string* err = nullptr);
+    void Insert(uint64_t key,bool ok,const string& err);
+
+    [[nodiscard]] size_t Capacity()const;
+    [[nodiscard]] Stats GetStats()const;
+
+    // Overrides the clock (seconds) for replay and tests; 0 returns to the monotonic clock.
+    void SetNow(uint64_t seconds);
+
+private:
+    struct Entry{
+        uint64_t Key{};
+        uint32_t Epoch{};        // 0: never used
+        uint16_t ErrorId{};
+        bool Ok{};
+    };
+    struct alignas(64) Set{
+        Entry Way[Ways];
+    };
+    struct alignas(64) Shard{
+        atomic_flag Lock = ATOMIC_FLAG_INIT;
+        uint64_t Hits{},Misses{},Inserts{},Evictions{};
+    };
+
+    uint32_t CurrentEpoch()const;
+    Set& SetFor(uint64_t hash);
+    uint16_t Intern(const string&);
+    Shard& ShardFor(uint64_t hash);
+    bool Live(const Entry&,uint32_t epoch)const;
+
+    size_t SetsPerShard;
+    uint32_t BucketSeconds;
+    uint32_t Buckets;
+    uint64_t FixedNow{0};
+    unique_ptr<Set[]> Sets;
+    unique_ptr<Shard[]> ShardState;
+    mutex MessagesLock;
+    vector<string> Messages;
+    unordered_map<string,uint16_t> MessageIds;
+};
+
+
+#endif //BANK_ACCOUNT_DEDUP_CACHE_H
@@ -0,0 +1,67 @@
+#ifndef BANK_ACCOUNT_FX_TABLE_H
+#define BANK_ACCOUNT_FX_TABLE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "Account.h"
+#include "Currency.h"
+
+// Exchange rates into one base currency, each in force from its effective date until the
+// next later rate of the same currency. Rates are fixed point (RateScale = 1.0) and all
+// conversions work on integer cents with one rounding, half away from zero.
+class FxTable{
+public:
+    static constexpr int64_t RateScale = 1'000'000'000;
+    // Balances the batch kernel takes are below this magnitude (cents), so a block of
+    // 2048 can be summed without checking every add.
+    static constexpr int64_t MaxBatchCents = int64_t{1} << 52;
+
+    struct Line{
+        Currency Code{};
+        int64_t Cents{};         // in Code
+        int64_t BaseCents{};
+        size_t Accounts{};
+    };
+    // Balances valued in the base currency: one line per currency, each converted once.
+    struct Valuation{
+        Currency Base{};
+        int64_t TotalCents{};
+        size_t Accounts{};
+        vector<Line> Lines;
+    };
+
+    explicit FxTable(Currency base = Currencies::USD);
+    [[nodiscard]] Currency GetBase()const;
+
+    // Units of the base currency one unit of c is worth from `effective` on; a second
+    // rate for the same currency and day replaces the first.
+    bool SetRate(Currency c,const Account::Date& effective,long double rate,string* err = nullptr);
+    // Rate in force on a packed (yyyymmdd) date; the base currency is always RateScale.
+    bool RateOn(Currency c,uint32_t date,int64_t& out,string* err = nullptr)const;
+    bool Convert(int64_t cents,Currency from,Currency to,const Account::Date&,int64_t& out,string* err = nullptr)const;
+
+    // The batch kernel: sums[slots[i]] += cents[i] and ++counts[slots[i]] for slots below
+    // slot_count; others are skipped. Works in L1-sized blocks with one branch-free
+    // compare-and-add pass per slot, which the compiler vectorises. Fails, with sums
+    // partly added, on a balance of MaxBatchCents or more or a sum that overflows.
+    static bool AccumulateBySlot(const int64_t* cents,const uint8_t* slots,size_t n,int64_t* sums,size_t* counts,
+                                 size_t slot_count);
+    // Values balances[i] held in currencies[slots[i]] on a date (at most 256 currencies).
+    bool ValueBatch(const int64_t* cents,const uint8_t* slots,size_t n,const vector<Currency>& currencies,
+                    const Account::Date&,Valuation& out,string* err = nullptr)const;
+    // Converts per-currency totals (Lines with Code, Cents and Accounts set) into out.
+    bool ValueLines(vector<Line> lines,uint32_t date,Valuation& out,string* err = nullptr)const;
+
+private:
+    Currency Base;
+    // Per currency, (packed effective date, rate) ascending by date.
+    unordered_map<Currency,vector<pair<uint32_t,int64_t>>> Rates;
+};
+
+
+#endif //BANK_ACCOUNT_FX_TABLE_H
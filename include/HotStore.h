@@ -0,0 +1,32 @@
+#ifndef BANK_ACCOUNT_HOT_STORE_H
+#define BANK_ACCOUNT_HOT_STORE_H
+
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+#include "Account.h"
+
+// The hot fields of every account of a Management, packed one 64-byte record per cache
+// line in 4096-record blocks. Records are never moved or freed before the store, so
+// accounts bind to them by pointer (Account::BindHot).
+class HotStore{
+public:
+    static constexpr size_t BlockRecords = 4096;
+
+    // Records are numbered in allocation order.
+    [[nodiscard]] Account::HotFields* Allocate();
+    [[nodiscard]] const Account::HotFields& At(size_t i)const;
+    [[nodiscard]] size_t Size()const;
+    // Block b holds records [b * BlockRecords, (b + 1) * BlockRecords), for in-order scans.
+    [[nodiscard]] size_t BlockCount()const;
+    [[nodiscard]] const Account::HotFields* Block(size_t b)const;
+    [[nodiscard]] size_t Bytes()const;
+
+private:
+    vector<unique_ptr<Account::HotFields[]>> Blocks;
+    size_t Used{0};
+};
+
+
+#endif //BANK_ACCOUNT_HOT_STORE_H
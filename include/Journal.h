@@ -0,0 +1,121 @@
+
+#ifndef BANK_ACCOUNT_JOURNAL_H
+#define BANK_ACCOUNT_JOURNAL_H
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+
+#include "Account.h"
+
+// Bank-wide, append-ordered copy of every ledger entry. The sequence number is the
+// record's position. Records live in fixed blocks that never move, and each block
+// keeps the min/max date of its records, so a date range query reads only the blocks
+// that can match, front to back. Each record links to the previous record of the same
+// account, so one account's history is a walk along that chain.
+class Journal{
+public:
+    static constexpr std::size_t BlockRecords = 4096;
+    static constexpr uint64_t None = UINT64_MAX;
+
+    struct Record{
+        uint64_t Account{};          // packed account number
+        uint64_t Counterparty{};     // other account of a transfer, 0 otherwise
+        int64_t Cents{};
+        int64_t BalanceCents{};
+        uint64_t Prev{None};         // previous record of the same account
+        uint32_t Date{};             // yyyymmdd
+        Account::TransactionTypes Type{};
+    };
+
+    // Room for max_records entries; the block directory is allocated up front.
+    explicit Journal(std::size_t max_records = std::size_t{1} << 29);
+    ~Journal();
+    Journal(const Journal&) = delete;
+    Journal& operator=(const Journal&) = delete;
+
+    // Returns the new sequence number, or None when the journal is full.
+    uint64_t Append(const Record&);
+    uint64_t Append(const Account&,const Account::Transaction&,uint64_t prev);
+    // Blocks appends from other threads while held, so the holder's records get
+    // consecutive sequence numbers (e.g. all legs of one multi-leg transfer).
+    [[nodiscard]] std::unique_lock<std::recursive_mutex> Hold();
+
+    [[nodiscard]] uint64_t Size()const;
+    [[nodiscard]] std::size_t Capacity()const;
+    // Whether `records` more appends fit; stays true while the caller holds Hold().
+    [[nodiscard]] bool HasRoom(uint64_t records)const;
+    bool Get(uint64_t sequence,Record& out)const;
+
+    // Calls fn(sequence, record) for every record dated within [from, to] (yyyymmdd),
+    // in sequence order; returns how many matched. Safe alongside Append.
+    template<class Fn>
+    uint64_t ForEachInRange(uint32_t from,uint32_t to,Fn&& fn)const;
+    // Walks an account's records newest first, starting at head (see Account::GetJournalHead).
+    template<class Fn>
+    uint64_t ForEachOfAccount(uint64_t head,Fn&& fn,uint64_t limit = UINT64_MAX)const;
+
+    // Frees the blocks that hold only records before `before` (e.g. once a checkpoint
+    // covers them). Must not run alongside readers; Append may continue.
+    void Truncate(uint64_t before);
+    [[nodiscard]] uint64_t FirstRetained()const;
+
+    // Blocks a [from, to] query would read, to judge how selective the date index is.
+    [[nodiscard]] uint64_t BlocksInRange(uint32_t from,uint32_t to)const;
+
+private:
+    struct Block{
+        Record Records[BlockRecords];
+    };
+    struct Summary{
+        std::atomic<uint32_t> MinDate{UINT32_MAX};
+        std::atomic<uint32_t> MaxDate{0};
+    };
+
+    std::size_t MaxBlocks;
+    std::unique_ptr<std::atomic<Block*>[]> Blocks;
+    std::unique_ptr<Summary[]> Summaries;   // contiguous, so the index scan stays in cache
+    std::recursive_mutex AppendLock;
+    std::atomic<uint64_t> Published{0};
+    std::atomic<uint64_t> FreedBlocks{0};
+};
+
+
+template<class Fn>
+uint64_t Journal::ForEachInRange(uint32_t from, uint32_t to, Fn &&fn) const {
+    const uint64_t n = Size();
+    uint64_t matched = 0;
+    for(uint64_t b=FreedBlocks.load(std::memory_order_acquire); b * BlockRecords < n; ++b){
+        const Summary& s = Summaries[b];
+        if(s.MaxDate.load(std::memory_order_relaxed) < from || s.MinDate.load(std::memory_order_relaxed) > to)continue;
+        const Block* block = Blocks[b].load(std::memory_order_acquire);
+        if(!block)continue;
+        const uint64_t base = b * BlockRecords;
+        const std::size_t end = static_cast<std::size_t>(n - base < BlockRecords ? n - base : BlockRecords);
+        for(std::size_t i=0; i<end; ++i){
+            const Record& r = block->Records[i];
+            if(r.Date < from || r.Date > to)continue;
+            fn(base + i,r);
+            ++matched;
+        }
+    }
+    return matched;
+}
+
+template<class Fn>
+uint64_t Journal::ForEachOfAccount(uint64_t head, Fn &&fn, uint64_t limit) const {
+    const uint64_t n = Size();
+    uint64_t visited = 0;
+    for(uint64_t seq = head; seq != None && seq < n && visited < limit; ++visited){
+        const Block* block = Blocks[seq / BlockRecords].load(std::memory_order_acquire);
+        if(!block)break;
+        const Record& r = block->Records[seq % BlockRecords];
+        fn(seq,r);
+        seq = r.Prev;
+    }
+    return visited;
+}
+
+
+#endif //BANK_ACCOUNT_JOURNAL_H
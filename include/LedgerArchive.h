@@ -0,0 +1,106 @@
+
+#ifndef BANK_ACCOUNT_LEDGER_ARCHIVE_H
+#define BANK_ACCOUNT_LEDGER_ARCHIVE_H
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "PackedTransaction.h"
+
+// Append-only local file of ledger segments moved out of memory. A segment is a header
+// (account, entry count, date range, ledger position) followed by packed entries; the
+// per-account segment index is rebuilt from the headers on Open. Reads go through a
+// read-only mapping, so archived history costs page cache rather than heap.
+class LedgerArchive{
+public:
+    LedgerArchive() = default;
+    ~LedgerArchive();
+    LedgerArchive(const LedgerArchive&) = delete;
+    LedgerArchive& operator=(const LedgerArchive&) = delete;
+
+    // Opens or creates the file; a torn segment at the end (crash during Commit) is cut off.
+    bool Open(const string& path,string* err = nullptr);
+    [[nodiscard]] bool IsOpen()const;
+
+    // Queues entries [first, first + count) of an account's ledger; first_index is the
+    // position of the first one in the account's full history.
+    void Stage(const string& account,uint64_t first_index,const Account::Transaction* first,size_t count);
+    // Writes everything staged with one write and syncs it. Staged segments become
+    // readable only on success; on failure the file is cut back and nothing is indexed.
+    bool Commit(string* err = nullptr);
+    [[nodiscard]] size_t Staged()const;
+
+    // Calls fn(const PackedTransaction&) for every archived entry of the account, oldest first.
+    template<class Fn>
+    uint64_t ForEach(const string& account,Fn&& fn)const;
+    // The same, skipping whole segments with no entry dated in [from, to] (packed dates);
+    // entries of the remaining segments are not filtered.
+    template<class Fn>
+    uint64_t ForEachOverlapping(const string& account,uint32_t from,uint32_t to,Fn&& fn)const;
+    [[nodiscard]] uint64_t Count(const string& account)const;
+    [[nodiscard]] uint64_t FileBytes()const;
+    [[nodiscard]] size_t SegmentCount()const;
+
+private:
+    static constexpr uint32_t Magic = 0x4C475241;   // "ARGL"
+
+    struct SegmentHeader{
+        uint32_t Magic;
+        uint32_t Count;
+        uint64_t Account;
+        uint32_t MinDate,MaxDate;    // packed; bounds even if the ledger is not in date order
+        uint64_t FirstIndex;
+    };
+    struct Segment{
+        uint64_t Offset;     // of the first entry
+        uint32_t Count;
+        uint32_t MinDate,MaxDate;
+        uint64_t FirstIndex;
+    };
+
+    [[nodiscard]] const vector<Segment>* Find(const string& account)const;
+    // Maps the first `bytes` of the file in place of the current mapping.
+    bool Remap(uint64_t bytes,string* err);
+    void Index(const SegmentHeader&,uint64_t offset);
+
+    int Fd{-1};
+    const char* Map{nullptr};
+    uint64_t MappedBytes{0};
+    uint64_t Bytes{0};
+    size_t Segments{0};
+    unordered_map<uint64_t,vector<Segment>> ByAccount;
+    vector<char> Pending;
+};
+
+
+template<class Fn>
+uint64_t LedgerArchive::ForEach(const string &account, Fn &&fn) const {
+    const vector<Segment>* segments = Find(account);
+    if(!segments || !Map)return 0;
+    uint64_t visited = 0;
+    for(const Segment& s : *segments){
+        const auto* entries = reinterpret_cast<const PackedTransaction*>(Map + s.Offset);
+        for(uint32_t i=0; i<s.Count; ++i) fn(entries[i]);
+        visited += s.Count;
+    }
+    return visited;
+}
+
+template<class Fn>
+uint64_t LedgerArchive::ForEachOverlapping(const string &account, uint32_t from, uint32_t to, Fn &&fn) const {
+    const vector<Segment>* segments = Find(account);
+    if(!segments || !Map)return 0;
+    uint64_t visited = 0;
+    for(const Segment& s : *segments){
+        if(s.MaxDate < from || s.MinDate > to)continue;
+        const auto* entries = reinterpret_cast<const PackedTransaction*>(Map + s.Offset);
+        for(uint32_t i=0; i<s.Count; ++i) fn(entries[i]);
+        visited += s.Count;
+    }
+    return visited;
+}
+
+
+#endif //BANK_ACCOUNT_LEDGER_ARCHIVE_H
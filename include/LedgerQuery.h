@@ -0,0 +1,115 @@
+#ifndef BANK_ACCOUNT_LEDGER_QUERY_H
+#define BANK_ACCOUNT_LEDGER_QUERY_H
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+#include <limits>
+#include <string>
+#include <vector>
+
+#include "Account.h"
+#include "Utils.h"
+
+// A lazy, composable filter over ledgers. The builder calls only record conditions;
+// a terminal call (Run, Count, Summarize, or Management::Query / SummarizeAll) walks
+// each ledger once and tests all conditions per entry, without intermediate vectors.
+// Conditions are ANDed, except repeated OfType calls, which accept any of the types.
+// A date range is pushed down: archive segments outside it are skipped, and a ledger
+// kept in date order is entered by binary search and left at the first later entry.
+class LedgerQuery{
+public:
+    using Transaction = Account::Transaction;
+
+    // Amounts of different currencies are not added up: Mixed marks a summary that saw
+    // more than one, and Management's Summarize calls fail on it.
+    struct Summary{
+        uint64_t Count{};
+        long double Total{};
+        long double Min{},Max{};     // of the amounts; 0 while Count is 0
+        Currency CurrencyCode{};     // of the amounts; 0 while Count is 0
+        bool Mixed{};
+        void Add(long double amount,Currency);
+        void Merge(const Summary&);
+    };
+
+    LedgerQuery& OfType(Account::TransactionTypes);
+    // Inclusive on both ends.
+    LedgerQuery& Between(const Account::Date& from,const Account::Date& to);
+    // Entries whose source or destination is this account.
+    LedgerQuery& WithCounterparty(const string& account);
+    LedgerQuery& AmountAtLeast(long double);
+    LedgerQuery& AmountAtMost(long double);
+    // Entries in this currency, i.e. of accounts held in it.
+    LedgerQuery& InCurrency(Currency);
+    LedgerQuery& Where(function<bool(const Transaction&)>);
+    // Stop after n matches per account.
+    LedgerQuery& Limit(size_t n);
+
+    [[nodiscard]] bool Matches(const Transaction&)const;
+    [[nodiscard]] bool HasDateRange()const;
+    [[nodiscard]] uint32_t FromDate()const;
+    [[nodiscard]] uint32_t ToDate()const;
+    [[nodiscard]] size_t GetLimit()const;
+
+    // Calls fn(const Transaction&) for each match in the account's in-memory ledger and
+    // returns the number of matches.
+    template<class Fn>
+    size_t Run(const Account&,Fn&& fn,size_t limit)const;
+    template<class Fn>
+    size_t Run(const Account& acc,Fn&& fn)const{ return Run(acc,std::forward<Fn>(fn),MaxMatches); }
+    [[nodiscard]] size_t Count(const Account&)const;
+    [[nodiscard]] Summary Summarize(const Account&)const;
+
+private:
+    uint8_t TypeMask{0};                 // bit per TransactionTypes; 0 accepts every type
+    uint32_t From{0},To{UINT32_MAX};      // packed dates
+    string Counterparty;
+    long double MinAmount{-std::numeric_limits<long double>::infinity()};
+    long double MaxAmount{std::numeric_limits<long double>::infinity()};
+    Currency OnlyCurrency{0};            // 0 accepts every currency
+    vector<function<bool(const Transaction&)>> Predicates;
+    size_t MaxMatches{SIZE_MAX};
+};
+
+
+inline bool LedgerQuery::HasDateRange() const {
+    return From != 0 || To != UINT32_MAX;
+}
+
+// Cheapest tests first; the date needs three string parses. Inline: it runs per entry.
+inline bool LedgerQuery::Matches(const Transaction &t) const {
+    if(TypeMask && !(TypeMask & (1u << static_cast<unsigned>(t.type))))return false;
+    if(t.amount < MinAmount || t.amount > MaxAmount)return false;
+    if(OnlyCurrency && t.currency != OnlyCurrency)return false;
+    if(!Counterparty.empty() && t.source != Counterparty && t.destination != Counterparty)return false;
+    if(HasDateRange()){
+        const uint32_t day = pack_date(t.trans);
+        if(day < From || day > To)return false;
+    }
+    for(const auto& p : Predicates) if(!p(t))return false;
+    return true;
+}
+
+template<class Fn>
+size_t LedgerQuery::Run(const Account &acc, Fn &&fn, size_t limit) const {
+    const auto& ledger = acc.GetTransactions();
+    auto it = ledger.begin();
+    const bool ordered = HasDateRange() && acc.LedgerInDateOrder();
+    if(ordered && From){
+        it = std::partition_point(ledger.begin(),ledger.end(),[&](const Transaction& t){
+            return pack_date(t.trans) < From;
+        });
+    }
+    size_t matches = 0;
+    for(; it != ledger.end() && matches < limit; ++it){
+        if(ordered && pack_date(it->trans) > To)break;
+        if(!Matches(*it))continue;
+        fn(*it);
+        ++matches;
+    }
+    return matches;
+}
+
+
+#endif //BANK_ACCOUNT_LEDGER_QUERY_H
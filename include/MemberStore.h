@@ -0,0 +1,35 @@
+
+#ifndef BANK_ACCOUNT_MEMBER_STORE_H
+#define BANK_ACCOUNT_MEMBER_STORE_H
+
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "Person.h"
+
+using MemberId = uint32_t;
+
+// The single copy of every member. Accounts hold a 4-byte MemberId instead of a Person;
+// ids index a dense deque (id - 1), so records never move, and the IdCode index maps
+// straight to that id.
+class MemberStore{
+public:
+    static constexpr MemberId NoMember = 0;
+
+    // Returns the new id, or NoMember when the IdCode is empty or already present.
+    MemberId Add(const Person&,string* err = nullptr);
+    [[nodiscard]] MemberId Lookup(const string& id_code)const;
+    // nullptr for NoMember or an unknown id.
+    [[nodiscard]] const Person* Find(MemberId)const;
+    [[nodiscard]] size_t Size()const;
+
+private:
+    deque<Person> Records;
+    unordered_map<string,MemberId> ByIdCode;
+};
+
+
+#endif //BANK_ACCOUNT_MEMBER_STORE_H
@@ -0,0 +1,130 @@
+
+#ifndef BANK_ACCOUNT_METRICS_H
+#define BANK_ACCOUNT_METRICS_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+// Metrics are compiled in when BANK_METRICS is defined (CMake option BANK_METRICS).
+// Without it every BANK_METRIC_* macro expands to nothing.
+#ifndef BANK_METRICS_SAMPLE_SHIFT
+#define BANK_METRICS_SAMPLE_SHIFT 4
+#endif
+
+enum class MetricOp{OpenAccount,CloseAccount,Deposit,Withdraw,Transfer,AddPerson,Count};
+enum class MetricFailure{EmptyInput,NotFound,Duplicate,InvalidAmount,Rejected,Count};
+
+constexpr std::size_t MetricOpCount = static_cast<std::size_t>(MetricOp::Count);
+constexpr std::size_t MetricFailureCount = static_cast<std::size_t>(MetricFailure::Count);
+
+
+// Log-linear (HDR style) histogram: 16 linear sub-buckets per power of two, ~6% precision.
+class LatencyHistogram{
+public:
+    static constexpr int SubBits = 4;
+    static constexpr std::size_t SubCount = std::size_t{1} << SubBits;
+    static constexpr std::size_t BucketCount = (64 - SubBits + 1) * SubCount;
+
+    static std::size_t BucketOf(std::uint64_t v);
+    static std::uint64_t BucketLowerBound(std::size_t idx);
+
+    void Record(std::uint64_t v);
+    void AddToBucket(std::size_t idx,std::uint64_t count);
+    void Merge(const LatencyHistogram&);
+    void Clear();
+    [[nodiscard]] std::uint64_t Count()const;
+    [[nodiscard]] std::uint64_t Max()const;
+    [[nodiscard]] std::uint64_t Percentile(double)const;
+
+private:
+    std::array<std::uint64_t,BucketCount> Buckets{};
+    std::uint64_t Total{};
+    std::uint64_t MaxValue{};
+};
+
+
+struct MetricsSnapshot{
+    std::array<std::uint64_t,MetricOpCount> Ops{};
+    std::array<std::uint64_t,MetricOpCount> Failed{};
+    std::array<std::array<std::uint64_t,MetricFailureCount>,MetricOpCount> FailuresByReason{};
+    std::array<LatencyHistogram,MetricOpCount> Latency{};
+    LatencyHistogram ProbeLength;
+    std::uint64_t LedgerAppends{};
+    std::uint64_t LedgerMaxLength{};
+};
+
+
+class Metrics{
+public:
+    static bool Enabled();
+    static bool Sample(MetricOp);
+    static void RecordOp(MetricOp,bool ok);
+    static void RecordFailure(MetricOp,MetricFailure);
+    static void RecordLatency(MetricOp,std::uint64_t ns);
+    static void RecordProbe(std::size_t);
+    static void RecordLedgerAppend(std::size_t new_length);
+
+    // Merges every live thread's counters plus those of exited threads.
+    static MetricsSnapshot Snapshot();
+    static void Reset();
+
+    static void DumpText(std::ostream&);
+    static void DumpJson(std::ostream&);
+
+    static const char* OpToString(MetricOp);
+    static const char* FailureToString(MetricFailure);
+};
+
+
+// Counts one Management operation; latency is taken for 1 in 2^BANK_METRICS_SAMPLE_SHIFT calls.
+class MetricsScope{
+public:
+    explicit MetricsScope(MetricOp op) : Op(op),Sampled(Metrics::Sample(op)){
+        if(Sampled) Start = std::chrono::steady_clock::now();
+    }
+    ~MetricsScope(){
+        Metrics::RecordOp(Op,Ok);
+        if(Sampled){
+            auto ns = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - Start).count();
+            Metrics::RecordLatency(Op,static_cast<std::uint64_t>(ns));
+        }
+    }
+    MetricsScope(const MetricsScope&) = delete;
+    MetricsScope& operator=(const MetricsScope&) = delete;
+
+    void Fail(MetricFailure reason){
+        Ok = false;
+        Metrics::RecordFailure(Op,reason);
+    }
+    void Succeed(){ Ok = true; }
+    [[nodiscard]] bool IsSampled()const{ return Sampled; }
+
+private:
+    MetricOp Op;
+    bool Sampled;
+    bool Ok{false};
+    std::chrono::steady_clock::time_point Start{};
+};
+
+
+#ifdef BANK_METRICS
+#define BANK_METRIC_SCOPE(op) MetricsScope metrics_scope_(op)
+#define BANK_METRIC_FAIL(reason) metrics_scope_.Fail(reason)
+#define BANK_METRIC_OK() metrics_scope_.Succeed()
+#define BANK_METRIC_PROBE(map,key) \
+    do{ if(metrics_scope_.IsSampled() && !(map).empty()) Metrics::RecordProbe((map).bucket_size((map).bucket(key))); }while(0)
+#define BANK_METRIC_LEDGER(len) Metrics::RecordLedgerAppend(len)
+#else
+#define BANK_METRIC_SCOPE(op) ((void)0)
+#define BANK_METRIC_FAIL(reason) ((void)0)
+#define BANK_METRIC_OK() ((void)0)
+#define BANK_METRIC_PROBE(map,key) ((void)0)
+#define BANK_METRIC_LEDGER(len) ((void)0)
+#endif
+
+
+#endif //BANK_ACCOUNT_METRICS_H
@@ -0,0 +1,42 @@
+#ifndef BANK_ACCOUNT_NUMA_TOPOLOGY_H
+#define BANK_ACCOUNT_NUMA_TOPOLOGY_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Person.h"
+
+// NUMA nodes and their CPUs as Linux reports them in /sys/devices/system/node,
+// restricted to the CPUs this process may run on. Without that directory the machine
+// is one node. Simulated(n) splits the usable CPUs into n pretend nodes, so the
+// partitioned code paths can run on a single-socket box; memory policies are then
+// skipped because the kernel knows only node 0.
+class NumaTopology{
+public:
+    struct Node{
+        int Id;
+        vector<int> Cpus;
+    };
+
+    static NumaTopology Detect();
+    static NumaTopology Simulated(size_t nodes);
+
+    [[nodiscard]] size_t NodeCount()const;
+    [[nodiscard]] const Node& GetNode(size_t)const;
+    [[nodiscard]] bool IsSimulated()const;
+
+    // Restricts the calling thread to the node's CPUs.
+    bool PinCurrentThread(size_t node,string* err = nullptr)const;
+    // Memory the calling thread touches from now on comes from the node (Local) or is
+    // spread page by page over all nodes (Interleave). False on simulated topologies.
+    bool PreferLocalMemory(size_t node,string* err = nullptr)const;
+    bool InterleaveMemory(string* err = nullptr)const;
+
+private:
+    vector<Node> Nodes;
+    bool Simulation{false};
+};
+
+
+#endif //BANK_ACCOUNT_NUMA_TOPOLOGY_H
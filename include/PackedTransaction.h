@@ -0,0 +1,29 @@
+
+#ifndef BANK_ACCOUNT_PACKED_TRANSACTION_H
+#define BANK_ACCOUNT_PACKED_TRANSACTION_H
+
+#include <cstdint>
+
+#include "Account.h"
+
+// Fixed-size, string-free form of a ledger entry, used for checkpoints and the archive.
+// Account numbers are packed to integers; the non-numeric endpoints the ledger uses
+// ("Cash", "Interest", "Closed") are kept as a tag.
+struct PackedTransaction{
+    enum class Endpoint : uint8_t{Account,Cash,Interest,Closed,Other};
+
+    uint64_t Source{},Destination{};
+    int64_t Cents{},BalanceCents{};
+    uint32_t Date{};             // yyyymmdd
+    Account::TransactionTypes Type{};
+    Endpoint SourceTag{},DestinationTag{};
+    Currency CurrencyCode{};     // fills what was padding; sizeof stays 48
+
+    static PackedTransaction Pack(const Account::Transaction&);
+    // Reuses the strings already in out, so a loop over many entries does not allocate.
+    void UnpackInto(Account::Transaction& out)const;
+};
+static_assert(sizeof(PackedTransaction) == 48,"archive and checkpoint records are 48 bytes");
+
+
+#endif //BANK_ACCOUNT_PACKED_TRANSACTION_H
@@ -0,0 +1,96 @@
+#ifndef BANK_ACCOUNT_PARTITIONED_BANK_H
+#define BANK_ACCOUNT_PARTITIONED_BANK_H
+
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Bank Management.h"
+#include "NumaTopology.h"
+
+// One Management per NUMA node, each owned by a worker thread of that node. The worker
+// builds its Management itself, so the accounts are first touched, and therefore
+// allocated, on its node. Partition p issues account numbers n with n % nodes == p,
+// so any number routes to its node without a directory.
+//
+// Placement::Local pins every worker to its node's CPUs and prefers node-local memory.
+// Placement::Interleaved leaves workers unpinned and spreads their memory over all
+// nodes; it is the baseline. A single-node machine simply runs one partition.
+class PartitionedBank{
+public:
+    enum class Placement{Local,Interleaved};
+
+    struct Op{
+        enum class Kind : uint8_t{Deposit,Withdraw,Transfer};
+        Kind Type;
+        string Source;          // the account for deposits and withdrawals
+        string Destination;     // transfers only
+        long double Amount{};
+    };
+    struct BatchStats{
+        size_t Local{};         // executed entirely on one node
+        size_t CrossNode{};     // transfers between nodes
+        size_t Failed{};
+        size_t Refunded{};      // cross-node debits returned because the credit failed
+    };
+
+    explicit PartitionedBank(NumaTopology,Placement = Placement::Local);
+    ~PartitionedBank();
+    PartitionedBank(const PartitionedBank&) = delete;
+    PartitionedBank& operator=(const PartitionedBank&) = delete;
+
+    [[nodiscard]] size_t NodeCount()const;
+    [[nodiscard]] size_t NodeOf(const string& account_number)const;
+    [[nodiscard]] const NumaTopology& GetTopology()const;
+    [[nodiscard]] Placement GetPlacement()const;
+    // Whether every worker got its CPU affinity / memory policy (see NumaTopology).
+    [[nodiscard]] bool Pinned()const;
+    [[nodiscard]] bool MemoryPolicyApplied()const;
+
+    // Opens the account on the node chosen by the owner's IdCode, so one owner's
+    // accounts share a node; number receives the new account number.
+    bool OpenAccount(const Person&,long double,Account::AccountType,const Date&,string* number,string* err = nullptr);
+
+    // Runs a batch on the workers in parallel, each node's ops in batch order. Transfers
+    // between nodes run after the node-local ops, in two phases: the source nodes debit
+    // (TransferOut), then the destination nodes credit (TransferIn); a failed credit,
+    // including one into an account of another currency, is refunded to the source.
+    // ok[i] tells whether op i took effect.
+    bool RunBatch(const vector<Op>&,const Date&,vector<uint8_t>* ok = nullptr,BatchStats* stats = nullptr,
+                  string* err = nullptr);
+
+    // Runs fn(Management&) on the node's worker and waits for it.
+    void RunOn(size_t node,const function<void(Management&)>& fn);
+    // For reading between batches, e.g. to sum balances.
+    [[nodiscard]] const Management& Shard(size_t node)const;
+
+private:
+    struct Worker{
+        thread Thread;
+        mutex Lock;
+        condition_variable Wake,Done;
+        function<void(Management&)> Task;
+        bool Busy{false},Stop{false};
+        bool Pinned{false},MemoryPolicy{false};
+        unique_ptr<Management> Bank;
+        // Scratch for RunBatch, by op index.
+        vector<uint32_t> LocalOps,Debits,Credits,Refunds;
+    };
+
+    void WorkerLoop(size_t node);
+    void Post(size_t node,function<void(Management&)> fn);
+    void Wait(size_t node);
+    void RunOnAll(const function<void(size_t,Management&)>& fn);
+
+    NumaTopology Topology;
+    Placement Mode;
+    vector<unique_ptr<Worker>> Workers;
+};
+
+
+#endif //BANK_ACCOUNT_PARTITIONED_BANK_H
@@ -26,6 +26,7 @@ public:
     [[nodiscard]] string GetNationality()const;
     [[nodiscard]] string GetIdCode()const;
     [[nodiscard]] static string GetGender(bool);
+    [[nodiscard]] bool IsMale()const;
     [[nodiscard]] const BirthDate& GetBirthDate()const;
 
     void DisplayPersonInfo()const;
@@ -0,0 +1,53 @@
+
+#ifndef BANK_ACCOUNT_PREFIX_INDEX_H
+#define BANK_ACCOUNT_PREFIX_INDEX_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Person.h"
+
+// Prefix search over digit strings of at most Width digits (account numbers, IdCodes).
+// Each string is stored as one integer: its digits padded on the right to Width, times
+// 32, plus its length. That order equals string order, so every prefix is one
+// contiguous range of a sorted array, found with two binary searches. New keys go to
+// a small sorted delta that is merged into the main array once it grows past
+// about sqrt(size), which keeps both inserts and queries cheap.
+class PrefixIndex{
+public:
+    static constexpr unsigned MaxWidth = 17;
+
+    explicit PrefixIndex(unsigned width);
+
+    // Rejects non-digit or over-long keys; duplicates are kept once.
+    bool Insert(const string& digits,string* err = nullptr);
+    [[nodiscard]] bool Contains(const string& digits)const;
+
+    // Appends up to limit keys starting with prefix to out, in ascending order.
+    // An empty prefix matches every key.
+    bool Find(const string& prefix,size_t limit,vector<string>& out,string* err = nullptr)const;
+    [[nodiscard]] size_t CountPrefix(const string& prefix)const;
+
+    [[nodiscard]] size_t Size()const;
+    [[nodiscard]] unsigned GetWidth()const;
+
+private:
+    struct Range{
+        uint64_t Low,High;     // [Low, High) of encoded keys
+        unsigned Length;       // prefix length; shorter keys in the range are not matches
+    };
+
+    bool Encode(const string& digits,uint64_t& key,string* err)const;
+    bool PrefixRange(const string& prefix,Range& r,string* err)const;
+    string Decode(uint64_t key)const;
+    void Merge();
+
+    unsigned Width;
+    uint64_t Scale;             // 10^Width
+    vector<uint64_t> Sorted;
+    vector<uint64_t> Delta;     // sorted, disjoint from Sorted
+};
+
+
+#endif //BANK_ACCOUNT_PREFIX_INDEX_H
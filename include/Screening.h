@@ -0,0 +1,165 @@
+
+#ifndef BANK_ACCOUNT_SCREENING_H
+#define BANK_ACCOUNT_SCREENING_H
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "TransactionStream.h"
+
+struct ScreeningAlert{
+    enum class Kind{FanOut,RoundTrip,BalanceDrain};
+    Kind Type;
+    uint64_t Account{};
+    uint64_t Counterparty{};
+    uint32_t Date{};
+    uint64_t Sequence{};
+    long double Amount{};
+
+    static const char* KindToString(Kind);
+};
+
+struct ScreeningConfig{
+    std::size_t Workers = 2;
+    long double SmallTransfer = 100.0L;       // fan-out only counts transfers at or below this
+    uint32_t FanOutDestinations = 10;         // distinct destinations per day before alerting (max 16)
+    long double DrainFraction = 0.9L;         // share of the balance leaving in one entry
+    long double DrainMinimum = 1000.0L;       // ignore drains of small balances
+};
+
+
+// Hash map split into independently locked shards.
+template<class K,class V,class Hash = std::hash<K>,std::size_t N = 64>
+class ShardedMap{
+public:
+    // Runs fn on the (default-constructed if missing) value under the shard lock.
+    template<class Fn>
+    auto Update(const K& key,Fn&& fn){
+        Shard& s = Shards[Hash{}(key) % N];
+        std::lock_guard<std::mutex> g(s.Lock);
+        return fn(s.Map[key]);
+    }
+    // Erases the entries whose value matches, one shard lock at a time; returns how many.
+    template<class Pred>
+    std::size_t EraseIf(Pred&& pred){
+        std::size_t n = 0;
+        for(auto& s : Shards){
+            std::lock_guard<std::mutex> g(s.Lock);
+            for(auto it = s.Map.begin(); it != s.Map.end();){
+                if(pred(it->second)){
+                    it = s.Map.erase(it);
+                    ++n;
+                }
+                else ++it;
+            }
+        }
+        return n;
+    }
+    [[nodiscard]] std::size_t Size()const{
+        std::size_t n = 0;
+        for(auto& s : Shards){
+            std::lock_guard<std::mutex> g(s.Lock);
+            n += s.Map.size();
+        }
+        return n;
+    }
+
+private:
+    struct alignas(64) Shard{
+        mutable std::mutex Lock;
+        std::unordered_map<K,V,Hash> Map;
+    };
+    Shard Shards[N];
+};
+
+
+// Screens ledger entries read from a TransactionStream on worker threads. Each worker
+// subscribes to the stream and handles the accounts that hash to it, so producers
+// never wait on screening (use Backpressure::Drop to keep it that way under overload).
+class ScreeningPipeline{
+public:
+    struct Stats{
+        uint64_t Events{};
+        uint64_t Alerts[3]{};
+        std::size_t TrackedAccounts{},TrackedPairs{};
+        uint64_t Expired{};     // account and pair entries dropped once their day passed
+    };
+
+    ScreeningPipeline(TransactionStream&,ScreeningConfig = {});
+    ~ScreeningPipeline();
+    ScreeningPipeline(const ScreeningPipeline&) = delete;
+    ScreeningPipeline& operator=(const ScreeningPipeline&) = delete;
+
+    bool Start(std::string* err = nullptr);
+    // Drains what is already in the stream, then joins the workers.
+    void Stop();
+
+    std::vector<ScreeningAlert> TakeAlerts();
+    [[nodiscard]] Stats GetStats()const;
+
+private:
+    static constexpr std::size_t MaxFanOut = 16;
+    struct AccountState{
+        uint32_t Day{};
+        uint16_t SmallTransfers{};
+        uint8_t DistinctDestinations{};
+        bool FanOutFlagged{};
+        uint32_t Destinations[MaxFanOut]{};   // 32-bit hashes of today's small-transfer destinations
+    };
+    struct PairState{
+        uint32_t Day{};
+        uint32_t Forward{},Backward{};  // low -> high, high -> low account number
+        bool Flagged{};
+    };
+    // State is kept per day, so workers screening different days never reset each other's.
+    using AccountKey = std::pair<uint64_t,uint32_t>;   // (account number, day)
+    struct AccountKeyHash{
+        std::size_t operator()(const AccountKey& k)const{
+            return std::hash<uint64_t>{}(k.first * 0x9e3779b97f4a7c15ULL ^ k.second);
+        }
+    };
+    struct PairKey{
+        uint64_t Low{},High{};  // lower, higher account number
+        uint32_t Day{};
+        bool operator==(const PairKey& o)const{ return Low == o.Low && High == o.High && Day == o.Day; }
+    };
+    struct PairKeyHash{
+        std::size_t operator()(const PairKey& k)const{
+            return std::hash<uint64_t>{}((k.Low * 0x9e3779b97f4a7c15ULL ^ k.High) * 0xbf58476d1ce4e5b9ULL ^ k.Day);
+        }
+    };
+
+    void Run(std::size_t worker,int consumer);
+    void Screen(const TransactionEvent&);
+    void Raise(ScreeningAlert::Kind,const TransactionEvent&,uint64_t counterparty);
+    // Records that `worker` has screened everything up to `day`, and expires the days
+    // that every worker has moved past.
+    void Advance(std::size_t worker,uint32_t day);
+    // Drops state for days before `day`: every rule looks at one day only.
+    void Expire(uint32_t day);
+
+    TransactionStream& Stream;
+    ScreeningConfig Config;
+    std::vector<std::thread> Workers;
+    std::vector<int> Consumers;
+    std::atomic<bool> Stopping{false};
+
+    ShardedMap<AccountKey,AccountState,AccountKeyHash> Accounts;
+    ShardedMap<PairKey,PairState,PairKeyHash> Pairs;
+
+    std::vector<std::atomic<uint32_t>> WorkerDays;  // newest day each worker has fully screened
+    std::atomic<uint32_t> ExpiredBefore{0};
+    std::atomic<uint64_t> Expired{0};
+    std::atomic<uint64_t> Events{0};
+    std::atomic<uint64_t> AlertCounts[3]{};
+    std::mutex AlertsLock;
+    std::vector<ScreeningAlert> Alerts;
+};
+
+
+#endif //BANK_ACCOUNT_SCREENING_H
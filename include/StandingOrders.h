@@ -0,0 +1,94 @@
+
+#ifndef BANK_ACCOUNT_STANDING_ORDERS_H
+#define BANK_ACCOUNT_STANDING_ORDERS_H
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Account.h"
+
+class Management;
+
+// Recurring transfers and deposits. Orders wait in a two-level timer wheel keyed on the
+// day number: 256 one-day slots for the current 256-day block, 256 block slots beyond
+// it, and an overflow list for anything further out. Finding what is due costs the
+// number of due orders, not the number of orders. RunDue prepares the due orders on
+// several threads and then executes them in order through Management.
+class StandingOrders{
+public:
+    using OrderId = uint32_t;
+    static constexpr OrderId NoOrder = 0;
+    enum class Frequency : uint8_t{Daily,Weekly,Monthly,Yearly};
+
+    struct Result{
+        OrderId Id;
+        bool Ok;
+    };
+    struct RunStats{
+        size_t Due{};          // runs of active orders that were due, missed ones included
+        size_t Executed{};
+        size_t Failed{};       // rejected by Management (e.g. insufficient funds)
+        size_t Skipped{};      // account missing or closed; not attempted
+        size_t Finished{};     // past their end date, removed
+        uint64_t FindNs{},PrepareNs{},ApplyNs{};
+    };
+
+    // Runs on first, then every `every` periods; a monthly order keeps first's day of
+    // the month (clamped in shorter months). until, when given, is the last allowed day.
+    OrderId AddTransfer(const string& source,const string& destination,long double amount,const Account::Date& first,
+                        Frequency,uint16_t every = 1,const Account::Date* until = nullptr,string* err = nullptr);
+    OrderId AddDeposit(const string& account,long double amount,const Account::Date& first,
+                       Frequency,uint16_t every = 1,const Account::Date* until = nullptr,string* err = nullptr);
+    bool Cancel(OrderId,string* err = nullptr);
+
+    // Executes every order due on or before today that has not run yet. Orders run in
+    // id order; a failed run is reported and the order stays scheduled. An order that
+    // came due on days RunDue skipped runs once per missed occurrence, all booked on
+    // today, so its next run is after today again.
+    bool RunDue(Management&,const Account::Date& today,size_t threads,RunStats* stats = nullptr,
+                vector<Result>* results = nullptr,string* err = nullptr);
+
+    [[nodiscard]] size_t Size()const;
+    // Next day (days since 1970-01-01) of an active order, or INT32_MIN.
+    [[nodiscard]] int32_t NextRun(OrderId)const;
+
+private:
+    static constexpr uint32_t Slots = 256;
+
+    struct Order{
+        uint64_t Source,Destination;   // packed; Source 0 for a deposit
+        long double Amount;
+        int32_t Next,Until;
+        uint16_t Every;
+        uint8_t Anchor;                // day of month for monthly/yearly orders
+        Frequency Freq;
+        bool Active,Deposit;
+    };
+
+    OrderId Add(Order,const Account::Date& first,const Account::Date* until,string* err);
+    void Schedule(OrderId);
+    // Makes day the wheel's first day and re-buckets every scheduled order; O(orders).
+    void Rebase(int32_t day);
+    void Advance(int32_t today,vector<OrderId>& due);
+    [[nodiscard]] int32_t Following(const Order&)const;
+
+    vector<Order> Orders;              // id - 1
+    array<vector<OrderId>,Slots> Near,Far;
+    vector<OrderId> Overflow;
+    int32_t Current{INT32_MIN};        // first day of the wheel: no order is due before it
+    int32_t LastRun{INT32_MIN};        // latest day RunDue has covered
+    size_t ActiveOrders{0};
+    // Reused between runs.
+    struct Prepared{
+        string Source,Destination;
+        bool Runnable,Cancelled;
+    };
+    vector<OrderId> Due;
+    vector<Prepared> Work;
+    vector<OrderId> Cascade;
+};
+
+
+#endif //BANK_ACCOUNT_STANDING_ORDERS_H
@@ -0,0 +1,56 @@
+
+#ifndef BANK_ACCOUNT_STATEMENT_WRITER_H
+#define BANK_ACCOUNT_STATEMENT_WRITER_H
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "Account.h"
+#include "LedgerArchive.h"
+
+// Growable byte buffer reused across statement batches; formats numbers with to_chars.
+class StatementBuffer{
+public:
+    void Append(const char*,std::size_t);
+    void Append(const string&);
+    void Append(const char*);
+    void Append(char);
+    void AppendUnsigned(unsigned long long);
+    void AppendMoney(long double);
+    void AppendDate(const Account::Date&,char sep);
+    void AppendJsonString(const string&);
+
+    [[nodiscard]] const char* Data()const;
+    [[nodiscard]] std::size_t Size()const;
+    void Clear();
+
+private:
+    char* Reserve(std::size_t);
+    std::vector<char> Bytes;
+    std::size_t Used{0};
+};
+
+
+class StatementWriter{
+public:
+    enum class Format{Text,Csv,Json};
+
+    explicit StatementWriter(Format);
+
+    // CSV column names; empty for the other formats.
+    void FormatHeader(StatementBuffer&)const;
+    // With an archive, the account's archived entries are written ahead of the rest.
+    void FormatAccount(const Account&,StatementBuffer&,const LedgerArchive* archive = nullptr)const;
+
+    // Writes all buffers in order with writev, retrying partial writes.
+    static bool WriteBuffers(int fd,const std::vector<StatementBuffer>&,string* err = nullptr);
+
+    [[nodiscard]] Format GetFormat()const;
+
+private:
+    Format Fmt;
+};
+
+
+#endif //BANK_ACCOUNT_STATEMENT_WRITER_H
@@ -0,0 +1,80 @@
+
+#ifndef BANK_ACCOUNT_TRACE_H
+#define BANK_ACCOUNT_TRACE_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Account.h"
+
+// One recorded Management call and its outcome. Amounts are kept exactly (balances with
+// interest are not whole cents), dates are yyyymmdd and account numbers are packed; Strings carries the Person of AddPerson and
+// OpenAccount (see TraceOp::PersonFields) or the owner IdCode of CloseAccount.
+// Balance records are written by Management::FinishTrace: the final balance of each
+// account, for the replay to compare against.
+struct TraceOp{
+    enum class Kind : uint8_t{AddPerson,Open,Close,Deposit,Withdraw,Transfer,Interest,Balance,Count};
+    static constexpr size_t PersonFields = 8;
+
+    Kind Op{Kind::Deposit};
+    bool Ok{false};
+    Account::AccountType Type{Account::AccountType::CheckingAccount};
+    uint32_t Date{};
+    long double Amount{};
+    uint64_t AccountNumber{},Counterparty{};   // Open: the number the account received
+    Currency CurrencyCode{Currencies::USD};    // Open: the account's currency
+    vector<string> Strings;
+
+    static const char* KindToString(Kind);
+    static void PersonToStrings(const Person&,vector<string>& out);
+    static bool PersonFromStrings(const vector<string>&,Person& out,string* err = nullptr);
+};
+
+// Appends TraceOps to a compact binary file: a fixed 48-byte record per call plus
+// length-prefixed strings, buffered and written in large chunks. Version 1 files carry
+// no currency and read back as USD.
+class TraceRecorder{
+public:
+    TraceRecorder() = default;
+    ~TraceRecorder();
+    TraceRecorder(const TraceRecorder&) = delete;
+    TraceRecorder& operator=(const TraceRecorder&) = delete;
+
+    bool Open(const string& path,string* err = nullptr);
+    void Record(const TraceOp&);
+    // Writes what is buffered; Close also syncs and closes the file.
+    bool Flush(string* err = nullptr);
+    bool Close(string* err = nullptr);
+    [[nodiscard]] uint64_t Recorded()const;
+
+private:
+    int Fd{-1};
+    vector<char> Buffer;
+    uint64_t Count{0};
+    bool Failed{false};
+    string Error;
+};
+
+// Reads a whole trace into memory.
+bool ReadTrace(const string& path,vector<TraceOp>& out,string* err = nullptr);
+
+// Records one Management call when a recorder is attached; Succeed marks the outcome.
+class TraceScope{
+public:
+    TraceScope(TraceRecorder* recorder,TraceOp::Kind kind) : Recorder(recorder) { Op.Op = kind; }
+    ~TraceScope(){ if(Recorder) Recorder->Record(Op); }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+    [[nodiscard]] bool Active()const{ return Recorder != nullptr; }
+    TraceOp& Get(){ return Op; }
+    void Succeed(){ Op.Ok = true; }
+
+private:
+    TraceRecorder* Recorder;
+    TraceOp Op;
+};
+
+
+#endif //BANK_ACCOUNT_TRACE_H
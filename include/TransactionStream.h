@@ -0,0 +1,87 @@
+
+#ifndef BANK_ACCOUNT_TRANSACTION_STREAM_H
+#define BANK_ACCOUNT_TRANSACTION_STREAM_H
+
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include "Account.h"
+
+// Fixed-size copy of a ledger entry as seen by stream consumers.
+struct TransactionEvent{
+    uint64_t Sequence{};        // ring position: consecutive, in the order consumers read
+    uint64_t Lost{};            // events dropped or spilled since the previous ring event
+    uint64_t Account{};         // packed number of the account whose ledger got the entry
+    uint64_t Source{},Destination{};
+    long double Amount{};
+    long double BalanceAfter{};
+    uint32_t Date{};            // yyyymmdd
+    Account::TransactionTypes Type{};
+};
+
+
+// Bounded multi-producer, multi-consumer broadcast ring. Every consumer sees every
+// event that made it into the ring and reads in batches at its own pace. An event is
+// published only once the operation that appended its ledger entry has committed
+// (see Account::DeferPublication). Spilled events carry the Sequence of the ring event
+// that follows them.
+class TransactionStream{
+public:
+    enum class Backpressure{Block,Drop,Spill};
+    static constexpr std::size_t MaxConsumers = 16;
+
+    struct Stats{
+        uint64_t Published{},Dropped{},Spilled{};
+    };
+
+    // capacity is rounded up to a power of two; spill_path is used by Backpressure::Spill.
+    explicit TransactionStream(std::size_t capacity,Backpressure policy = Backpressure::Block,
+                               const std::string& spill_path = {});
+    ~TransactionStream();
+    TransactionStream(const TransactionStream&) = delete;
+    TransactionStream& operator=(const TransactionStream&) = delete;
+
+    void Publish(const Account&,const Account::Transaction&);
+
+    // Consumers start at the current head; returns -1 when all slots are taken.
+    int Subscribe();
+    void Unsubscribe(int consumer);
+    // Copies up to max pending events into out and returns how many were read.
+    std::size_t Poll(int consumer,TransactionEvent* out,std::size_t max);
+    [[nodiscard]] uint64_t Lag(int consumer)const;
+
+    [[nodiscard]] Stats GetStats()const;
+    [[nodiscard]] std::size_t Capacity()const;
+    [[nodiscard]] Backpressure Policy()const;
+
+private:
+    struct alignas(64) Slot{
+        std::atomic<uint64_t> Ready{0};  // ring position + 1 once the event is written
+        TransactionEvent Event;
+    };
+    struct alignas(64) Cursor{
+        std::atomic<uint64_t> Next{UINT64_MAX};  // UINT64_MAX: slot unused
+    };
+
+    uint64_t MinCursor(uint64_t head)const;
+    bool Claim(uint64_t& pos);
+    void SpillEvent(const TransactionEvent&);
+
+    std::size_t Mask;
+    Backpressure Policy_;
+    std::unique_ptr<Slot[]> Ring;
+    Cursor Consumers[MaxConsumers];
+    alignas(64) std::atomic<uint64_t> Head{0};
+    alignas(64) std::atomic<uint64_t> GateCache{0};
+    alignas(64) std::atomic<uint64_t> PendingLost{0};
+    std::atomic<uint64_t> Dropped{0},Spilled{0};
+    std::mutex SpillLock;
+    std::FILE* SpillFile{nullptr};
+};
+
+
+#endif //BANK_ACCOUNT_TRANSACTION_STREAM_H
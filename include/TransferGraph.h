@@ -0,0 +1,79 @@
+
+#ifndef BANK_ACCOUNT_TRANSFER_GRAPH_H
+#define BANK_ACCOUNT_TRANSFER_GRAPH_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "Account.h"
+#include "LedgerArchive.h"
+
+// Money flow between accounts over a date range in compressed sparse row form.
+// Vertices are accounts in number order; parallel transfers between a pair are merged
+// into one edge carrying the total (in cents) and the transfer count. Both the
+// outgoing and the incoming adjacency are kept, sorted by neighbour.
+class TransferGraph{
+public:
+    enum class Direction{Out,In,Both};
+
+    struct Counterparty{
+        string Account;
+        long double Amount{};
+        uint64_t Transfers{};
+    };
+    struct Flow{
+        long double In{},Out{};
+        uint64_t TransfersIn{},TransfersOut{};
+    };
+
+    // Reads the TransferOut entries dated within [from, to] of every account, archived
+    // ones included when an archive is given, on up to `threads` threads. Replaces any
+    // previous contents. The accounts must share one currency, so every amount is in
+    // it; transfers to accounts of another currency count as unresolved.
+    bool Build(const vector<const Account*>& accounts,const Account::Date& from,const Account::Date& to,
+               size_t threads,const LedgerArchive* archive = nullptr,string* err = nullptr);
+
+    [[nodiscard]] size_t VertexCount()const;
+    [[nodiscard]] size_t EdgeCount()const;
+    [[nodiscard]] uint64_t TransferCount()const;
+    [[nodiscard]] Currency GetCurrency()const;
+    // Transfers whose counterpart was not among the accounts given to Build.
+    [[nodiscard]] uint64_t Unresolved()const;
+
+    // Largest counterparties by amount; Both adds up the two directions per neighbour.
+    [[nodiscard]] vector<Counterparty> TopCounterparties(const string& account,size_t k,
+                                                         Direction = Direction::Both)const;
+    // Flow into and out of a group of accounts, ignoring transfers inside the group.
+    [[nodiscard]] Flow GroupFlow(const vector<string>& accounts)const;
+    // Accounts reachable within max_hops edges (the start itself excluded), nearest first.
+    [[nodiscard]] vector<string> ReachableWithin(const string& account,size_t max_hops,
+                                                 Direction = Direction::Out)const;
+
+private:
+    struct Edge{
+        uint32_t Vertex;
+        uint32_t Transfers;
+        int64_t Cents;
+    };
+    struct Adjacency{
+        vector<uint64_t> Offsets;   // VertexCount() + 1 entries
+        vector<Edge> Edges;
+    };
+
+    [[nodiscard]] int64_t VertexOf(const string& account)const;
+    [[nodiscard]] int64_t VertexOf(uint64_t packed)const;
+    [[nodiscard]] string AccountOf(uint32_t vertex)const;
+    // Sorts a row by neighbour and merges parallel edges in place.
+    static void MergeRow(vector<Edge>& row);
+    void Transpose();
+
+    vector<uint64_t> Numbers;      // packed account number per vertex, ascending
+    vector<uint8_t> NumberLength;  // digits per vertex, to restore leading zeros
+    Adjacency Out,In;
+    uint64_t Transfers{},UnresolvedTransfers{};
+    Currency CurrencyCode{};
+};
+
+
+#endif //BANK_ACCOUNT_TRANSFER_GRAPH_H
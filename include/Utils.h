@@ -6,6 +6,8 @@
 #include "Account.h"
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <cstdio>
 
 static inline bool is_finite_ld(long double x){
     return std::isfinite(x);
@@ -69,6 +71,76 @@ static inline string pad2(int v){
     return string(buf);
 }
 
+static inline uint32_t parse_digits(const string& s){
+    uint32_t v = 0;
+    for(unsigned char ch : s){
+        if(!isdigit(ch))return 0;
+        v = v * 10 + (ch - '0');
+    }
+    return v;
+}
+
+// yyyymmdd, so packed dates compare in calendar order.
+static inline uint32_t pack_date(const Account::Date& d){
+    return parse_digits(d.year) * 10000 + parse_digits(d.month) * 100 + parse_digits(d.day);
+}
+
+// Days since 1970-01-01 (proleptic Gregorian), for day arithmetic on Dates.
+static inline int32_t days_from_civil(int y,unsigned m,unsigned d){
+    y -= m <= 2;
+    const int era = (y >= 0 ? y : y - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(y - era * 400);
+    const unsigned doy = (153 * (m + (m > 2 ? -3 : 9)) + 2) / 5 + d - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int32_t>(doe) - 719468;
+}
+
+static inline int32_t date_to_days(const Account::Date& d){
+    return days_from_civil(static_cast<int>(parse_digits(d.year)),parse_digits(d.month),parse_digits(d.day));
+}
+
+// Inverse of days_from_civil.
+static inline void civil_from_days(int32_t z,int& y,unsigned& m,unsigned& d){
+    z += 719468;
+    const int era = (z >= 0 ? z : z - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(z - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    d = doy - (153 * mp + 2) / 5 + 1;
+    m = mp < 10 ? mp + 3 : mp - 9;
+    y = static_cast<int>(yoe) + era * 400 + (m <= 2);
+}
+
+static inline Account::Date days_to_date(int32_t days){
+    int y;
+    unsigned m,d;
+    civil_from_days(days,y,m,d);
+    return Account::Date{pad2(static_cast<int>(d)),pad2(static_cast<int>(m)),std::to_string(y)};
+}
+
+static inline Account::Date unpack_date(uint32_t packed){
+    return Account::Date{pad2(static_cast<int>(packed % 100)),pad2(static_cast<int>(packed / 100 % 100)),
+                         std::to_string(packed / 10000)};
+}
+
+// 10-digit account numbers fit in 64 bits; "Cash", "Closed" and other non-numeric endpoints pack to 0.
+static inline uint64_t pack_account_number(const string& s){
+    if(s.empty() || s.size() > 19)return 0;
+    uint64_t v = 0;
+    for(unsigned char ch : s){
+        if(!isdigit(ch))return 0;
+        v = v * 10 + (ch - '0');
+    }
+    return v;
+}
+
+static inline string unpack_account_number(uint64_t v,std::size_t len = 10){
+    string out(len,'0');
+    for(std::size_t i=len; i-- > 0 && v; v /= 10) out[i] = static_cast<char>('0' + v % 10);
+    return out;
+}
+
 
 
 
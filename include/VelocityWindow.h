@@ -0,0 +1,43 @@
+
+#ifndef BANK_ACCOUNT_VELOCITY_WINDOW_H
+#define BANK_ACCOUNT_VELOCITY_WINDOW_H
+
+#include <cstddef>
+#include <cstdint>
+
+// Outflow totals for the last Days calendar days, one ring slot per day.
+// Updated on every ledger append, so limit checks never scan the ledger.
+class VelocityWindow{
+public:
+    static constexpr std::size_t Days = 8;
+    enum Kind{Withdraw,TransferOut,KindCount};
+
+    struct Totals{
+        long double Amount{};
+        uint32_t Count{};
+    };
+
+    // Entries older than the window are ignored; they cannot affect a limit any more.
+    void Record(int32_t day,Kind,long double amount);
+    void Remove(int32_t day,Kind,long double amount);
+    void Clear();
+
+    [[nodiscard]] Totals Today(int32_t day,Kind)const;
+    // Sum over [day - days + 1, day]; days is clamped to Days.
+    [[nodiscard]] Totals Rolling(int32_t day,Kind,std::size_t days)const;
+
+private:
+    struct Slot{
+        int32_t Day{INT32_MIN};
+        uint32_t Count[KindCount]{};
+        int64_t Cents[KindCount]{};
+    };
+
+    Slot* SlotFor(int32_t day,bool create);
+    [[nodiscard]] const Slot* SlotFor(int32_t day)const;
+
+    Slot Ring[Days];
+};
+
+
+#endif //BANK_ACCOUNT_VELOCITY_WINDOW_H
@@ -1,5 +1,10 @@
 #include "Account.h"
 #include "Utils.h"
+#include "AccountPolicy.h"
+#include "Metrics.h"
+#include "TransactionStream.h"
+#include "Journal.h"
+#include "LedgerArchive.h"
 #include <random>
 #include <cmath>
 #include <algorithm>
@@ -39,17 +44,27 @@ string Account::GetAccountNumber() const {
 
 
 
-bool Account::SetOwner(Person p, std::string *err) {
-    if(p.GetIdCode().empty()){
+bool Account::SetOwner(const MemberStore &members, MemberId owner, std::string *err) {
+    const Person* p = members.Find(owner);
+    if(!p || p->GetIdCode().empty()){
         if(err) *err = "Error! Id-Code is empty.";
         return false;
     }
-    person = std::move(p);
+    Members = &members;
+    Owner = owner;
     if(err) err->clear();
     return true;
 
 }
 
+MemberId Account::GetOwnerId() const {
+    return Owner;
+}
+
+const Person *Account::GetOwner() const {
+    return Members ? Members->Find(Owner) : nullptr;
+}
+
 bool Account::SetInitialBalance(long double amount, string *err ) {
     if(!is_finite_ld(amount)){
         if(err) *err = "Error! please enter finite amount.";
@@ -60,13 +75,13 @@ bool Account::SetInitialBalance(long double amount, string *err ) {
         return false;
     }
 
-    this->Balance = amount;
+    Hot->Balance = amount;
     if(err) err->clear();
     return true;
 }
 
 bool Account::Deposit(long double amount,const Date& date, string *err) {
-    if(Account_is_closed){
+    if(Hot->Closed){
         if(err) *err = "Error! Account is already closed.";
         return false;
     }
@@ -74,17 +89,17 @@ bool Account::Deposit(long double amount,const Date& date, string *err) {
         if(err) *err = "Error! deposit must be finite/positive number.";
         return false;
     }
-    long double next = this->Balance + amount;
+    long double next = Hot->Balance + amount;
     if(!is_finite_ld(next)){
         if(err) *err = "Error! balance overflow!";
         return false;
     }
 
-    this->Balance = next;
+    Hot->Balance = next;
 
     if(!AppendTransaction(TransactionTypes::Deposit,amount,"Cash",
                           this->AccountNumber,date,err)){
-        this->Balance -=amount;
+        Hot->Balance -=amount;
         return false;
     }
 
@@ -93,34 +108,52 @@ bool Account::Deposit(long double amount,const Date& date, string *err) {
 }
 
 bool Account::Withdraw(long double wd,const Date& date,string *err) {
-    if(Account_is_closed){
+    return with_policy(Hot->Type,[&](auto policy){
+        return WithdrawAs<decltype(policy)>(wd,date,err);
+    });
+}
+
+template<class Policy>
+bool Account::WithdrawAs(long double wd,const Date& date,string *err) {
+    if(Hot->Closed){
         if(err) *err = "Error! Account is already closed.";
         return false;
     }
 
+    if constexpr (!Policy::AllowsCashWithdraw){
+        if(err) *err = "Error! this account type does not allow cash withdrawals.";
+        return false;
+    }
+
     if(!is_finite_ld(wd) || wd <= 0.0L){
         if(err) *err = "Error! withdraw should finite/positive number";
         return false;
     }
 
     constexpr long double EPS = 1e-12L;
-    if(this->Balance + EPS < wd){
+    if(Hot->DailyWithdrawLimit > 0.0L &&
+       Velocity.Today(date_to_days(date),VelocityWindow::Withdraw).Amount + wd > Hot->DailyWithdrawLimit + EPS){
+        if(err) *err = "Error! daily withdrawal limit exceeded.";
+        return false;
+    }
+
+    if(Hot->Balance + Policy::Overdraft + EPS < wd + Policy::MinimumBalance){
         if (err) *err = "Error! insufficient funds.";
         return false;
     }
 
 
-    long double next = this->Balance - wd;
+    long double next = Hot->Balance - wd;
     if(!is_finite_ld(next)){
         if(err) *err = "Error! balance underflow!";
         return false;
     }
 
-    this->Balance = next;
+    Hot->Balance = next;
 
     if(!AppendTransaction(TransactionTypes::Withdraw,wd,
                           this->AccountNumber,"Cash",date,err)){
-        this->Balance += wd;
+        Hot->Balance += wd;
         return false;
     }
 
@@ -130,7 +163,7 @@ bool Account::Withdraw(long double wd,const Date& date,string *err) {
 }
 
 long double Account::GetBalance() const {
-    return this->Balance;
+    return Hot->Balance;
 }
 
 bool Account::SetAccountNumber(string *err) {
@@ -140,14 +173,32 @@ bool Account::SetAccountNumber(string *err) {
 }
 
 bool Account::SetAccountType(Account::AccountType t, string *err) {
-    AccType = t;
+    Hot->Type = t;
     if(err) err->clear();
     return true;
 
 }
 
 Account::AccountType Account::GetAccountType() const {
-    return AccType;
+    return Hot->Type;
+}
+
+bool Account::SetCurrency(Currency c, string *err) {
+    if(!is_currency(c)){
+        if(err) *err = "Error! currency must be a 3-letter code (e.g. EUR).";
+        return false;
+    }
+    if(!AccountTransactions.empty() || ArchivedEntries){
+        if(err) *err = "Error! currency can only be set before the first transaction.";
+        return false;
+    }
+    Hot->CurrencyCode = c;
+    if(err) err->clear();
+    return true;
+}
+
+Currency Account::GetCurrency() const {
+    return Hot->CurrencyCode;
 }
 
  const char *Account::AccountTypeToString(Account::AccountType t) {
@@ -206,31 +257,39 @@ const Account::Date &Account::GetOpeningsDate() const {
 }
 
 void Account::DisplayAccountInfo() const {
-   cout<<left<<setw(15)<<"Name:"<<person.GetName()<<endl;
-   cout<<left<<setw(15)<<"FamilyName:"<<person.GetFamilyName()<<endl;
-   cout<<left<<setw(15)<<"Id-Code:"<<person.GetIdCode()<<endl;
-   cout<<left<<setw(15)<<"Account Number:"<<this->AccountNumber<<endl;
-   cout<<left<<setw(15)<<"Balance:"<<this->Balance<<"$"<<endl;
-   cout<<left<<setw(15)<<"Account Type:"<<Account::AccountTypeToString(AccType)<<endl;
-   cout << left << setw(15) << "Openings Date:" << OpeningsDate.day << "/" << OpeningsDate.month << "/" << OpeningsDate.year << endl;
-   if(this->Account_is_closed)
-       cout<<left<<setw(15)<<"Account status:"<<"Closed"<<endl;
+   const Person* owner = GetOwner();
+   cout<<left<<setw(15)<<"Name:"<<(owner ? owner->GetName() : "-")<<'\n';
+   cout<<left<<setw(15)<<"FamilyName:"<<(owner ? owner->GetFamilyName() : "-")<<'\n';
+   cout<<left<<setw(15)<<"Id-Code:"<<(owner ? owner->GetIdCode() : "-")<<'\n';
+   cout<<left<<setw(15)<<"Account Number:"<<this->AccountNumber<<'\n';
+   cout<<left<<setw(15)<<"Balance:"<<Hot->Balance<<' '<<currency_code(Hot->CurrencyCode)<<'\n';
+   cout<<left<<setw(15)<<"Account Type:"<<Account::AccountTypeToString(Hot->Type)<<'\n';
+   cout << left << setw(15) << "Openings Date:" << OpeningsDate.day << "/" << OpeningsDate.month << "/" << OpeningsDate.year << '\n';
+   if(Hot->Closed)
+       cout<<left<<setw(15)<<"Account status:"<<"Closed"<<'\n';
    else
-       cout<<left<<setw(15)<<"Account status:"<<"Open"<<endl;
+       cout<<left<<setw(15)<<"Account status:"<<"Open"<<'\n';
 
 }
 
 bool Account::Transfer(Account &Destination,long double amount,const Date& date, string *err) {
+    return with_policy(Hot->Type,[&](auto policy){
+        return TransferAs<decltype(policy)>(Destination,amount,date,err);
+    });
+}
+
+template<class Policy>
+bool Account::TransferAs(Account &Destination,long double amount,const Date& date, string *err) {
     auto fail = [&](const char* msg){
         if(err) *err = msg;
         return false;
     };
 
-    if(this->Account_is_closed){
+    if(Hot->Closed){
         return fail("Error! Account is already closed");
     }
 
-    if(Destination.Account_is_closed){
+    if(Destination.Hot->Closed){
         return fail("Error! Account of Destination is closed.");
     }
 
@@ -238,32 +297,58 @@ bool Account::Transfer(Account &Destination,long double amount,const Date& date,
         return fail("Error! AccountNumber is same as Destination.");
     }
 
+    if(Hot->CurrencyCode != Destination.Hot->CurrencyCode){
+        return fail("Error! accounts have different currencies.");
+    }
+
     if(!is_finite_ld(amount) || amount<=0.0L )return fail("Error! the amount must be finite positive number.");
     constexpr long double EPS = 1e-12L;
-    if(this->Balance + EPS < amount)return fail("Error! insufficient funds.");
+    if(Hot->DailyTransferLimit > 0.0L &&
+       Velocity.Today(date_to_days(date),VelocityWindow::TransferOut).Amount + amount > Hot->DailyTransferLimit + EPS)
+        return fail("Error! daily transfer limit exceeded.");
+    if(Hot->Balance + Policy::Overdraft + EPS < amount + Policy::MinimumBalance)return fail("Error! insufficient funds.");
+
+    if(amount > Hot->Balance + Policy::Overdraft - Policy::MinimumBalance)return fail("Error! Balance is not enough for Transfer.");
+    if(!is_finite_ld(Destination.Hot->Balance + amount))return fail("Error! Destination is overflow!");
 
-    if(amount > this->Balance)return fail("Error! Balance is not enough for Transfer.");
-    if(!is_finite_ld(Destination.Balance + amount))return fail("Error! Destination is overflow!");
+    return Book(Destination,amount,Hot->Balance - amount,Destination.Hot->Balance + amount,date,err);
+}
 
+bool Account::ApplyTransfer(Account &Destination, int64_t cents, const Date &date, string *err) {
+    const long double amount = static_cast<long double>(cents) / 100.0L;
+    long double from = Hot->Balance - amount;
+    // Spending a balance exactly can land a rounding error below zero; anything more
+    // than that is a real shortfall and is rejected with the entry.
+    constexpr long double Noise = 1e-6L;
+    if(from < 0.0L && from > -Noise) from = 0.0L;
+    return Book(Destination,amount,from,Destination.Hot->Balance + amount,date,err);
+}
 
-    this->Balance = this->Balance - amount;
-    Destination.Balance = Destination.Balance + amount;
+bool Account::Book(Account &Destination, long double amount, long double balance, long double destination_balance,
+                   const Date &date, string *err) {
+    const LedgerMark src_mark = GetLedgerMark(),dst_mark = Destination.GetLedgerMark();
+    // Inside a caller's deferral (e.g. a multi-leg transfer) the caller publishes.
+    const bool publish_src = !Deferring,publish_dst = !Destination.Deferring;
+    if(publish_src) DeferPublication();
+    if(publish_dst) Destination.DeferPublication();
 
-    size_t src_size_before = this->AccountTransactions.size();
+    Hot->Balance = balance;
+    Destination.Hot->Balance = destination_balance;
 
     if(!this->AppendTransaction(TransactionTypes::TransferOut,amount,
-                          this->AccountNumber,Destination.AccountNumber,date,err)){
-        this->Balance += amount;
-        Destination.Balance -= amount;
+                          this->AccountNumber,Destination.AccountNumber,date,err) ||
+       !Destination.AppendTransaction(TransactionTypes::TransferIn,amount,
+                                      this->AccountNumber,Destination.AccountNumber,date,err)){
+        RollbackTo(src_mark);
+        Destination.RollbackTo(dst_mark);
         return false;
     }
-    size_t dst_size_before = Destination.AccountTransactions.size();
 
-    if(!Destination.AppendTransaction(TransactionTypes::TransferIn,amount,
-                                      this->AccountNumber,Destination.AccountNumber,date,err)){
-        this->Balance += amount;
-        Destination.Balance -= amount;
-        this->AccountTransactions.resize(src_size_before);
+    Account* both[] = {this,&Destination};
+    const size_t publish = publish_src + publish_dst;
+    if(publish && !PublishDeferred(publish_src ? both : both + 1,publish,err)){
+        RollbackTo(src_mark);
+        Destination.RollbackTo(dst_mark);
         return false;
     }
 
@@ -274,17 +359,17 @@ bool Account::Transfer(Account &Destination,long double amount,const Date& date,
 }
 
 bool Account::CloseAccount(string *err) {
-    if(Account_is_closed){
+    if(Hot->Closed){
         if(err) *err = "Error! Account is already closed.";
         return false;
     }
 
-    if(this->Balance != 0.0L){
+    if(Hot->Balance != 0.0L){
         if(err) *err = "Error! Balance must be zero.";
         return false;
     }
 
-    Account_is_closed = true;
+    Hot->Closed = true;
     if(err) err->clear();
     return true;
 
@@ -297,7 +382,7 @@ bool Account::TransactionValidation(const Account::Transaction &t, string *err)
         if(err) *err = "Error! the amount must be finite number.";
         return false;
     }
-    if(t.amount <= 0){
+    if(t.amount <= 0 && !(t.type == TransactionTypes::Close && t.amount == 0)){
         if(err) *err = "Error! amount must be positive number.";
         return false;
     }
@@ -327,7 +412,7 @@ bool Account::TransactionValidation(const Account::Transaction &t, string *err)
 bool Account::AppendTransaction(Account::TransactionTypes type, long double amount, const string &source,
                                 const string &destination,const Account::Date &date, string *err) {
 
-      if(this->Account_is_closed){
+      if(Hot->Closed){
           if(err) *err = "Error! Account is already closed.";
           return false;
       }
@@ -337,10 +422,21 @@ bool Account::AppendTransaction(Account::TransactionTypes type, long double amou
       t.destination = destination;
       t.type = type;
       t.trans = date;
-      t.balance_after = this->Balance;
+      t.balance_after = Hot->Balance;
+      t.currency = Hot->CurrencyCode;
 
       if(TransactionValidation(t,err)){
+          const LedgerMark mark = GetLedgerMark();
           AccountTransactions.emplace_back(t);
+          const uint32_t day = pack_date(date);
+          if(day < NewestDate) DateOrdered = false;
+          else NewestDate = day;
+          RecordVelocity(AccountTransactions.back());
+          BANK_METRIC_LEDGER(AccountTransactions.size());
+          if(!Deferring && !Publish(AccountTransactions.size() - 1,err)){
+              RollbackTo(mark);
+              return false;
+          }
           if(err) err->clear();
           return true;
       }
@@ -356,13 +452,13 @@ const vector<Account::Transaction> &Account::GetTransactions() const {
 
 void Account::DisplayTransactions() const {
     for(const auto& it : this->AccountTransactions){
-        cout<<left<<setw(15)<<"Date:"<<it.trans.day<<"/"<<it.trans.month<<"/"<<it.trans.year<<endl;
-        cout<<left<<setw(15)<<"Amount:"<<it.amount<<endl;
-        cout<<left<<setw(15)<<"Source:"<<it.source<<endl;
-        cout<<left<<setw(15)<<"Destination:"<<it.destination<<endl;
-        cout<<left<<setw(15)<<"TransactionType:"<<Account::TransactionTypeToString(it.type)<<endl;
-        cout<<left<<setw(15)<<"Updated Balance:"<<it.balance_after<<endl;
-        cout<<"--------------------------------------"<<endl;
+        cout<<left<<setw(15)<<"Date:"<<it.trans.day<<"/"<<it.trans.month<<"/"<<it.trans.year<<'\n';
+        cout<<left<<setw(15)<<"Amount:"<<it.amount<<' '<<currency_code(it.currency)<<'\n';
+        cout<<left<<setw(15)<<"Source:"<<it.source<<'\n';
+        cout<<left<<setw(15)<<"Destination:"<<it.destination<<'\n';
+        cout<<left<<setw(15)<<"TransactionType:"<<Account::TransactionTypeToString(it.type)<<'\n';
+        cout<<left<<setw(15)<<"Updated Balance:"<<it.balance_after<<'\n';
+        cout<<"--------------------------------------"<<'\n';
     }
 
 
@@ -382,34 +478,318 @@ const char *Account::TransactionTypeToString(Account::TransactionTypes t) {
 
 }
 
-void Account::SaveToFile(ostream &os) const {
-    os<<"Account Number:"<<this->AccountNumber<<endl;
-    os<<"Balance:"<<this->Balance<<endl;
-    os<<"AccountType:"<<Account::AccountTypeToString(AccType)<<endl;
-    os<<"Status:"<<(Account::Account_is_closed ? "Closed":"Open")<<endl;
-    os<<"OpeningsDate:"<<this->OpeningsDate.day<<"/"<<this->OpeningsDate.month<<"/"<<this->OpeningsDate.year<<endl;
-
-    os<<"Number of Transactions:"<<this->AccountTransactions.size()<<endl;
-    for(const auto& t: this->AccountTransactions){
-        os<<"Date:"<<t.trans.day<<"/"<<t.trans.month<<"/"<<t.trans.year<<endl;
-        os<<"Amount:"<<t.amount<<endl;
-        os<<"Source:"<<t.source<<endl;
-        os<<"Destination:"<<t.destination<<endl;
-        os<<"TransactionType:"<<Account::TransactionTypeToString(t.type)<<endl;
-        os<<"Updated Balance:"<<t.balance_after<<endl;
-        os<<"---"<<endl;
+void Account::SaveToFile(ostream &os, const LedgerArchive *archive) const {
+    os<<"Account Number:"<<this->AccountNumber<<'\n';
+    os<<"Balance:"<<Hot->Balance<<'\n';
+    os<<"AccountType:"<<Account::AccountTypeToString(Hot->Type)<<'\n';
+    os<<"Currency:"<<currency_code(Hot->CurrencyCode)<<'\n';
+    os<<"Status:"<<(Hot->Closed ? "Closed":"Open")<<'\n';
+    os<<"OpeningsDate:"<<this->OpeningsDate.day<<"/"<<this->OpeningsDate.month<<"/"<<this->OpeningsDate.year<<'\n';
+
+    const uint64_t archived = archive ? ArchivedEntries : 0;
+    os<<"Number of Transactions:"<<archived + this->AccountTransactions.size()<<'\n';
+    auto write = [&os](const Transaction& t){
+        os<<"Date:"<<t.trans.day<<"/"<<t.trans.month<<"/"<<t.trans.year<<'\n';
+        os<<"Amount:"<<t.amount<<'\n';
+        os<<"Source:"<<t.source<<'\n';
+        os<<"Destination:"<<t.destination<<'\n';
+        os<<"TransactionType:"<<Account::TransactionTypeToString(t.type)<<'\n';
+        os<<"Updated Balance:"<<t.balance_after<<'\n';
+        os<<"---"<<'\n';
+    };
+    if(archived){
+        Transaction t;
+        archive->ForEach(this->AccountNumber,[&](const PackedTransaction& p){
+            p.UnpackInto(t);
+            write(t);
+        });
     }
+    for(const auto& t: this->AccountTransactions) write(t);
 }
 
 bool Account::is_closed() const {
-    return this->Account_is_closed;
+    return Hot->Closed;
 }
 
 void Account::SetClosed(bool v) {
-    this->Account_is_closed = v;
+    Hot->Closed = v;
 
 }
 
+bool Account::PostInterest(const Date &date, string *err) {
+    return with_policy(Hot->Type,[&](auto policy){
+        return PostInterestAs<decltype(policy)>(date,err);
+    });
+}
+
+template<class Policy>
+bool Account::PostInterestAs(const Date &date, string *err) {
+    if constexpr (Policy::AnnualInterest <= 0.0L){
+        if(err) err->clear();
+        return true;
+    }
+    if(Hot->Closed || Hot->Balance <= 0.0L){
+        if(err) err->clear();
+        return true;
+    }
+
+    long double interest = std::round(Hot->Balance * Policy::AnnualInterest / 12.0L * 100.0L) / 100.0L;
+    if(interest <= 0.0L){
+        if(err) err->clear();
+        return true;
+    }
+
+    Hot->Balance += interest;
+    if(!AppendTransaction(TransactionTypes::Deposit,interest,"Interest",this->AccountNumber,date,err)){
+        Hot->Balance -= interest;
+        return false;
+    }
+    return true;
+}
+
+template bool Account::WithdrawAs<CheckingPolicy>(long double,const Date&,string*);
+template bool Account::WithdrawAs<SavingPolicy>(long double,const Date&,string*);
+template bool Account::WithdrawAs<FixedDepositPolicy>(long double,const Date&,string*);
+template bool Account::TransferAs<CheckingPolicy>(Account&,long double,const Date&,string*);
+template bool Account::TransferAs<SavingPolicy>(Account&,long double,const Date&,string*);
+template bool Account::TransferAs<FixedDepositPolicy>(Account&,long double,const Date&,string*);
+template bool Account::PostInterestAs<CheckingPolicy>(const Date&,string*);
+template bool Account::PostInterestAs<SavingPolicy>(const Date&,string*);
+template bool Account::PostInterestAs<FixedDepositPolicy>(const Date&,string*);
+
+void Account::RecordVelocity(const Account::Transaction &t) {
+    if(t.type == TransactionTypes::Withdraw)
+        Velocity.Record(date_to_days(t.trans),VelocityWindow::Withdraw,t.amount);
+    else if(t.type == TransactionTypes::TransferOut)
+        Velocity.Record(date_to_days(t.trans),VelocityWindow::TransferOut,t.amount);
+}
+
+void Account::RebuildVelocity() {
+    Velocity.Clear();
+    for(const auto& t : AccountTransactions) RecordVelocity(t);
+}
+
+const VelocityWindow &Account::GetVelocity() const {
+    return Velocity;
+}
+
+bool Account::SetDailyLimits(long double withdraw, long double transfer, string *err) {
+    if(!is_finite_ld(withdraw) || !is_finite_ld(transfer) || withdraw < 0.0L || transfer < 0.0L){
+        if(err) *err = "Error! limits must be finite and not negative.";
+        return false;
+    }
+    Hot->DailyWithdrawLimit = withdraw;
+    Hot->DailyTransferLimit = transfer;
+    if(err) err->clear();
+    return true;
+}
+
+void Account::AttachStream(TransactionStream *stream) {
+    this->Stream = stream;
+}
+
+void Account::AttachJournal(Journal *journal) {
+    this->JournalLog = journal;
+}
+
+uint64_t Account::GetJournalHead() const {
+    return JournalHead;
+}
+
+bool Account::MarkDirty() {
+    if(Hot->Dirty)return false;
+    Hot->Dirty = true;
+    return true;
+}
+
+size_t Account::GetCheckpointWatermark() const {
+    return CheckpointWatermark;
+}
+
+bool Account::TransferOutTo(const string &destination, long double amount, const Date &date, string *err) {
+    if(destination == AccountNumber){
+        if(err) *err = "Error! AccountNumber is same as Destination.";
+        return false;
+    }
+    if(!CanTransferOut(amount,date,err))return false;
+    Hot->Balance -= amount;
+    if(!AppendTransaction(TransactionTypes::TransferOut,amount,AccountNumber,destination,date,err)){
+        Hot->Balance += amount;
+        return false;
+    }
+    if(err) err->clear();
+    return true;
+}
+
+bool Account::TransferInFrom(const string &source, long double amount, const Date &date, string *err) {
+    if(Hot->Closed){
+        if(err) *err = "Error! Account of Destination is closed.";
+        return false;
+    }
+    if(!is_finite_ld(amount) || amount <= 0.0L){
+        if(err) *err = "Error! the amount must be finite positive number.";
+        return false;
+    }
+    if(!is_finite_ld(Hot->Balance + amount)){
+        if(err) *err = "Error! Destination is overflow!";
+        return false;
+    }
+    Hot->Balance += amount;
+    if(!AppendTransaction(TransactionTypes::TransferIn,amount,source,AccountNumber,date,err)){
+        Hot->Balance -= amount;
+        return false;
+    }
+    if(err) err->clear();
+    return true;
+}
+
+void Account::MarkCheckpointed() {
+    Hot->Dirty = false;
+    CheckpointWatermark = ArchivedEntries + AccountTransactions.size();
+}
+
+bool Account::CanTransferOut(long double total, const Date &date, string *err) const {
+    return with_policy(Hot->Type,[&](auto policy){
+        using Policy = decltype(policy);
+        auto fail = [&](const char* msg){
+            if(err) *err = msg;
+            return false;
+        };
+        if(Hot->Closed)return fail("Error! Account is already closed");
+        if(!is_finite_ld(total) || total <= 0.0L)return fail("Error! the amount must be finite positive number.");
+        constexpr long double EPS = 1e-12L;
+        if(Hot->DailyTransferLimit > 0.0L &&
+           Velocity.Today(date_to_days(date),VelocityWindow::TransferOut).Amount + total > Hot->DailyTransferLimit + EPS)
+            return fail("Error! daily transfer limit exceeded.");
+        if(std::llround(total * 100.0L) > std::llround((Hot->Balance + Policy::Overdraft - Policy::MinimumBalance) * 100.0L))
+            return fail("Error! insufficient funds.");
+        if(err) err->clear();
+        return true;
+    });
+}
+
+Account::LedgerMark Account::GetLedgerMark() const {
+    return LedgerMark{AccountTransactions.size(),Hot->Balance,JournalHead};
+}
+
+void Account::RollbackTo(const Account::LedgerMark &mark) {
+    for(size_t i=mark.Entries; i<AccountTransactions.size(); ++i){
+        const Transaction& t = AccountTransactions[i];
+        if(t.type == TransactionTypes::Withdraw)
+            Velocity.Remove(date_to_days(t.trans),VelocityWindow::Withdraw,t.amount);
+        else if(t.type == TransactionTypes::TransferOut)
+            Velocity.Remove(date_to_days(t.trans),VelocityWindow::TransferOut,t.amount);
+    }
+    if(mark.Entries < AccountTransactions.size()) AccountTransactions.resize(mark.Entries);
+    Hot->Balance = mark.Balance;
+    JournalHead = mark.JournalHead;
+    if(Deferring && mark.Entries <= DeferredFrom) Deferring = false;
+}
+
+void Account::DeferPublication() {
+    Deferring = true;
+    DeferredFrom = AccountTransactions.size();
+}
+
+bool Account::IsDeferring() const {
+    return Deferring;
+}
+
+bool Account::PublishDeferred(Account *const *accounts, size_t n, string *err) {
+    std::unique_lock<std::recursive_mutex> hold;
+    if(n && accounts[0]->JournalLog){
+        hold = accounts[0]->JournalLog->Hold();
+        uint64_t records = 0;
+        for(size_t i=0; i<n; ++i)
+            if(accounts[i]->Deferring) records += accounts[i]->AccountTransactions.size() - accounts[i]->DeferredFrom;
+        if(!accounts[0]->JournalLog->HasRoom(records)){
+            if(err) *err = "Error! journal is full.";
+            return false;
+        }
+    }
+    for(size_t i=0; i<n; ++i){
+        Account& acc = *accounts[i];
+        if(!acc.Deferring)continue;
+        acc.Deferring = false;
+        acc.Publish(acc.DeferredFrom,nullptr);
+    }
+    if(err) err->clear();
+    return true;
+}
+
+bool Account::Publish(size_t first, string *err) {
+    std::unique_lock<std::recursive_mutex> hold;
+    if(JournalLog){
+        hold = JournalLog->Hold();
+        if(!JournalLog->HasRoom(AccountTransactions.size() - first)){
+            if(err) *err = "Error! journal is full.";
+            return false;
+        }
+    }
+    for(size_t i=first; i<AccountTransactions.size(); ++i){
+        const Transaction& t = AccountTransactions[i];
+        if(JournalLog) JournalHead = JournalLog->Append(*this,t,JournalHead);
+        if(Stream) Stream->Publish(*this,t);
+    }
+    return true;
+}
+
+void Account::ReserveTransactions(size_t additional) {
+    const size_t need = AccountTransactions.size() + additional;
+    // Keep geometric growth; an exact reserve per call would reallocate every time.
+    if(need > AccountTransactions.capacity()) AccountTransactions.reserve(std::max(need,AccountTransactions.capacity() * 2));
+}
+
+void Account::ReleaseLedgerPrefix(size_t n) {
+    n = std::min(n,AccountTransactions.size());
+    if(!n)return;
+    AccountTransactions.erase(AccountTransactions.begin(),AccountTransactions.begin() + static_cast<ptrdiff_t>(n));
+    AccountTransactions.shrink_to_fit();
+    ArchivedEntries += n;
+}
+
+uint64_t Account::GetArchivedCount() const {
+    return ArchivedEntries;
+}
+
+bool Account::LedgerInDateOrder() const {
+    return DateOrdered;
+}
+
+void Account::BindHot(HotFields *slot) {
+    Hot.Bind(slot);
+}
+
+Account::HotHandle &Account::HotHandle::operator=(const HotHandle &o) {
+    if(this == &o)return *this;
+    if(!Ptr){
+        Own = make_unique<HotFields>();
+        Ptr = Own.get();
+    }
+    *Ptr = *o.Ptr;
+    return *this;
+}
+
+// A bound record stays where it is and takes the values; otherwise the pointer moves.
+Account::HotHandle &Account::HotHandle::operator=(HotHandle &&o) noexcept {
+    if(this == &o)return *this;
+    if(Ptr && !Own){
+        *Ptr = *o.Ptr;
+        return *this;
+    }
+    Own = std::move(o.Own);
+    Ptr = o.Ptr;
+    o.Ptr = nullptr;
+    return *this;
+}
+
+void Account::HotHandle::Bind(HotFields *slot) {
+    *slot = *Ptr;
+    Ptr = slot;
+    Own.reset();
+}
+
+
 
 
 
@@ -1,25 +1,61 @@
 #include "Bank Management.h"
 #include "Utils.h"
+#include "Metrics.h"
+#include "Trace.h"
 #include <algorithm>
-
+#include <cmath>
+#include <thread>
+
+
+static void trace_call(TraceScope& trace,const Date& date,long double amount,const string& account,
+                       const string& counterparty = string()){
+    if(!trace.Active())return;
+    TraceOp& op = trace.Get();
+    op.Date = pack_date(date);
+    op.Amount = amount;
+    op.AccountNumber = pack_account_number(account);
+    op.Counterparty = pack_account_number(counterparty);
+}
 
 bool Management::OpenAccount(const Person &person, long double initial_balance, Account::AccountType type,
                              const Date &date, string *err) {
+    return OpenAccount(person,initial_balance,type,Currencies::USD,date,err);
+}
+
+bool Management::OpenAccount(const Person &person, long double initial_balance, Account::AccountType type,
+                             Currency currency, const Date &date, string *err) {
+    BANK_METRIC_SCOPE(MetricOp::OpenAccount);
+    TraceScope trace(Trace,TraceOp::Kind::Open);
+    if(trace.Active()){
+        trace_call(trace,date,initial_balance,string());
+        trace.Get().Type = type;
+        trace.Get().CurrencyCode = currency;
+        TraceOp::PersonToStrings(person,trace.Get().Strings);
+    }
 
     if(err) err->clear();
 
     if(person.GetIdCode().empty()){
         if(err) *err = "Error! IdCode is empty.";
+        BANK_METRIC_FAIL(MetricFailure::EmptyInput);
         return false;
     }
 
 
-    if(!AddPerson(person,err)){
-        return false;
+    // Existing members open further accounts under the same record.
+    MemberId owner = Members->Lookup(person.GetIdCode());
+    if(owner == MemberStore::NoMember){
+        // Not counted or traced as an AddPerson of its own; replaying the Open adds it again.
+        if(!RegisterPerson(person,err)){
+            BANK_METRIC_FAIL(MetricFailure::Rejected);
+            return false;
+        }
+        owner = Members->Lookup(person.GetIdCode());
     }
 
     if(!is_finite_ld(initial_balance) || initial_balance <= 0){
         if(err) *err = "Error! initial balance must be finite positive.";
+        BANK_METRIC_FAIL(MetricFailure::InvalidAmount);
         return false;
     }
 
@@ -29,38 +65,71 @@ bool Management::OpenAccount(const Person &person, long double initial_balance,
         if(!NewAccount.SetAccountNumber(err)){
             return false;
         }
-    } while (KeepAccounts.find(NewAccount.GetAccountNumber()) != KeepAccounts.end());
+    } while (AccountIndex.find(NewAccount.GetAccountNumber()) != AccountIndex.end() ||
+             pack_account_number(NewAccount.GetAccountNumber()) % NumberParts != NumberPart);
 
 
-    if(!NewAccount.SetOwner(person,err))return false;
+    NewAccount.AttachStream(Stream);
+    NewAccount.AttachJournal(JournalLog);
+    if(!NewAccount.SetOwner(*Members,owner,err))return false;
     if(!NewAccount.SetInitialBalance(initial_balance,err))return false;
     if(!NewAccount.SetAccountType(type,err))return false;
-    if(!NewAccount.SetOpeningsDate(date.day,date.month,date.year,err))return false;
+    if(!NewAccount.SetCurrency(currency,err)){
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
+        return false;
+    }
+    if(!NewAccount.SetOpeningsDate(date.day,date.month,date.year,err)){
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
+        return false;
+    }
 
     if(!NewAccount.AppendTransaction(Account::TransactionTypes::Open,initial_balance,"Cash",NewAccount.GetAccountNumber(),
                                      date,err))return false;
 
     const string AccNum = NewAccount.GetAccountNumber();
-    KeepAccounts.emplace(AccNum,NewAccount);
+    Account& inserted = Accounts.emplace_back(std::move(NewAccount));
+    inserted.BindHot(HotRecords.Allocate());
+    AccountIndex.emplace(AccNum,AccountRef{&inserted,static_cast<uint32_t>(Accounts.size() - 1)});
     AccountsByOwner[person.GetIdCode()].push_back(AccNum);
+    AccountsByType[account_type_index(type)].push_back(&inserted);
+    AccountNumbers.Insert(AccNum);
+    MarkDirty(inserted);
 
+    if(trace.Active()) trace.Get().AccountNumber = pack_account_number(AccNum);
+    trace.Succeed();
+    BANK_METRIC_OK();
     return true;
 
 }
 
+bool Management::RegisterPerson(const Person &p, string *err) {
+    if(Members->Add(p,err) == MemberStore::NoMember)return false;
+    IdCodes.Insert(p.GetIdCode());
+    return true;
+}
+
 bool Management::AddPerson(const Person &p,string* err) {
+    BANK_METRIC_SCOPE(MetricOp::AddPerson);
+    TraceScope trace(Trace,TraceOp::Kind::AddPerson);
+    if(trace.Active()) TraceOp::PersonToStrings(p,trace.Get().Strings);
     if(p.GetIdCode().empty()){
         if(err) *err = "Error! IdCode is empty.";
+        BANK_METRIC_FAIL(MetricFailure::EmptyInput);
         return false;
     }
 
-    if(MembersById.find(p.GetIdCode()) != MembersById.end()){
+    if(Members->Lookup(p.GetIdCode()) != MemberStore::NoMember){
         if(err) *err = "Error! this IdCode is already exists.";
+        BANK_METRIC_FAIL(MetricFailure::Duplicate);
         return false;
     }
 
-    MembersById[p.GetIdCode()] = p;
-    if(err) err->clear();
+    if(!RegisterPerson(p,err)){
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
+        return false;
+    }
+    trace.Succeed();
+    BANK_METRIC_OK();
     return true;
 
 
@@ -68,81 +137,108 @@ bool Management::AddPerson(const Person &p,string* err) {
 }
 
 bool Management::CloseAccount(const string &owner_id, const string &account_number, const Date &date, string *err) {
+    BANK_METRIC_SCOPE(MetricOp::CloseAccount);
+    TraceScope trace(Trace,TraceOp::Kind::Close);
+    if(trace.Active()){
+        trace_call(trace,date,0.0L,account_number);
+        trace.Get().Strings = {owner_id};
+    }
     if(owner_id.empty()){
         if(err) *err = "Error! Id is empty.";
+        BANK_METRIC_FAIL(MetricFailure::EmptyInput);
         return false;
     }
 
     if(account_number.empty()){
         if(err) *err = "Error! AccountNumber is empty.";
+        BANK_METRIC_FAIL(MetricFailure::EmptyInput);
         return false;
     }
 
     auto itlist = AccountsByOwner.find(owner_id);
     if(itlist == AccountsByOwner.end()){
         if(err) *err = "Error! owner has no accounts.";
+        BANK_METRIC_FAIL(MetricFailure::NotFound);
         return false;
     }
 
-    auto itowner = MembersById.find(account_number);
-    if(itowner == MembersById.end()){
+    if(Members->Lookup(owner_id) == MemberStore::NoMember){
         if(err) *err = "Error! owner not found.";
+        BANK_METRIC_FAIL(MetricFailure::NotFound);
         return false;
     }
 
     const auto& accounts = itlist->second;
     if(find(accounts.begin(),accounts.end(),account_number) == accounts.end()){
         if (err) *err = "Error! account does not belong to this owner.";
+        BANK_METRIC_FAIL(MetricFailure::NotFound);
         return false;
     }
 
-    auto itAcc = KeepAccounts.find(account_number);
-    if(itAcc == KeepAccounts.end()){
+    Account* found = FindAccount(account_number);
+    if(!found){
         if (err) *err = "Error! account not found.";
+        BANK_METRIC_FAIL(MetricFailure::NotFound);
         return false;
     }
 
-    Account& acc = itAcc->second;
-    if(!acc.is_closed()){
+    Account& acc = *found;
+    if(acc.is_closed()){
         if (err) *err = "Error! account is already closed.";
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
         return false;
     }
 
     constexpr long double EPS = 1e-12L;
     if(fabsl(acc.GetBalance()) > EPS){
         if (err) *err = "Error! balance must be zero before closing.";
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
         return false;
     }
 
     if(!acc.AppendTransaction(Account::TransactionTypes::Close,0.0L,acc.GetAccountNumber(),"Closed",date,err)){
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
         return false;
     }
 
     acc.SetClosed(true);
+    MarkDirty(acc);
     if(err) err->clear();
+    trace.Succeed();
+    BANK_METRIC_OK();
     return true;
 
 }
 
 bool Management::DepositAccount(const string &account_number, long double amount, const Date &date, string *err) {
+    BANK_METRIC_SCOPE(MetricOp::Deposit);
+    TraceScope trace(Trace,TraceOp::Kind::Deposit);
+    trace_call(trace,date,amount,account_number);
     if(account_number.empty()){
         if(err) *err = "Error! AccountNumber is empty.";
+        BANK_METRIC_FAIL(MetricFailure::EmptyInput);
         return false;
     }
 
-    auto it = KeepAccounts.find(account_number);
-    if(it == KeepAccounts.end()){
+    BANK_METRIC_PROBE(AccountIndex,account_number);
+    Account* found = FindAccount(account_number);
+    if(!found){
         if(err) *err = "Error! Account is not found.";
+        BANK_METRIC_FAIL(MetricFailure::NotFound);
         return false;
     }
 
-    Account& acc = it->second;
+    Account& acc = *found;
 
     if (!acc.Deposit(amount, date, err)) {
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
         return false;
     }
+    MarkDirty(acc);
 
     if(err) err->clear();
+    trace.Succeed();
+    BANK_METRIC_OK();
     return true;
 
 
@@ -151,64 +247,746 @@ bool Management::DepositAccount(const string &account_number, long double amount
 }
 
 bool Management::WithdrawFromAccount(const string &account_number, long double amount, const Date &date, string *err) {
+    BANK_METRIC_SCOPE(MetricOp::Withdraw);
+    TraceScope trace(Trace,TraceOp::Kind::Withdraw);
+    trace_call(trace,date,amount,account_number);
 
     if(account_number.empty()){
         if(err) *err = "Error! AccountNumber is empty.";
+        BANK_METRIC_FAIL(MetricFailure::EmptyInput);
         return false;
     }
 
-    auto it = KeepAccounts.find(account_number);
-    if(it == KeepAccounts.end()){
+    BANK_METRIC_PROBE(AccountIndex,account_number);
+    Account* found = FindAccount(account_number);
+    if(!found){
         if(err) *err = "Error! Account is not found.";
+        BANK_METRIC_FAIL(MetricFailure::NotFound);
         return false;
     }
 
-    Account& acc = it->second;
+    Account& acc = *found;
 
-    if(!acc.Withdraw(amount,date,err))return false;
+    if(!acc.Withdraw(amount,date,err)){
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
+        return false;
+    }
+    MarkDirty(acc);
 
     if(err) err->clear();
+    trace.Succeed();
+    BANK_METRIC_OK();
     return true;
 
 }
 
 bool Management::TransferBetweenAccounts(const string &SourceAccNum, const string &DestinationAccNum,
                                          long double amount, const Date &date, string *err) {
+    BANK_METRIC_SCOPE(MetricOp::Transfer);
+    TraceScope trace(Trace,TraceOp::Kind::Transfer);
+    trace_call(trace,date,amount,SourceAccNum,DestinationAccNum);
 
     if(SourceAccNum.empty()){
         if(err) *err = "Error! Source Account Number is empty.";
+        BANK_METRIC_FAIL(MetricFailure::EmptyInput);
         return false;
     }
 
     if(DestinationAccNum.empty()){
         if(err) *err = "Error! Destination Account Number is empty.";
+        BANK_METRIC_FAIL(MetricFailure::EmptyInput);
         return false;
     }
 
-    auto ItSource = KeepAccounts.find(SourceAccNum);
-    auto ItDestination = KeepAccounts.find(DestinationAccNum);
+    BANK_METRIC_PROBE(AccountIndex,SourceAccNum);
+    Account* Source = FindAccount(SourceAccNum);
+    Account* Destination = FindAccount(DestinationAccNum);
 
-    if(ItSource == KeepAccounts.end()){
+    if(!Source){
         if(err) *err = "Error! Source Account is not found.";
+        BANK_METRIC_FAIL(MetricFailure::NotFound);
         return false;
     }
 
-    if(ItDestination == KeepAccounts.end()){
+    if(!Destination){
         if(err) *err = "Error! Destination Account is not found.";
+        BANK_METRIC_FAIL(MetricFailure::NotFound);
+        return false;
+    }
+
+    Account& acc1 = *Source;
+    Account& acc2 = *Destination;
+
+    const bool ok = acc1.GetCurrency() == acc2.GetCurrency() ? acc1.Transfer(acc2,amount,date,err)
+                                                              : TransferConverted(acc1,acc2,amount,date,err);
+    if(!ok){
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
+        return false;
+    }
+    MarkDirty(acc1);
+    MarkDirty(acc2);
+
+    if(err) err->clear();
+    trace.Succeed();
+    BANK_METRIC_OK();
+    return true;
+
+
+
+}
+
+// Debit in the source currency, credit the converted amount; both entries are published
+// together, as adjacent journal records, once the credit has been booked.
+bool Management::TransferConverted(Account &source, Account &destination, long double amount, const Date &date,
+                                   string *err) {
+    auto fail = [&](const char* msg){
+        if(err) *err = msg;
+        return false;
+    };
+    if(!Fx)return fail("Error! no FX rate table for a cross-currency transfer.");
+    if(destination.is_closed())return fail("Error! Account of Destination is closed.");
+    if(!is_finite_ld(amount) || amount <= 0.0L || amount * 100.0L >= 9.2e18L)
+        return fail("Error! the amount must be finite positive number.");
+    int64_t credited = 0;
+    if(!Fx->Convert(std::llround(amount * 100.0L),source.GetCurrency(),destination.GetCurrency(),date,credited,err))
+        return false;
+    if(credited <= 0)return fail("Error! amount is too small to convert.");
+
+    const Account::LedgerMark src_mark = source.GetLedgerMark(),dst_mark = destination.GetLedgerMark();
+    source.DeferPublication();
+    destination.DeferPublication();
+    Account* both[] = {&source,&destination};
+    if(!source.TransferOutTo(destination.GetAccountNumber(),amount,date,err) ||
+       !destination.TransferInFrom(source.GetAccountNumber(),static_cast<long double>(credited) / 100.0L,date,err) ||
+       !Account::PublishDeferred(both,2,err)){
+        source.RollbackTo(src_mark);
+        destination.RollbackTo(dst_mark);
+        return false;
+    }
+    return true;
+}
+
+bool Management::TransferMultiLeg(const vector<Management::TransferLeg> &legs, const Date &date, uint64_t *sequence,
+                                  string *err) {
+    auto fail = [&](const char* msg){
+        if(err) *err = msg;
+        return false;
+    };
+    if(sequence) *sequence = Journal::None;
+    if(legs.empty())return fail("Error! transfer has no legs.");
+
+    LegAccounts.clear();
+    Claims.clear();
+    Account* src = nullptr;
+    uint64_t src_key = 0;
+    for(size_t i=0; i<legs.size(); ++i){
+        const auto& leg = legs[i];
+        if(!is_finite_ld(leg.Amount) || leg.Amount <= 0.0L || leg.Amount * 100.0L >= 9.2e18L)
+            return fail("Error! the amount must be finite positive number.");
+        const int64_t cents = std::llround(leg.Amount * 100.0L);
+        if(cents <= 0)return fail("Error! amount is less than a cent.");
+        if(leg.Source == leg.Destination)return fail("Error! AccountNumber is same as Destination.");
+        // Payroll legs share one source; look it up once per run of equal sources.
+        if(!i || leg.Source != legs[i - 1].Source){
+            src = FindAccount(leg.Source);
+            if(!src)return fail("Error! Source Account is not found.");
+            src_key = pack_account_number(leg.Source);
+        }
+        Account* dst = FindAccount(leg.Destination);
+        if(!dst)return fail("Error! Destination Account is not found.");
+        if(dst->is_closed())return fail("Error! Account of Destination is closed.");
+        if(dst->GetCurrency() != src->GetCurrency())return fail("Error! accounts have different currencies.");
+        LegAccounts.emplace_back(src,dst);
+        Claims.push_back(LegClaim{src_key,src,cents,0,1,{}});
+        Claims.push_back(LegClaim{pack_account_number(leg.Destination),dst,0,cents,1,{}});
+    }
+
+    sort(Claims.begin(),Claims.end(),[](const LegClaim& a,const LegClaim& b){ return a.Key < b.Key; });
+    size_t unique = 0;
+    for(size_t i=0; i<Claims.size(); ++i){
+        if(unique && Claims[unique - 1].Acc == Claims[i].Acc){
+            LegClaim& c = Claims[unique - 1];
+            if(__builtin_add_overflow(c.Out,Claims[i].Out,&c.Out) || __builtin_add_overflow(c.In,Claims[i].In,&c.In))
+                return fail("Error! transfer total is out of range.");
+            c.Entries += Claims[i].Entries;
+        }
+        else Claims[unique++] = Claims[i];
+    }
+    Claims.resize(unique);
+
+    for(const LegClaim& c : Claims){
+        if(c.Out > 0 && !c.Acc->CanTransferOut(static_cast<long double>(c.Out) / 100.0L,date,err))return false;
+        if(c.In > 0 && c.Acc->GetBalance() * 100.0L + static_cast<long double>(c.In) >= 9.2e18L)
+            return fail("Error! Destination is overflow!");
+    }
+    ClaimedAccounts.clear();
+    for(LegClaim& c : Claims){
+        c.Mark = c.Acc->GetLedgerMark();
+        c.Acc->ReserveTransactions(c.Entries);
+        // Nothing reaches the journal or the stream until every leg stands.
+        c.Acc->DeferPublication();
+        ClaimedAccounts.push_back(c.Acc);
+    }
+    auto roll_back = [&](){
+        for(auto c = Claims.rbegin(); c != Claims.rend(); ++c) c->Acc->RollbackTo(c->Mark);
+        return false;
+    };
+
+    // The claims were validated as totals in cents, and the legs are booked in cents
+    // without checking each one again, so a validated transfer cannot fail on rounding.
+    for(size_t i=0; i<legs.size(); ++i){
+        if(!LegAccounts[i].first->ApplyTransfer(*LegAccounts[i].second,std::llround(legs[i].Amount * 100.0L),date,err))
+            return roll_back();
+    }
+    std::unique_lock<std::recursive_mutex> hold;
+    if(JournalLog) hold = JournalLog->Hold();
+    const uint64_t first = JournalLog ? JournalLog->Size() : Journal::None;
+    if(!Account::PublishDeferred(ClaimedAccounts.data(),ClaimedAccounts.size(),err))return roll_back();
+    if(sequence) *sequence = first;
+    for(const LegClaim& c : Claims) MarkDirty(*c.Acc);
+
+    // Traced as its legs: replaying them in order reproduces the same state.
+    if(Trace){
+        for(const auto& leg : legs){
+            TraceScope trace(Trace,TraceOp::Kind::Transfer);
+            trace_call(trace,date,leg.Amount,leg.Source,leg.Destination);
+            trace.Succeed();
+        }
+    }
+    if(err) err->clear();
+    return true;
+}
+
+template<class Policy,class OnCredit>
+static bool post_interest_group(const vector<Account*>& group,const Date& date,size_t& credited,string* err,
+                                OnCredit&& on_credit){
+    if constexpr (Policy::AnnualInterest <= 0.0L){
+        return true;
+    }
+    for(Account* acc : group){
+        size_t before = acc->GetTransactions().size();
+        if(!acc->PostInterestAs<Policy>(date,err))return false;
+        if(acc->GetTransactions().size() != before){
+            ++credited;
+            on_credit(*acc);
+        }
+    }
+    return true;
+}
+
+bool Management::ApplyMonthlyInterest(const Date &date, size_t *credited, string *err) {
+    TraceScope trace(Trace,TraceOp::Kind::Interest);
+    trace_call(trace,date,0.0L,string());
+    size_t count = 0;
+    auto dirty = [this](Account& acc){ MarkDirty(acc); };
+    bool ok = post_interest_group<CheckingPolicy>(AccountsByType[account_type_index(CheckingPolicy::Type)],date,count,err,dirty)
+              && post_interest_group<SavingPolicy>(AccountsByType[account_type_index(SavingPolicy::Type)],date,count,err,dirty)
+              && post_interest_group<FixedDepositPolicy>(AccountsByType[account_type_index(FixedDepositPolicy::Type)],date,count,err,dirty);
+    if(credited) *credited = count;
+    if(ok && err) err->clear();
+    if(ok) trace.Succeed();
+    return ok;
+}
+
+bool Management::SetDailyLimits(const string &account_number, long double withdraw, long double transfer,
+                                string *err) {
+    Account* acc = FindAccount(account_number);
+    if(!acc){
+        if(err) *err = "Error! Account is not found.";
+        return false;
+    }
+    return acc->SetDailyLimits(withdraw,transfer,err);
+}
+
+bool Management::TransferOut(const string &source, const string &remote_destination, long double amount,
+                             const Date &date, string *err) {
+    BANK_METRIC_SCOPE(MetricOp::Transfer);
+    if(source.empty() || remote_destination.empty()){
+        if(err) *err = "Error! Account Number is empty.";
+        BANK_METRIC_FAIL(MetricFailure::EmptyInput);
+        return false;
+    }
+    Account* acc = FindAccount(source);
+    if(!acc){
+        if(err) *err = "Error! Source Account is not found.";
+        BANK_METRIC_FAIL(MetricFailure::NotFound);
+        return false;
+    }
+    if(!acc->TransferOutTo(remote_destination,amount,date,err)){
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
+        return false;
+    }
+    MarkDirty(*acc);
+    BANK_METRIC_OK();
+    return true;
+}
+
+bool Management::TransferIn(const string &destination, const string &remote_source, long double amount,
+                            Currency remote_currency, const Date &date, string *err) {
+    BANK_METRIC_SCOPE(MetricOp::Transfer);
+    if(destination.empty() || remote_source.empty()){
+        if(err) *err = "Error! Account Number is empty.";
+        BANK_METRIC_FAIL(MetricFailure::EmptyInput);
+        return false;
+    }
+    Account* acc = FindAccount(destination);
+    if(!acc){
+        if(err) *err = "Error! Destination Account is not found.";
+        BANK_METRIC_FAIL(MetricFailure::NotFound);
+        return false;
+    }
+    if(acc->GetCurrency() != remote_currency){
+        if(err) *err = "Error! accounts have different currencies.";
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
+        return false;
+    }
+    if(!acc->TransferInFrom(remote_source,amount,date,err)){
+        BANK_METRIC_FAIL(MetricFailure::Rejected);
+        return false;
+    }
+    MarkDirty(*acc);
+    BANK_METRIC_OK();
+    return true;
+}
+
+bool Management::SetNumberPartition(uint32_t part, uint32_t parts, string *err) {
+    if(!parts || part >= parts){
+        if(err) *err = "Error! partition must be below the partition count.";
+        return false;
+    }
+    NumberPart = part;
+    NumberParts = parts;
+    if(err) err->clear();
+    return true;
+}
+
+void Management::EnableIdempotency(size_t capacity, uint32_t bucket_seconds, uint32_t buckets) {
+    Dedup = make_unique<DedupCache>(capacity,bucket_seconds,buckets);
+}
+
+DedupCache *Management::GetDedupCache() const {
+    return Dedup.get();
+}
+
+template<class Fn>
+bool Management::RunOnce(uint64_t key, string *err, Fn &&op) {
+    if(key == 0)return op(err);
+    if(!Dedup) EnableIdempotency(1u << 16);
+
+    bool ok = false;
+    if(Dedup->Lookup(key,ok,err))return ok;
+
+    string local;
+    string* e = err ? err : &local;
+    ok = op(e);
+    Dedup->Insert(key,ok,ok ? string() : *e);
+    return ok;
+}
+
+bool Management::OpenAccount(uint64_t key, const Person &person, long double initial_balance,
+                             Account::AccountType type, const Date &date, string *err) {
+    return RunOnce(key,err,[&](string* e){ return OpenAccount(person,initial_balance,type,date,e); });
+}
+
+bool Management::CloseAccount(uint64_t key, const string &owner_id, const string &account_number, const Date &date,
+                              string *err) {
+    return RunOnce(key,err,[&](string* e){ return CloseAccount(owner_id,account_number,date,e); });
+}
+
+bool Management::DepositAccount(uint64_t key, const string &account_number, long double amount, const Date &date,
+                                string *err) {
+    return RunOnce(key,err,[&](string* e){ return DepositAccount(account_number,amount,date,e); });
+}
+
+bool Management::WithdrawFromAccount(uint64_t key, const string &account_number, long double amount,
+                                     const Date &date, string *err) {
+    return RunOnce(key,err,[&](string* e){ return WithdrawFromAccount(account_number,amount,date,e); });
+}
+
+bool Management::TransferBetweenAccounts(uint64_t key, const string &SourceAccNum, const string &DestinationAccNum,
+                                         long double amount, const Date &date, string *err) {
+    return RunOnce(key,err,[&](string* e){
+        return TransferBetweenAccounts(SourceAccNum,DestinationAccNum,amount,date,e);
+    });
+}
+
+bool Management::AddPerson(uint64_t key, const Person &p, string *err) {
+    return RunOnce(key,err,[&](string* e){ return AddPerson(p,e); });
+}
+
+bool Management::ApplyMonthlyInterest(uint64_t key, const Date &date, string *err) {
+    return RunOnce(key,err,[&](string* e){ return ApplyMonthlyInterest(date,nullptr,e); });
+}
+
+Account *Management::FindAccount(const string &account_number) {
+    auto it = AccountIndex.find(account_number);
+    if(it == AccountIndex.end())return nullptr;
+    return it->second.Cold;
+}
+
+const Account *Management::GetAccount(const string &account_number) const {
+    auto it = AccountIndex.find(account_number);
+    if(it == AccountIndex.end())return nullptr;
+    return it->second.Cold;
+}
+
+bool Management::GetBalance(const string &account_number, long double &out, string *err) const {
+    auto it = AccountIndex.find(account_number);
+    if(it == AccountIndex.end()){
+        if(err) *err = "Error! account not found.";
         return false;
     }
+    out = HotRecords.At(it->second.Index).Balance;
+    if(err) err->clear();
+    return true;
+}
+
+const vector<string> *Management::GetAccountsOf(const string &owner_id) const {
+    auto it = AccountsByOwner.find(owner_id);
+    if(it == AccountsByOwner.end())return nullptr;
+    return &it->second;
+}
+
+size_t Management::AccountCount() const {
+    return Accounts.size();
+}
+
+const HotStore &Management::GetHotStore() const {
+    return HotRecords;
+}
+
+// Per-currency cents and account counts of the open accounts in records [begin, end),
+// gathered in chunks of one hot store block at most and summed by the FX kernel.
+static bool sum_balances(const HotStore& records,size_t begin,size_t end,vector<FxTable::Line>& lines,string& err){
+    constexpr size_t Chunk = 2048;
+    static_assert(HotStore::BlockRecords % Chunk == 0,"chunks must not cross hot store blocks");
+    int64_t cents[Chunk];
+    uint8_t slots[Chunk];
+    vector<Currency> currencies;
+    vector<int64_t> sums;
+    vector<size_t> counts;
+    size_t last = 0;
+    for(size_t at=begin; at<end; at+=Chunk){
+        const size_t len = std::min(Chunk,end - at);
+        const Account::HotFields* block = records.Block(at / HotStore::BlockRecords) + at % HotStore::BlockRecords;
+        for(size_t i=0; i<len; ++i){
+            const Account::HotFields& h = block[i];
+            if(h.Closed){
+                slots[i] = UINT8_MAX;    // above every slot in use: skipped by the kernel
+                cents[i] = 0;
+                continue;
+            }
+            // Accounts of one currency tend to come in runs; try the last slot first.
+            if(last >= currencies.size() || currencies[last] != h.CurrencyCode){
+                last = static_cast<size_t>(find(currencies.begin(),currencies.end(),h.CurrencyCode) - currencies.begin());
+                if(last == currencies.size()){
+                    if(currencies.size() == UINT8_MAX){
+                        err = "Error! too many currencies to value in one pass.";
+                        return false;
+                    }
+                    currencies.push_back(h.CurrencyCode);
+                }
+            }
+            const long double c = h.Balance * 100.0L;
+            // Also rejects NaN; llround of anything larger is undefined.
+            if(!(c > -static_cast<long double>(FxTable::MaxBatchCents) && c < static_cast<long double>(FxTable::MaxBatchCents))){
+                err = "Error! balances are out of range for valuation.";
+                return false;
+            }
+            slots[i] = static_cast<uint8_t>(last);
+            cents[i] = std::llround(c);
+        }
+        sums.resize(currencies.size(),0);
+        counts.resize(currencies.size(),0);
+        if(!FxTable::AccumulateBySlot(cents,slots,len,sums.data(),counts.data(),currencies.size())){
+            err = "Error! balances are out of range for valuation.";
+            return false;
+        }
+    }
+    lines.resize(currencies.size());
+    for(size_t k=0; k<lines.size(); ++k) lines[k] = FxTable::Line{currencies[k],sums[k],0,counts[k]};
+    return true;
+}
 
-    Account& acc1 = ItSource->second;
-    Account& acc2 = ItDestination->second;
+bool Management::ValueInBase(const FxTable &table, const Date &date, size_t threads, FxTable::Valuation &out,
+                             string *err) const {
+    // Threads take whole 2048-record chunks.
+    const size_t n = HotRecords.Size(),chunks = (n + 2047) / 2048;
+    if(threads == 0) threads = 1;
+    threads = min(threads,max<size_t>(1,chunks));
+    vector<vector<FxTable::Line>> parts(threads);
+    vector<char> done(threads,0);
+    vector<string> errors(threads);
+    auto run = [&](size_t t){
+        const size_t begin = min(n,chunks * t / threads * 2048),end = min(n,chunks * (t + 1) / threads * 2048);
+        done[t] = sum_balances(HotRecords,begin,end,parts[t],errors[t]);
+    };
+    vector<thread> workers;
+    for(size_t t=1; t<threads; ++t) workers.emplace_back(run,t);
+    run(0);
+    for(auto& w : workers) w.join();
+
+    vector<FxTable::Line> lines;
+    for(size_t t=0; t<threads; ++t){
+        if(!done[t]){
+            if(err) *err = errors[t];
+            return false;
+        }
+        for(const auto& part : parts[t]){
+            auto it = find_if(lines.begin(),lines.end(),[&](const FxTable::Line& l){ return l.Code == part.Code; });
+            if(it == lines.end()) lines.push_back(part);
+            else{
+                if(__builtin_add_overflow(it->Cents,part.Cents,&it->Cents)){
+                    if(err) *err = "Error! balances are out of range for valuation.";
+                    return false;
+                }
+                it->Accounts += part.Accounts;
+            }
+        }
+    }
+    return table.ValueLines(std::move(lines),pack_date(date),out,err);
+}
+
+const MemberStore &Management::GetMembers() const {
+    return *Members;
+}
 
-    if(!acc1.Transfer(acc2,amount,date,err))return false;
+bool Management::FindAccountsByPrefix(const string &prefix, size_t limit, vector<string> &out, string *err) const {
+    return AccountNumbers.Find(prefix,limit,out,err);
+}
 
+bool Management::FindMembersByPrefix(const string &prefix, size_t limit, vector<string> &out, string *err) const {
+    return IdCodes.Find(prefix,limit,out,err);
+}
+
+void Management::AttachStream(TransactionStream *stream) {
+    Stream = stream;
+    for(auto& acc : Accounts) acc.AttachStream(stream);
+}
+
+void Management::MarkDirty(Account &acc) {
+    if(acc.MarkDirty()) DirtyAccounts.push_back(&acc);
+}
+
+void Management::CaptureCheckpoint(CheckpointCut &cut) {
+    // clear() keeps the capacity of buffers reused from an earlier cut.
+    cut.Accounts.clear();
+    cut.Entries.clear();
+    size_t entries = 0;
+    for(const Account* acc : DirtyAccounts)
+        entries += acc->GetArchivedCount() + acc->GetTransactions().size() - acc->GetCheckpointWatermark();
+    cut.Accounts.reserve(DirtyAccounts.size());
+    cut.Entries.reserve(entries);
+
+    for(Account* acc : DirtyAccounts){
+        const auto& ledger = acc->GetTransactions();
+        const Person* owner = acc->GetOwner();
+        CheckpointCut::AccountImage img;
+        img.Number = acc->GetAccountNumber();
+        img.Owner = owner ? owner->GetIdCode() : string();
+        img.Balance = acc->GetBalance();
+        img.Type = acc->GetAccountType();
+        img.CurrencyCode = acc->GetCurrency();
+        img.Closed = acc->is_closed();
+        img.OpeningsDate = acc->GetOpeningsDate();
+        img.FirstEntry = acc->GetCheckpointWatermark();
+        img.EntryBegin = cut.Entries.size();
+        const uint64_t archived = acc->GetArchivedCount();
+        // Entries archived before a checkpoint saw them are read back from the archive.
+        if(img.FirstEntry < archived && Archive){
+            uint64_t index = 0;
+            Archive->ForEach(img.Number,[&](const PackedTransaction& p){
+                if(index++ >= img.FirstEntry) cut.Entries.push_back(p);
+            });
+        }
+        for(size_t i=max<uint64_t>(img.FirstEntry,archived) - archived; i<ledger.size(); ++i)
+            cut.Entries.push_back(PackedTransaction::Pack(ledger[i]));
+        img.EntryEnd = cut.Entries.size();
+        cut.Accounts.push_back(std::move(img));
+        acc->MarkCheckpointed();
+    }
+    DirtyAccounts.clear();
+    cut.JournalSequence = JournalLog ? JournalLog->Size() : 0;
+}
+
+void Management::AttachJournal(Journal *journal) {
+    JournalLog = journal;
+    for(auto& acc : Accounts) acc.AttachJournal(journal);
+}
+
+void Management::AttachFxTable(const FxTable *table) {
+    Fx = table;
+}
+
+void Management::AttachTrace(TraceRecorder *trace) {
+    Trace = trace;
+}
+
+bool Management::FinishTrace(string *err) {
+    if(!Trace){
+        if(err) *err = "Error! no trace is attached.";
+        return false;
+    }
+    vector<const Account*> accounts;
+    accounts.reserve(Accounts.size());
+    for(const auto& acc : Accounts) accounts.push_back(&acc);
+    sort(accounts.begin(),accounts.end(),[](const Account* a,const Account* b){
+        return a->GetAccountNumber() < b->GetAccountNumber();
+    });
+    for(const Account* acc : accounts){
+        TraceOp op;
+        op.Op = TraceOp::Kind::Balance;
+        op.Ok = !acc->is_closed();
+        op.Type = acc->GetAccountType();
+        op.Amount = acc->GetBalance();
+        op.AccountNumber = pack_account_number(acc->GetAccountNumber());
+        Trace->Record(op);
+    }
+    TraceRecorder* trace = Trace;
+    Trace = nullptr;
+    return trace->Close(err);
+}
+
+bool Management::EnableArchive(const string &path, string *err) {
+    auto archive = make_unique<LedgerArchive>();
+    if(!archive->Open(path,err))return false;
+    Archive = std::move(archive);
+    return true;
+}
+
+const LedgerArchive *Management::GetArchive() const {
+    return Archive.get();
+}
+
+bool Management::ArchiveLedgers(const Date &today, uint32_t max_age_days, Management::ArchiveStats *stats,
+                                string *err) {
+    if(!Archive){
+        if(err) *err = "Error! archive is not enabled.";
+        return false;
+    }
+    const int32_t cutoff = date_to_days(today) - static_cast<int32_t>(max_age_days);
+
+    vector<pair<Account*,size_t>> moved;
+    for(auto& acc : Accounts){
+        const auto& ledger = acc.GetTransactions();
+        size_t n = 0;
+        if(acc.is_closed()) n = ledger.size();
+        else while(n < ledger.size() && date_to_days(ledger[n].trans) < cutoff) ++n;
+        if(!n)continue;
+        Archive->Stage(acc.GetAccountNumber(),acc.GetArchivedCount(),ledger.data(),n);
+        moved.emplace_back(&acc,n);
+    }
+
+    const uint64_t bytes = Archive->FileBytes();
+    if(!Archive->Commit(err))return false;
+
+    ArchiveStats st;
+    for(auto& [acc,n] : moved){
+        st.ClosedAccounts += acc->is_closed();
+        st.Entries += n;
+        acc->ReleaseLedgerPrefix(n);
+    }
+    st.Accounts = moved.size();
+    st.Bytes = Archive->FileBytes() - bytes;
+    if(stats) *stats = st;
     if(err) err->clear();
     return true;
+}
 
+bool Management::BuildTransferGraph(const Date &from, const Date &to, size_t threads, TransferGraph &out,
+                                    string *err) const {
+    vector<const Account*> accounts;
+    accounts.reserve(Accounts.size());
+    for(const auto& acc : Accounts) accounts.push_back(&acc);
+    return out.Build(accounts,from,to,threads,Archive.get(),err);
+}
 
+bool Management::BuildTransferGraph(const Date &from, const Date &to, Currency currency, size_t threads,
+                                    TransferGraph &out, string *err) const {
+    vector<const Account*> accounts;
+    for(const auto& acc : Accounts) if(acc.GetCurrency() == currency) accounts.push_back(&acc);
+    return out.Build(accounts,from,to,threads,Archive.get(),err);
+}
 
+bool Management::Summarize(const string &account_number, const LedgerQuery &q, LedgerQuery::Summary &out,
+                           string *err) const {
+    out = LedgerQuery::Summary{};
+    return Query(account_number,q,[&](const Account::Transaction& t){ out.Add(t.amount,t.currency); },err);
 }
 
+bool Management::SummarizeAll(const LedgerQuery &q, size_t threads, LedgerQuery::Summary &out, string *err) const {
+    if(threads == 0) threads = 1;
+    threads = min(threads,max<size_t>(1,Accounts.size()));
+    vector<LedgerQuery::Summary> parts(threads);
+    auto run = [&](size_t t){
+        LedgerQuery::Summary& s = parts[t];
+        auto add = [&s](const Account::Transaction& tx){ s.Add(tx.amount,tx.currency); };
+        const size_t begin = Accounts.size() * t / threads,end = Accounts.size() * (t + 1) / threads;
+        for(size_t i=begin; i<end; ++i) QueryAccount(Accounts[i],q,add);
+    };
+    vector<thread> workers;
+    for(size_t t=1; t<threads; ++t) workers.emplace_back(run,t);
+    run(0);
+    for(auto& w : workers) w.join();
+
+    out = LedgerQuery::Summary{};
+    for(const auto& s : parts) out.Merge(s);
+    if(out.Mixed){
+        if(err) *err = "Error! matches are in more than one currency; narrow the query with InCurrency.";
+        return false;
+    }
+    if(err) err->clear();
+    return true;
+}
 
+bool Management::OwnerFlow(const TransferGraph &graph, const string &owner, TransferGraph::Flow &out,
+                           string *err) const {
+    string id = trim_copy(owner);
+    auto it = AccountsByOwner.find(id);
+    if(it == AccountsByOwner.end()){
+        if(err) *err = "Error! owner not found.";
+        return false;
+    }
+    out = graph.GroupFlow(it->second);
+    if(err) err->clear();
+    return true;
+}
 
+bool Management::ExportStatements(int fd, StatementWriter::Format format, size_t threads, string *err) const {
+    vector<const Account*> accounts;
+    accounts.reserve(Accounts.size());
+    for(const auto& acc : Accounts) accounts.push_back(&acc);
+    sort(accounts.begin(),accounts.end(),[](const Account* a,const Account* b){
+        return a->GetAccountNumber() < b->GetAccountNumber();
+    });
+
+    if(threads == 0) threads = 1;
+    threads = min(threads,max<size_t>(1,accounts.size()));
+    constexpr size_t chunk = 4096;
+
+    const StatementWriter writer(format);
+    vector<StatementBuffer> buffers(threads + 1);
+    writer.FormatHeader(buffers[0]);
+
+    auto format_slice = [&](size_t base,size_t t){
+        size_t begin = base + t * chunk;
+        size_t end = min(begin + chunk,accounts.size());
+        for(size_t i=begin; i<end; ++i) writer.FormatAccount(*accounts[i],buffers[t + 1],Archive.get());
+    };
+
+    size_t base = 0;
+    do{
+        vector<thread> workers;
+        for(size_t t=1; t<threads && base + t * chunk < accounts.size(); ++t)
+            workers.emplace_back(format_slice,base,t);
+        format_slice(base,0);
+        for(auto& w : workers) w.join();
+
+        if(!StatementWriter::WriteBuffers(fd,buffers,err))return false;
+        for(auto& b : buffers) b.Clear();
+        base += chunk * threads;
+    } while (base < accounts.size());
+
+    if(err) err->clear();
+    return true;
+}
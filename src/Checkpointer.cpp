@@ -0,0 +1,303 @@
+#include "Checkpointer.h"
+#include "Bank Management.h"
+#include "Journal.h"
+#include "StatementWriter.h"
+#include <charconv>
+#include <chrono>
+#include <cstdlib>
+#include <fcntl.h>
+#include <fstream>
+#include <unordered_map>
+#include <unistd.h>
+
+
+
+static uint64_t now_ns(){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+Checkpointer::Checkpointer(string path, Journal *journal) : Path(std::move(path)),JournalLog(journal) {}
+
+Checkpointer::~Checkpointer() {
+    // The journal may already be gone; truncation is left to Wait() and Checkpoint().
+    if(Writer.joinable()) Writer.join();
+}
+
+bool Checkpointer::Busy() const {
+    return Writing.load(std::memory_order_acquire);
+}
+
+bool Checkpointer::Wait(string *err) {
+    if(Writer.joinable()) Writer.join();
+    TruncateJournal();
+    if(err) *err = WriteOk ? string() : WriteError;
+    return WriteOk;
+}
+
+bool Checkpointer::Checkpoint(Management &bank, string *err) {
+    if(Busy()){
+        if(err) *err = "Error! previous checkpoint is still being written.";
+        return false;
+    }
+    Wait();
+
+    const uint64_t t0 = now_ns();
+    CheckpointCut cut = std::move(Spare);
+    bank.CaptureCheckpoint(cut);
+    const uint64_t pause = now_ns() - t0;
+
+    {
+        std::lock_guard<std::mutex> g(StatsLock);
+        cut.Number = ++Totals.Checkpoints;
+        Totals.Accounts += cut.Accounts.size();
+        Totals.Entries += cut.Entries.size();
+        Totals.LastPauseNs = pause;
+        Totals.TotalPauseNs += pause;
+        if(pause > Totals.MaxPauseNs) Totals.MaxPauseNs = pause;
+    }
+    vector<CheckpointCut> cuts;
+    cuts.swap(Retry);
+    cuts.push_back(std::move(cut));
+    Writing.store(true,std::memory_order_release);
+    Writer = std::thread(&Checkpointer::Write,this,std::move(cuts));
+    if(err) err->clear();
+    return true;
+}
+
+void Checkpointer::Write(vector<CheckpointCut> cuts) {
+    const uint64_t t0 = now_ns();
+    vector<StatementBuffer> out(1);
+    StatementBuffer& b = out[0];
+    Account::Transaction t;
+    for(const auto& cut : cuts){
+        b.Append("Checkpoint:");
+        b.AppendUnsigned(cut.Number);
+        b.Append("|Journal:");
+        b.AppendUnsigned(cut.JournalSequence);
+        b.Append("|Accounts:");
+        b.AppendUnsigned(cut.Accounts.size());
+        b.Append("|Transactions:");
+        b.AppendUnsigned(cut.Entries.size());
+        b.Append('\n');
+        for(const auto& a : cut.Accounts){
+            b.Append("Account:");
+            b.Append(a.Number);
+            b.Append("|Owner:");
+            b.Append(a.Owner);
+            b.Append("|Balance:");
+            b.AppendMoney(a.Balance);
+            b.Append("|AccountType:");
+            b.Append(Account::AccountTypeToString(a.Type));
+            b.Append("|Currency:");
+            char currency[3];
+            currency_to_chars(a.CurrencyCode,currency);
+            b.Append(currency,3);
+            b.Append("|Status:");
+            b.Append(a.Closed ? "Closed" : "Open");
+            b.Append("|OpeningsDate:");
+            b.AppendDate(a.OpeningsDate,'/');
+            b.Append("|From:");
+            b.AppendUnsigned(a.FirstEntry);
+            b.Append("|Transactions:");
+            b.AppendUnsigned(a.EntryEnd - a.EntryBegin);
+            b.Append('\n');
+            for(size_t i=a.EntryBegin; i<a.EntryEnd; ++i){
+                cut.Entries[i].UnpackInto(t);
+                b.AppendDate(t.trans,'/');
+                b.Append('|');
+                b.AppendMoney(t.amount);
+                b.Append('|');
+                b.Append(t.source);
+                b.Append('|');
+                b.Append(t.destination);
+                b.Append('|');
+                b.Append(Account::TransactionTypeToString(t.type));
+                b.Append('|');
+                b.AppendMoney(t.balance_after);
+                b.Append('\n');
+            }
+        }
+    }
+
+    string error;
+    bool ok = false;
+    int fd = ::open(Path.c_str(),O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC,0644);
+    if(fd < 0){
+        error = "Error! cannot open checkpoint file " + Path + ".";
+    }
+    else{
+        ok = StatementWriter::WriteBuffers(fd,out,&error);
+        if(ok && ::fsync(fd) != 0){
+            ok = false;
+            error = "Error! cannot sync checkpoint file " + Path + ".";
+        }
+        ::close(fd);
+    }
+    {
+        std::lock_guard<std::mutex> g(StatsLock);
+        Totals.Bytes += ok ? b.Size() : 0;
+        Totals.LastWriteNs = now_ns() - t0;
+        Totals.TotalWriteNs += Totals.LastWriteNs;
+    }
+    // The journal prefix is only redundant once the checkpoint is durable.
+    if(ok) Durable = cuts.back().JournalSequence;
+    if(!ok) Retry = std::move(cuts);
+    else Spare = std::move(cuts.back());
+    WriteOk = ok;
+    WriteError = error;
+    Writing.store(false,std::memory_order_release);
+}
+
+void Checkpointer::TruncateJournal() {
+    if(!JournalLog || Durable <= JournalLog->FirstRetained())return;
+    JournalLog->Truncate(Durable);
+    std::lock_guard<std::mutex> g(StatsLock);
+    Totals.JournalTruncatedTo = Durable;
+}
+
+Checkpointer::Stats Checkpointer::GetStats() const {
+    std::lock_guard<std::mutex> g(StatsLock);
+    return Totals;
+}
+
+// Splits off the next '|'-separated field of line; false past the end.
+static bool next_field(const string& line,size_t& at,string& out){
+    if(at > line.size())return false;
+    size_t end = line.find('|',at);
+    if(end == string::npos) end = line.size();
+    out.assign(line,at,end - at);
+    at = end + 1;
+    return true;
+}
+
+// Reads "key:value" into value.
+static bool keyed_field(const string& line,size_t& at,const char* key,string& value){
+    if(!next_field(line,at,value))return false;
+    const size_t n = std::char_traits<char>::length(key);
+    if(value.compare(0,n,key) != 0 || value.size() <= n || value[n] != ':')return false;
+    value.erase(0,n + 1);
+    return true;
+}
+
+static bool parse_unsigned(const string& s,uint64_t& out){
+    const auto res = std::from_chars(s.data(),s.data() + s.size(),out);
+    return res.ec == std::errc() && res.ptr == s.data() + s.size();
+}
+
+static bool parse_money(const string& s,long double& out){
+    if(s.empty())return false;
+    char* end = nullptr;
+    out = std::strtold(s.c_str(),&end);
+    return end == s.c_str() + s.size();
+}
+
+static bool parse_date(const string& s,Account::Date& out){
+    const size_t a = s.find('/'),b = a == string::npos ? a : s.find('/',a + 1);
+    if(b == string::npos)return false;
+    out.day = s.substr(0,a);
+    out.month = s.substr(a + 1,b - a - 1);
+    out.year = s.substr(b + 1);
+    return true;
+}
+
+static bool parse_account_type(const string& s,Account::AccountType& out){
+    for(auto t : {Account::AccountType::CheckingAccount,Account::AccountType::SavingAccount,
+                  Account::AccountType::FixedDepositAccount}){
+        if(s == Account::AccountTypeToString(t)){
+            out = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool parse_transaction_type(const string& s,Account::TransactionTypes& out){
+    using Type = Account::TransactionTypes;
+    for(auto t : {Type::Deposit,Type::Withdraw,Type::TransferIn,Type::TransferOut,Type::Open,Type::Close}){
+        if(s == Account::TransactionTypeToString(t)){
+            out = t;
+            return true;
+        }
+    }
+    return false;
+}
+
+bool Checkpointer::Load(const string &path, CheckpointState &out, string *err) {
+    std::ifstream in(path,std::ios::binary);
+    if(!in){
+        if(err) *err = "Error! cannot open checkpoint file " + path + ".";
+        return false;
+    }
+    CheckpointState state;
+    unordered_map<string,size_t> index;
+    string line,field,status;
+    uint64_t line_no = 0,accounts = 0,entries = 0;
+    auto fail = [&](){
+        if(err) *err = "Error! checkpoint file " + path + " is malformed at line " + std::to_string(line_no) + ".";
+        return false;
+    };
+    auto next_line = [&](){
+        ++line_no;
+        return static_cast<bool>(std::getline(in,line));
+    };
+
+    while(next_line()){
+        size_t at = 0;
+        uint64_t number = 0,sequence = 0;
+        if(!keyed_field(line,at,"Checkpoint",field) || !parse_unsigned(field,number) ||
+           !keyed_field(line,at,"Journal",field) || !parse_unsigned(field,sequence) ||
+           !keyed_field(line,at,"Accounts",field) || !parse_unsigned(field,accounts) ||
+           !keyed_field(line,at,"Transactions",field) || !parse_unsigned(field,entries))
+            return fail();
+        for(uint64_t a=0; a<accounts; ++a){
+            if(!next_line())return fail();
+            CheckpointState::AccountState img;
+            uint64_t from = 0,count = 0;
+            at = 0;
+            if(!keyed_field(line,at,"Account",img.Number) || !keyed_field(line,at,"Owner",field))return fail();
+            img.Owner = field;
+            if(!keyed_field(line,at,"Balance",field) || !parse_money(field,img.Balance) ||
+               !keyed_field(line,at,"AccountType",field) || !parse_account_type(field,img.Type) ||
+               !keyed_field(line,at,"Currency",field) || !parse_currency(field,img.CurrencyCode) ||
+               !keyed_field(line,at,"Status",status) || (status != "Open" && status != "Closed") ||
+               !keyed_field(line,at,"OpeningsDate",field) || !parse_date(field,img.OpeningsDate) ||
+               !keyed_field(line,at,"From",field) || !parse_unsigned(field,from) ||
+               !keyed_field(line,at,"Transactions",field) || !parse_unsigned(field,count) || count > entries)
+                return fail();
+            img.Closed = status == "Closed";
+            entries -= count;
+
+            auto found = index.find(img.Number);
+            if(found == index.end()){
+                found = index.emplace(img.Number,state.Accounts.size()).first;
+                state.Accounts.emplace_back();
+            }
+            CheckpointState::AccountState& acc = state.Accounts[found->second];
+            // Each cut carries the ledger suffix from the previous cut's end on.
+            if(from != acc.Entries.size())return fail();
+            img.Entries = std::move(acc.Entries);
+            acc = std::move(img);
+
+            for(uint64_t i=0; i<count; ++i){
+                if(!next_line())return fail();
+                Account::Transaction t;
+                at = 0;
+                if(!next_field(line,at,field) || !parse_date(field,t.trans) ||
+                   !next_field(line,at,field) || !parse_money(field,t.amount) ||
+                   !next_field(line,at,t.source) || !next_field(line,at,t.destination) ||
+                   !next_field(line,at,field) || !parse_transaction_type(field,t.type) ||
+                   !next_field(line,at,field) || !parse_money(field,t.balance_after))
+                    return fail();
+                t.currency = acc.CurrencyCode;
+                acc.Entries.push_back(std::move(t));
+            }
+        }
+        if(entries != 0)return fail();
+        ++state.Checkpoints;
+        state.JournalSequence = sequence;
+    }
+    out = std::move(state);
+    if(err) err->clear();
+    return true;
+}
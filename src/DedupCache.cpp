@@ -0,0 +1,158 @@
+#include "DedupCache.h"
+#include <algorithm>
+#include <thread>
+#include <time.h>
+
+
+
+static inline uint64_t mix64(uint64_t x){
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+namespace {
+
+class ShardGuard{
+public:
+    explicit ShardGuard(atomic_flag& f) : Flag(f){
+        while(Flag.test_and_set(memory_order_acquire)) this_thread::yield();
+    }
+    ~ShardGuard(){ Flag.clear(memory_order_release); }
+private:
+    atomic_flag& Flag;
+};
+
+}
+
+DedupCache::DedupCache(size_t capacity, uint32_t bucket_seconds, uint32_t buckets)
+        : BucketSeconds(max<uint32_t>(1,bucket_seconds)),Buckets(max<uint32_t>(1,buckets)) {
+    size_t sets = 1;
+    while(sets * Ways * Shards < capacity) sets <<= 1;
+    SetsPerShard = sets;
+    Sets.reset(new Set[SetsPerShard * Shards]);
+    ShardState.reset(new Shard[Shards]);
+    Messages.emplace_back();
+    MessageIds.emplace(string(),0);
+}
+
+uint16_t DedupCache::Intern(const string &msg) {
+    if(msg.empty())return 0;
+    lock_guard<mutex> g(MessagesLock);
+    auto it = MessageIds.find(msg);
+    if(it != MessageIds.end())return it->second;
+    if(Messages.size() > UINT16_MAX)return 0;
+    auto id = static_cast<uint16_t>(Messages.size());
+    Messages.push_back(msg);
+    MessageIds.emplace(msg,id);
+    return id;
+}
+
+uint32_t DedupCache::CurrentEpoch() const {
+    uint64_t now = FixedNow;
+    if(now == 0){
+        // Bucket granularity is seconds, so the coarse clock (no TSC read) is enough.
+        timespec ts{};
+        clock_gettime(CLOCK_MONOTONIC_COARSE,&ts);
+        now = static_cast<uint64_t>(ts.tv_sec);
+    }
+    // +1 keeps epoch 0 for entries that were never written.
+    return static_cast<uint32_t>(now / BucketSeconds) + 1;
+}
+
+DedupCache::Shard &DedupCache::ShardFor(uint64_t hash) {
+    return ShardState[hash >> 58];
+}
+
+DedupCache::Set &DedupCache::SetFor(uint64_t hash) {
+    size_t shard = hash >> 58;
+    size_t set = hash & (SetsPerShard - 1);
+    return Sets[shard * SetsPerShard + set];
+}
+
+bool DedupCache::Live(const Entry &e, uint32_t epoch) const {
+    return e.Epoch != 0 && epoch - e.Epoch < Buckets;
+}
+
+bool DedupCache::Lookup(uint64_t key, bool &ok, string *err) {
+    const uint64_t h = mix64(key);
+    const uint32_t epoch = CurrentEpoch();
+    Shard& shard = ShardFor(h);
+    Set& set = SetFor(h);
+
+    uint16_t error_id = 0;
+    {
+        ShardGuard g(shard.Lock);
+        const Entry* hit = nullptr;
+        for(const Entry& e : set.Way){
+            if(e.Key == key && Live(e,epoch)){
+                hit = &e;
+                break;
+            }
+        }
+        if(!hit){
+            ++shard.Misses;
+            return false;
+        }
+        ok = hit->Ok;
+        error_id = hit->ErrorId;
+        ++shard.Hits;
+    }
+    if(err){
+        if(error_id == 0){
+            err->clear();
+        }
+        else{
+            lock_guard<mutex> g(MessagesLock);
+            *err = Messages[error_id];
+        }
+    }
+    return true;
+}
+
+void DedupCache::Insert(uint64_t key, bool ok, const string &err) {
+    const uint64_t h = mix64(key);
+    const uint32_t epoch = CurrentEpoch();
+    Shard& shard = ShardFor(h);
+    Set& set = SetFor(h);
+    const uint16_t error_id = Intern(err);
+
+    ShardGuard g(shard.Lock);
+    Entry* victim = &set.Way[0];
+    for(Entry& e : set.Way){
+        if(e.Key == key || !Live(e,epoch)){
+            victim = &e;
+            break;
+        }
+        if(e.Epoch < victim->Epoch) victim = &e;
+    }
+    if(victim->Key != key && Live(*victim,epoch)) ++shard.Evictions;
+
+    victim->Key = key;
+    victim->Epoch = epoch;
+    victim->Ok = ok;
+    victim->ErrorId = error_id;
+    ++shard.Inserts;
+}
+
+size_t DedupCache::Capacity() const {
+    return SetsPerShard * Shards * Ways;
+}
+
+DedupCache::Stats DedupCache::GetStats() const {
+    Stats s;
+    for(size_t i=0; i<Shards; ++i){
+        Shard& shard = ShardState[i];
+        ShardGuard g(shard.Lock);
+        s.Hits += shard.Hits;
+        s.Misses += shard.Misses;
+        s.Inserts += shard.Inserts;
+        s.Evictions += shard.Evictions;
+    }
+    return s;
+}
+
+void DedupCache::SetNow(uint64_t seconds) {
+    FixedNow = seconds;
+}
@@ -0,0 +1,167 @@
+#include "FxTable.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+
+// num / den rounded half away from zero; den > 0.
+static __int128 div_round(__int128 num,__int128 den){
+    __int128 q = num / den;
+    const __int128 r = num % den;
+    if((r < 0 ? -r : r) * 2 >= den) q += num < 0 ? -1 : 1;
+    return q;
+}
+
+static bool fits_int64(__int128 v){
+    return v >= std::numeric_limits<int64_t>::min() && v <= std::numeric_limits<int64_t>::max();
+}
+
+FxTable::FxTable(Currency base) : Base(base) {}
+
+Currency FxTable::GetBase() const {
+    return Base;
+}
+
+bool FxTable::SetRate(Currency c, const Account::Date &effective, long double rate, string *err) {
+    auto fail = [&](const char* msg){
+        if(err) *err = msg;
+        return false;
+    };
+    if(!is_currency(c))return fail("Error! currency must be a 3-letter code (e.g. EUR).");
+    if(c == Base)return fail("Error! the base currency's rate is fixed at 1.");
+    if(!is_finite_ld(rate) || rate <= 0.0L)return fail("Error! rate must be finite positive.");
+    const long double scaled = std::round(rate * static_cast<long double>(RateScale));
+    if(scaled < 1.0L || scaled > static_cast<long double>(std::numeric_limits<int64_t>::max() / 1024))
+        return fail("Error! rate is out of range.");
+
+    const uint32_t day = pack_date(effective);
+    const int m = static_cast<int>(day / 100 % 100),d = static_cast<int>(day % 100);
+    if(m < 1 || m > 12 || d < 1 || d > days_in_month(m,static_cast<int>(day / 10000)))
+        return fail("Error! effective date is not a valid date.");
+
+    auto& history = Rates[c];
+    auto it = lower_bound(history.begin(),history.end(),day,
+                          [](const pair<uint32_t,int64_t>& r,uint32_t v){ return r.first < v; });
+    if(it != history.end() && it->first == day) it->second = static_cast<int64_t>(scaled);
+    else history.insert(it,{day,static_cast<int64_t>(scaled)});
+    if(err) err->clear();
+    return true;
+}
+
+bool FxTable::RateOn(Currency c, uint32_t date, int64_t &out, string *err) const {
+    if(c == Base){
+        out = RateScale;
+        if(err) err->clear();
+        return true;
+    }
+    auto found = Rates.find(c);
+    if(found != Rates.end()){
+        const auto& history = found->second;
+        auto it = upper_bound(history.begin(),history.end(),date,
+                              [](uint32_t v,const pair<uint32_t,int64_t>& r){ return v < r.first; });
+        if(it != history.begin()){
+            out = prev(it)->second;
+            if(err) err->clear();
+            return true;
+        }
+    }
+    if(err) *err = "Error! no " + currency_code(c) + " rate in force on that date.";
+    return false;
+}
+
+bool FxTable::Convert(int64_t cents, Currency from, Currency to, const Account::Date &date, int64_t &out,
+                      string *err) const {
+    if(from == to){
+        out = cents;
+        if(err) err->clear();
+        return true;
+    }
+    const uint32_t day = pack_date(date);
+    int64_t rate_from = 0,rate_to = 0;
+    if(!RateOn(from,day,rate_from,err) || !RateOn(to,day,rate_to,err))return false;
+    const __int128 v = div_round(static_cast<__int128>(cents) * rate_from,rate_to);
+    if(!fits_int64(v)){
+        if(err) *err = "Error! converted amount is out of range.";
+        return false;
+    }
+    out = static_cast<int64_t>(v);
+    if(err) err->clear();
+    return true;
+}
+
+bool FxTable::AccumulateBySlot(const int64_t *cents, const uint8_t *slots, size_t n, int64_t *sums,
+                               size_t *counts, size_t slot_count) {
+    // 2048 balances and their slots are 18 KB: each block stays in L1 for all passes.
+    constexpr size_t Block = 2048;
+    static_assert(Block * static_cast<uint64_t>(MaxBatchCents - 1) <= static_cast<uint64_t>(INT64_MAX),
+                  "a block of in-range balances must not overflow");
+    for(size_t at=0; at<n; at+=Block){
+        const size_t len = std::min(Block,n - at);
+        const int64_t* c = cents + at;
+        const uint8_t* s = slots + at;
+        // Range check as one more branch-free pass; after it no add within the block can overflow.
+        uint64_t out_of_range = 0;
+        for(size_t i=0; i<len; ++i)
+            out_of_range |= static_cast<uint64_t>(c[i] + (MaxBatchCents - 1)) > static_cast<uint64_t>(2 * (MaxBatchCents - 1));
+        if(out_of_range)return false;
+        for(size_t k=0; k<slot_count; ++k){
+            const uint8_t key = static_cast<uint8_t>(k);
+            int64_t acc = 0;
+            size_t hits = 0;
+            for(size_t i=0; i<len; ++i){
+                // All ones for this slot, else zero: a mask, not a branch or a select.
+                const int64_t mine = -static_cast<int64_t>(s[i] == key);
+                acc += c[i] & mine;
+                hits -= static_cast<size_t>(mine);
+            }
+            if(__builtin_add_overflow(sums[k],acc,&sums[k]))return false;
+            counts[k] += hits;
+        }
+    }
+    return true;
+}
+
+bool FxTable::ValueBatch(const int64_t *cents, const uint8_t *slots, size_t n, const vector<Currency> &currencies,
+                         const Account::Date &date, Valuation &out, string *err) const {
+    if(currencies.empty() || currencies.size() > 256){
+        if(err) *err = "Error! a batch needs 1 to 256 currencies.";
+        return false;
+    }
+    vector<int64_t> sums(currencies.size(),0);
+    vector<size_t> counts(currencies.size(),0);
+    if(!AccumulateBySlot(cents,slots,n,sums.data(),counts.data(),sums.size())){
+        if(err) *err = "Error! balances are out of range for valuation.";
+        return false;
+    }
+    vector<Line> lines(currencies.size());
+    for(size_t k=0; k<lines.size(); ++k) lines[k] = Line{currencies[k],sums[k],0,counts[k]};
+    return ValueLines(std::move(lines),pack_date(date),out,err);
+}
+
+bool FxTable::ValueLines(vector<Line> lines, uint32_t date, Valuation &out, string *err) const {
+    Valuation v;
+    v.Base = Base;
+    __int128 total = 0;
+    for(auto& line : lines){
+        int64_t rate = 0;
+        if(!RateOn(line.Code,date,rate,err))return false;
+        const __int128 base = div_round(static_cast<__int128>(line.Cents) * rate,RateScale);
+        if(!fits_int64(base)){
+            if(err) *err = "Error! converted amount is out of range.";
+            return false;
+        }
+        line.BaseCents = static_cast<int64_t>(base);
+        total += base;
+        v.Accounts += line.Accounts;
+    }
+    if(!fits_int64(total)){
+        if(err) *err = "Error! converted amount is out of range.";
+        return false;
+    }
+    v.TotalCents = static_cast<int64_t>(total);
+    v.Lines = std::move(lines);
+    out = std::move(v);
+    if(err) err->clear();
+    return true;
+}
@@ -0,0 +1,32 @@
+#include "HotStore.h"
+
+
+
+Account::HotFields *HotStore::Allocate() {
+    if(Used == Blocks.size() * BlockRecords){
+        Blocks.push_back(make_unique<Account::HotFields[]>(BlockRecords));
+    }
+    Account::HotFields* slot = &Blocks.back()[Used % BlockRecords];
+    ++Used;
+    return slot;
+}
+
+const Account::HotFields &HotStore::At(size_t i) const {
+    return Blocks[i / BlockRecords][i % BlockRecords];
+}
+
+size_t HotStore::Size() const {
+    return Used;
+}
+
+size_t HotStore::BlockCount() const {
+    return Blocks.size();
+}
+
+const Account::HotFields *HotStore::Block(size_t b) const {
+    return Blocks[b].get();
+}
+
+size_t HotStore::Bytes() const {
+    return Blocks.size() * BlockRecords * sizeof(Account::HotFields);
+}
@@ -0,0 +1,98 @@
+#include "Journal.h"
+#include "Utils.h"
+
+
+
+Journal::Journal(std::size_t max_records)
+        : MaxBlocks((max_records + BlockRecords - 1) / BlockRecords),
+          Blocks(new std::atomic<Block*>[MaxBlocks]),Summaries(new Summary[MaxBlocks]) {
+    for(std::size_t b=0; b<MaxBlocks; ++b) Blocks[b].store(nullptr,std::memory_order_relaxed);
+}
+
+Journal::~Journal() {
+    for(std::size_t b=0; b<MaxBlocks; ++b) delete Blocks[b].load(std::memory_order_relaxed);
+}
+
+uint64_t Journal::Append(const Journal::Record &r) {
+    std::lock_guard<std::recursive_mutex> g(AppendLock);
+    const uint64_t seq = Published.load(std::memory_order_relaxed);
+    const std::size_t b = seq / BlockRecords;
+    if(b >= MaxBlocks)return None;
+
+    Block* block = Blocks[b].load(std::memory_order_relaxed);
+    if(!block){
+        block = new Block;
+        Blocks[b].store(block,std::memory_order_release);
+    }
+    block->Records[seq % BlockRecords] = r;
+    Summary& s = Summaries[b];
+    if(r.Date < s.MinDate.load(std::memory_order_relaxed)) s.MinDate.store(r.Date,std::memory_order_relaxed);
+    if(r.Date > s.MaxDate.load(std::memory_order_relaxed)) s.MaxDate.store(r.Date,std::memory_order_relaxed);
+    Published.store(seq + 1,std::memory_order_release);
+    return seq;
+}
+
+uint64_t Journal::Append(const Account &acc, const Account::Transaction &t, uint64_t prev) {
+    Record r;
+    r.Account = pack_account_number(acc.GetAccountNumber());
+    switch(t.type){
+        case Account::TransactionTypes::TransferOut: r.Counterparty = pack_account_number(t.destination); break;
+        case Account::TransactionTypes::TransferIn: r.Counterparty = pack_account_number(t.source); break;
+        default: break;
+    }
+    r.Cents = std::llround(t.amount * 100.0L);
+    r.BalanceCents = std::llround(t.balance_after * 100.0L);
+    r.Prev = prev;
+    r.Date = pack_date(t.trans);
+    r.Type = t.type;
+    return Append(r);
+}
+
+std::unique_lock<std::recursive_mutex> Journal::Hold() {
+    return std::unique_lock<std::recursive_mutex>(AppendLock);
+}
+
+uint64_t Journal::Size() const {
+    return Published.load(std::memory_order_acquire);
+}
+
+std::size_t Journal::Capacity() const {
+    return MaxBlocks * BlockRecords;
+}
+
+bool Journal::HasRoom(uint64_t records) const {
+    return records <= Capacity() - Size();
+}
+
+bool Journal::Get(uint64_t sequence, Journal::Record &out) const {
+    if(sequence >= Size())return false;
+    const Block* block = Blocks[sequence / BlockRecords].load(std::memory_order_acquire);
+    if(!block)return false;
+    out = block->Records[sequence % BlockRecords];
+    return true;
+}
+
+uint64_t Journal::BlocksInRange(uint32_t from, uint32_t to) const {
+    const uint64_t n = Size();
+    uint64_t blocks = 0;
+    for(uint64_t b=FreedBlocks.load(std::memory_order_acquire); b * BlockRecords < n; ++b){
+        const Summary& s = Summaries[b];
+        blocks += !(s.MaxDate.load(std::memory_order_relaxed) < from || s.MinDate.load(std::memory_order_relaxed) > to);
+    }
+    return blocks;
+}
+
+void Journal::Truncate(uint64_t before) {
+    before = std::min(before,Size());
+    const uint64_t blocks = before / BlockRecords;
+    for(uint64_t b=FreedBlocks.load(std::memory_order_relaxed); b<blocks; ++b){
+        delete Blocks[b].exchange(nullptr,std::memory_order_acq_rel);
+        Summaries[b].MinDate.store(UINT32_MAX,std::memory_order_relaxed);
+        Summaries[b].MaxDate.store(0,std::memory_order_relaxed);
+    }
+    if(blocks > FreedBlocks.load(std::memory_order_relaxed)) FreedBlocks.store(blocks,std::memory_order_release);
+}
+
+uint64_t Journal::FirstRetained() const {
+    return FreedBlocks.load(std::memory_order_acquire) * BlockRecords;
+}
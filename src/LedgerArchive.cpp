@@ -0,0 +1,171 @@
+#include "LedgerArchive.h"
+#include "Utils.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+
+
+LedgerArchive::~LedgerArchive() {
+    if(Map) munmap(const_cast<char*>(Map),MappedBytes);
+    if(Fd >= 0) close(Fd);
+}
+
+bool LedgerArchive::Open(const string &path, string *err) {
+    if(Fd >= 0){
+        if(err) *err = "Error! archive is already open.";
+        return false;
+    }
+    Fd = open(path.c_str(),O_RDWR | O_CREAT | O_CLOEXEC,0644);
+    if(Fd < 0){
+        if(err) *err = "Error! cannot open archive: " + string(strerror(errno));
+        return false;
+    }
+    // Leaves the archive closed and empty, as before Open.
+    auto fail = [&](const string& what){
+        if(err && !what.empty()) *err = "Error! " + what + ": " + strerror(errno);
+        close(Fd);
+        Fd = -1;
+        ByAccount.clear();
+        Segments = 0;
+        Bytes = 0;
+        return false;
+    };
+    struct stat st{};
+    if(fstat(Fd,&st) != 0)return fail("cannot stat archive");
+
+    const uint64_t size = static_cast<uint64_t>(st.st_size);
+    uint64_t offset = 0;
+    SegmentHeader h{};
+    while(offset + sizeof(h) <= size){
+        if(pread(Fd,&h,sizeof(h),static_cast<off_t>(offset)) != static_cast<ssize_t>(sizeof(h)))break;
+        const uint64_t end = offset + sizeof(h) + uint64_t{h.Count} * sizeof(PackedTransaction);
+        if(h.Magic != Magic || end > size)break;
+        Index(h,offset + sizeof(h));
+        offset = end;
+    }
+    if(offset != size && ftruncate(Fd,static_cast<off_t>(offset)) != 0)return fail("cannot cut torn archive tail");
+    if(!Remap(offset,err))return fail(string());
+    Bytes = offset;
+    return true;
+}
+
+bool LedgerArchive::IsOpen() const {
+    return Fd >= 0;
+}
+
+void LedgerArchive::Stage(const string &account, uint64_t first_index, const Account::Transaction *first,
+                          size_t count) {
+    const uint64_t packed = pack_account_number(account);
+    while(count){
+        const auto n = static_cast<uint32_t>(std::min<size_t>(count,UINT32_MAX));
+        SegmentHeader h{Magic,n,packed,UINT32_MAX,0,first_index};
+        const size_t at = Pending.size();
+        Pending.resize(at + sizeof(h) + size_t{n} * sizeof(PackedTransaction));
+        auto* out = reinterpret_cast<PackedTransaction*>(Pending.data() + at + sizeof(h));
+        for(uint32_t i=0; i<n; ++i){
+            out[i] = PackedTransaction::Pack(first[i]);
+            h.MinDate = std::min(h.MinDate,out[i].Date);
+            h.MaxDate = std::max(h.MaxDate,out[i].Date);
+        }
+        memcpy(Pending.data() + at,&h,sizeof(h));
+        first += n;
+        first_index += n;
+        count -= n;
+    }
+}
+
+size_t LedgerArchive::Staged() const {
+    return Pending.size();
+}
+
+bool LedgerArchive::Commit(string *err) {
+    if(Fd < 0){
+        if(err) *err = "Error! archive is not open.";
+        return false;
+    }
+    if(Pending.empty()){
+        if(err) err->clear();
+        return true;
+    }
+
+    auto fail = [&](const char* what){
+        if(err) *err = string("Error! ") + what + ": " + strerror(errno);
+        if(ftruncate(Fd,static_cast<off_t>(Bytes)) != 0){}
+        Pending.clear();
+        return false;
+    };
+    size_t done = 0;
+    while(done < Pending.size()){
+        ssize_t w = pwrite(Fd,Pending.data() + done,Pending.size() - done,static_cast<off_t>(Bytes + done));
+        if(w < 0 && errno == EINTR)continue;
+        if(w <= 0)return fail("cannot write archive");
+        done += static_cast<size_t>(w);
+    }
+    if(fdatasync(Fd) != 0)return fail("cannot sync archive");
+    // Nothing is indexed until the new segments are mapped, so a failed Commit leaves
+    // the archive as it was.
+    if(!Remap(Bytes + Pending.size(),err)){
+        if(ftruncate(Fd,static_cast<off_t>(Bytes)) != 0){}
+        Pending.clear();
+        return false;
+    }
+
+    for(size_t at=0; at<Pending.size(); ){
+        SegmentHeader h{};
+        memcpy(&h,Pending.data() + at,sizeof(h));
+        Index(h,Bytes + at + sizeof(h));
+        at += sizeof(h) + size_t{h.Count} * sizeof(PackedTransaction);
+    }
+    Bytes += Pending.size();
+    Pending.clear();
+    Pending.shrink_to_fit();
+    return true;
+}
+
+uint64_t LedgerArchive::Count(const string &account) const {
+    const vector<Segment>* segments = Find(account);
+    if(!segments)return 0;
+    uint64_t n = 0;
+    for(const Segment& s : *segments) n += s.Count;
+    return n;
+}
+
+uint64_t LedgerArchive::FileBytes() const {
+    return Bytes;
+}
+
+size_t LedgerArchive::SegmentCount() const {
+    return Segments;
+}
+
+const vector<LedgerArchive::Segment> *LedgerArchive::Find(const string &account) const {
+    auto it = ByAccount.find(pack_account_number(account));
+    return it == ByAccount.end() ? nullptr : &it->second;
+}
+
+bool LedgerArchive::Remap(uint64_t bytes, string *err) {
+    // The new mapping is made before the old one goes, so a failure keeps the old view.
+    const char* map = nullptr;
+    if(bytes){
+        void* m = mmap(nullptr,bytes,PROT_READ,MAP_SHARED,Fd,0);
+        if(m == MAP_FAILED){
+            if(err) *err = "Error! cannot map archive: " + string(strerror(errno));
+            return false;
+        }
+        map = static_cast<const char*>(m);
+    }
+    if(Map) munmap(const_cast<char*>(Map),MappedBytes);
+    Map = map;
+    MappedBytes = bytes;
+    if(err) err->clear();
+    return true;
+}
+
+void LedgerArchive::Index(const LedgerArchive::SegmentHeader &h, uint64_t offset) {
+    ByAccount[h.Account].push_back(Segment{offset,h.Count,h.MinDate,h.MaxDate,h.FirstIndex});
+    ++Segments;
+}
@@ -0,0 +1,86 @@
+#include "LedgerQuery.h"
+
+
+
+void LedgerQuery::Summary::Add(long double amount, Currency currency) {
+    if(!Count) CurrencyCode = currency;
+    else if(currency != CurrencyCode) Mixed = true;
+    Min = Count ? std::min(Min,amount) : amount;
+    Max = Count ? std::max(Max,amount) : amount;
+    Total += amount;
+    ++Count;
+}
+
+void LedgerQuery::Summary::Merge(const LedgerQuery::Summary &o) {
+    if(!o.Count)return;
+    if(!Count) CurrencyCode = o.CurrencyCode;
+    else if(o.CurrencyCode != CurrencyCode) Mixed = true;
+    Mixed = Mixed || o.Mixed;
+    Min = Count ? std::min(Min,o.Min) : o.Min;
+    Max = Count ? std::max(Max,o.Max) : o.Max;
+    Total += o.Total;
+    Count += o.Count;
+}
+
+LedgerQuery &LedgerQuery::OfType(Account::TransactionTypes type) {
+    TypeMask |= static_cast<uint8_t>(1u << static_cast<unsigned>(type));
+    return *this;
+}
+
+LedgerQuery &LedgerQuery::Between(const Account::Date &from, const Account::Date &to) {
+    From = pack_date(from);
+    To = pack_date(to);
+    return *this;
+}
+
+LedgerQuery &LedgerQuery::WithCounterparty(const string &account) {
+    Counterparty = account;
+    return *this;
+}
+
+LedgerQuery &LedgerQuery::AmountAtLeast(long double amount) {
+    MinAmount = amount;
+    return *this;
+}
+
+LedgerQuery &LedgerQuery::AmountAtMost(long double amount) {
+    MaxAmount = amount;
+    return *this;
+}
+
+LedgerQuery &LedgerQuery::InCurrency(Currency currency) {
+    OnlyCurrency = currency;
+    return *this;
+}
+
+LedgerQuery &LedgerQuery::Where(function<bool(const Transaction &)> pred) {
+    Predicates.push_back(std::move(pred));
+    return *this;
+}
+
+LedgerQuery &LedgerQuery::Limit(size_t n) {
+    MaxMatches = n;
+    return *this;
+}
+
+uint32_t LedgerQuery::FromDate() const {
+    return From;
+}
+
+uint32_t LedgerQuery::ToDate() const {
+    return To;
+}
+
+size_t LedgerQuery::GetLimit() const {
+    return MaxMatches;
+}
+
+size_t LedgerQuery::Count(const Account &acc) const {
+    return Run(acc,[](const Transaction&){});
+}
+
+LedgerQuery::Summary LedgerQuery::Summarize(const Account &acc) const {
+    Summary s;
+    Run(acc,[&](const Transaction& t){ s.Add(t.amount,t.currency); });
+    return s;
+}
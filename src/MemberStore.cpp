@@ -0,0 +1,36 @@
+#include "MemberStore.h"
+
+
+
+MemberId MemberStore::Add(const Person &p, string *err) {
+    if(p.GetIdCode().empty()){
+        if(err) *err = "Error! IdCode is empty.";
+        return NoMember;
+    }
+    if(Records.size() >= UINT32_MAX){
+        if(err) *err = "Error! member store is full.";
+        return NoMember;
+    }
+    const auto id = static_cast<MemberId>(Records.size() + 1);
+    if(!ByIdCode.emplace(p.GetIdCode(),id).second){
+        if(err) *err = "Error! this IdCode is already exists.";
+        return NoMember;
+    }
+    Records.push_back(p);
+    if(err) err->clear();
+    return id;
+}
+
+MemberId MemberStore::Lookup(const string &id_code) const {
+    auto it = ByIdCode.find(id_code);
+    return it == ByIdCode.end() ? NoMember : it->second;
+}
+
+const Person *MemberStore::Find(MemberId id) const {
+    if(id == NoMember || id > Records.size())return nullptr;
+    return &Records[id - 1];
+}
+
+size_t MemberStore::Size() const {
+    return Records.size();
+}
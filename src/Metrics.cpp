@@ -0,0 +1,274 @@
+#include "Metrics.h"
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+
+std::size_t LatencyHistogram::BucketOf(std::uint64_t v) {
+    if(v < SubCount)return static_cast<std::size_t>(v);
+    int msb = 63 - __builtin_clzll(v);
+    std::size_t magnitude = static_cast<std::size_t>(msb - SubBits + 1);
+    std::size_t sub = static_cast<std::size_t>(v >> (msb - SubBits)) - SubCount;
+    return magnitude * SubCount + sub;
+}
+
+std::uint64_t LatencyHistogram::BucketLowerBound(std::size_t idx) {
+    std::size_t magnitude = idx / SubCount;
+    std::uint64_t sub = idx % SubCount;
+    if(magnitude == 0)return sub;
+    return (SubCount + sub) << (magnitude - 1);
+}
+
+void LatencyHistogram::Record(std::uint64_t v) {
+    AddToBucket(BucketOf(v),1);
+    MaxValue = std::max(MaxValue,v);
+}
+
+void LatencyHistogram::AddToBucket(std::size_t idx, std::uint64_t count) {
+    if(count == 0)return;
+    Buckets[idx] += count;
+    Total += count;
+    MaxValue = std::max(MaxValue,BucketLowerBound(idx));
+}
+
+void LatencyHistogram::Merge(const LatencyHistogram &other) {
+    for(std::size_t i=0; i<BucketCount; ++i) Buckets[i] += other.Buckets[i];
+    Total += other.Total;
+    MaxValue = std::max(MaxValue,other.MaxValue);
+}
+
+void LatencyHistogram::Clear() {
+    Buckets.fill(0);
+    Total = 0;
+    MaxValue = 0;
+}
+
+std::uint64_t LatencyHistogram::Count() const {
+    return Total;
+}
+
+std::uint64_t LatencyHistogram::Max() const {
+    return MaxValue;
+}
+
+std::uint64_t LatencyHistogram::Percentile(double p) const {
+    if(Total == 0)return 0;
+    auto rank = static_cast<std::uint64_t>(p / 100.0 * static_cast<double>(Total));
+    if(rank >= Total) rank = Total - 1;
+    std::uint64_t seen = 0;
+    for(std::size_t i=0; i<BucketCount; ++i){
+        seen += Buckets[i];
+        if(seen > rank)return BucketLowerBound(i);
+    }
+    return MaxValue;
+}
+
+
+
+namespace {
+
+// Written only by its owning thread (load + store, no locked RMW); read by Snapshot().
+struct ThreadMetrics{
+    using Counter = std::atomic<std::uint64_t>;
+
+    Counter Ops[MetricOpCount]{};
+    Counter Failed[MetricOpCount]{};
+    Counter Reasons[MetricOpCount][MetricFailureCount]{};
+    Counter Latency[MetricOpCount][LatencyHistogram::BucketCount]{};
+    Counter Probe[LatencyHistogram::BucketCount]{};
+    Counter LedgerAppends{};
+    Counter LedgerMaxLength{};
+    std::uint32_t SampleTick[MetricOpCount]{};
+
+    static void Bump(Counter& c,std::uint64_t by = 1){
+        c.store(c.load(std::memory_order_relaxed) + by,std::memory_order_relaxed);
+    }
+
+    void AddTo(MetricsSnapshot& s)const{
+        for(std::size_t op=0; op<MetricOpCount; ++op){
+            s.Ops[op] += Ops[op].load(std::memory_order_relaxed);
+            s.Failed[op] += Failed[op].load(std::memory_order_relaxed);
+            for(std::size_t r=0; r<MetricFailureCount; ++r)
+                s.FailuresByReason[op][r] += Reasons[op][r].load(std::memory_order_relaxed);
+            for(std::size_t b=0; b<LatencyHistogram::BucketCount; ++b)
+                s.Latency[op].AddToBucket(b,Latency[op][b].load(std::memory_order_relaxed));
+        }
+        for(std::size_t b=0; b<LatencyHistogram::BucketCount; ++b)
+            s.ProbeLength.AddToBucket(b,Probe[b].load(std::memory_order_relaxed));
+        s.LedgerAppends += LedgerAppends.load(std::memory_order_relaxed);
+        s.LedgerMaxLength = std::max(s.LedgerMaxLength,LedgerMaxLength.load(std::memory_order_relaxed));
+    }
+
+    void Clear(){
+        for(auto& c : Ops) c.store(0,std::memory_order_relaxed);
+        for(auto& c : Failed) c.store(0,std::memory_order_relaxed);
+        for(auto& row : Reasons) for(auto& c : row) c.store(0,std::memory_order_relaxed);
+        for(auto& row : Latency) for(auto& c : row) c.store(0,std::memory_order_relaxed);
+        for(auto& c : Probe) c.store(0,std::memory_order_relaxed);
+        LedgerAppends.store(0,std::memory_order_relaxed);
+        LedgerMaxLength.store(0,std::memory_order_relaxed);
+    }
+};
+
+struct Registry{
+    std::mutex Lock;
+    std::vector<ThreadMetrics*> Live;
+    MetricsSnapshot Retired;
+};
+
+Registry& registry(){
+    static Registry* r = new Registry();
+    return *r;
+}
+
+struct ThreadSlot{
+    std::unique_ptr<ThreadMetrics> Block = std::make_unique<ThreadMetrics>();
+
+    ThreadSlot(){
+        Registry& r = registry();
+        std::lock_guard<std::mutex> g(r.Lock);
+        r.Live.push_back(Block.get());
+    }
+    ~ThreadSlot(){
+        Registry& r = registry();
+        std::lock_guard<std::mutex> g(r.Lock);
+        Block->AddTo(r.Retired);
+        r.Live.erase(std::remove(r.Live.begin(),r.Live.end(),Block.get()),r.Live.end());
+    }
+};
+
+ThreadMetrics& local(){
+    static thread_local ThreadSlot slot;
+    return *slot.Block;
+}
+
+}
+
+
+
+bool Metrics::Enabled() {
+#ifdef BANK_METRICS
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Metrics::Sample(MetricOp op) {
+    constexpr std::uint32_t mask = (1u << BANK_METRICS_SAMPLE_SHIFT) - 1;
+    return (local().SampleTick[static_cast<std::size_t>(op)]++ & mask) == 0;
+}
+
+void Metrics::RecordOp(MetricOp op, bool ok) {
+    ThreadMetrics& m = local();
+    auto i = static_cast<std::size_t>(op);
+    ThreadMetrics::Bump(m.Ops[i]);
+    if(!ok) ThreadMetrics::Bump(m.Failed[i]);
+}
+
+void Metrics::RecordFailure(MetricOp op, MetricFailure reason) {
+    ThreadMetrics::Bump(local().Reasons[static_cast<std::size_t>(op)][static_cast<std::size_t>(reason)]);
+}
+
+void Metrics::RecordLatency(MetricOp op, std::uint64_t ns) {
+    ThreadMetrics::Bump(local().Latency[static_cast<std::size_t>(op)][LatencyHistogram::BucketOf(ns)]);
+}
+
+void Metrics::RecordProbe(std::size_t len) {
+    ThreadMetrics::Bump(local().Probe[LatencyHistogram::BucketOf(len)]);
+}
+
+void Metrics::RecordLedgerAppend(std::size_t new_length) {
+    ThreadMetrics& m = local();
+    ThreadMetrics::Bump(m.LedgerAppends);
+    if(new_length > m.LedgerMaxLength.load(std::memory_order_relaxed))
+        m.LedgerMaxLength.store(new_length,std::memory_order_relaxed);
+}
+
+MetricsSnapshot Metrics::Snapshot() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> g(r.Lock);
+    MetricsSnapshot s = r.Retired;
+    for(const ThreadMetrics* t : r.Live) t->AddTo(s);
+    return s;
+}
+
+void Metrics::Reset() {
+    Registry& r = registry();
+    std::lock_guard<std::mutex> g(r.Lock);
+    r.Retired = MetricsSnapshot{};
+    for(ThreadMetrics* t : r.Live) t->Clear();
+}
+
+const char *Metrics::OpToString(MetricOp op) {
+    switch (op) {
+        case MetricOp::OpenAccount:return "OpenAccount";
+        case MetricOp::CloseAccount:return "CloseAccount";
+        case MetricOp::Deposit:return "DepositAccount";
+        case MetricOp::Withdraw:return "WithdrawFromAccount";
+        case MetricOp::Transfer:return "TransferBetweenAccounts";
+        case MetricOp::AddPerson:return "AddPerson";
+        case MetricOp::Count:break;
+    }
+    return "Unknown";
+}
+
+const char *Metrics::FailureToString(MetricFailure f) {
+    switch (f) {
+        case MetricFailure::EmptyInput:return "EmptyInput";
+        case MetricFailure::NotFound:return "NotFound";
+        case MetricFailure::Duplicate:return "Duplicate";
+        case MetricFailure::InvalidAmount:return "InvalidAmount";
+        case MetricFailure::Rejected:return "Rejected";
+        case MetricFailure::Count:break;
+    }
+    return "Unknown";
+}
+
+void Metrics::DumpText(std::ostream &os) {
+    MetricsSnapshot s = Snapshot();
+    for(std::size_t op=0; op<MetricOpCount; ++op){
+        const char* name = OpToString(static_cast<MetricOp>(op));
+        os<<"bank_ops_total{op=\""<<name<<"\"} "<<s.Ops[op]<<'\n';
+        os<<"bank_ops_failed_total{op=\""<<name<<"\"} "<<s.Failed[op]<<'\n';
+        for(std::size_t r=0; r<MetricFailureCount; ++r){
+            if(s.FailuresByReason[op][r] == 0)continue;
+            os<<"bank_failures_total{op=\""<<name<<"\",reason=\""<<FailureToString(static_cast<MetricFailure>(r))
+              <<"\"} "<<s.FailuresByReason[op][r]<<'\n';
+        }
+        const LatencyHistogram& h = s.Latency[op];
+        for(double q : {50.0,90.0,99.0,99.9}){
+            os<<"bank_latency_ns{op=\""<<name<<"\",quantile=\""<<q / 100.0<<"\"} "<<h.Percentile(q)<<'\n';
+        }
+        os<<"bank_latency_ns_count{op=\""<<name<<"\"} "<<h.Count()<<'\n';
+    }
+    os<<"bank_lookup_probe_length{quantile=\"0.5\"} "<<s.ProbeLength.Percentile(50)<<'\n';
+    os<<"bank_lookup_probe_length{quantile=\"0.99\"} "<<s.ProbeLength.Percentile(99)<<'\n';
+    os<<"bank_lookup_probe_length_max "<<s.ProbeLength.Max()<<'\n';
+    os<<"bank_ledger_appends_total "<<s.LedgerAppends<<'\n';
+    os<<"bank_ledger_max_length "<<s.LedgerMaxLength<<'\n';
+}
+
+void Metrics::DumpJson(std::ostream &os) {
+    MetricsSnapshot s = Snapshot();
+    os<<"{\"enabled\": "<<(Enabled() ? "true" : "false")<<", \"ops\": {";
+    for(std::size_t op=0; op<MetricOpCount; ++op){
+        const LatencyHistogram& h = s.Latency[op];
+        os<<(op ? ", " : "")<<'"'<<OpToString(static_cast<MetricOp>(op))<<"\": {\"total\": "<<s.Ops[op]
+          <<", \"failed\": "<<s.Failed[op]<<", \"failures\": {";
+        bool first = true;
+        for(std::size_t r=0; r<MetricFailureCount; ++r){
+            if(s.FailuresByReason[op][r] == 0)continue;
+            os<<(first ? "" : ", ")<<'"'<<FailureToString(static_cast<MetricFailure>(r))<<"\": "<<s.FailuresByReason[op][r];
+            first = false;
+        }
+        os<<"}, \"latency_ns\": {\"samples\": "<<h.Count()<<", \"p50\": "<<h.Percentile(50)
+          <<", \"p90\": "<<h.Percentile(90)<<", \"p99\": "<<h.Percentile(99)<<", \"p999\": "<<h.Percentile(99.9)
+          <<", \"max\": "<<h.Max()<<"}}";
+    }
+    os<<"}, \"probe_length\": {\"samples\": "<<s.ProbeLength.Count()<<", \"p50\": "<<s.ProbeLength.Percentile(50)
+      <<", \"p99\": "<<s.ProbeLength.Percentile(99)<<", \"max\": "<<s.ProbeLength.Max()<<"}"
+      <<", \"ledger\": {\"appends\": "<<s.LedgerAppends<<", \"max_length\": "<<s.LedgerMaxLength<<"}}\n";
+}
@@ -0,0 +1,140 @@
+#include "NumaTopology.h"
+#include "Utils.h"
+
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+
+
+// "0-3,8,10-11" -> {0,1,2,3,8,10,11}
+static vector<int> parse_cpu_list(const string& text){
+    vector<int> out;
+    size_t pos = 0;
+    while(pos < text.size()){
+        size_t comma = text.find(',',pos);
+        if(comma == string::npos) comma = text.size();
+        const string part = trim_copy(text.substr(pos,comma - pos));
+        pos = comma + 1;
+        if(part.empty())continue;
+        const size_t dash = part.find('-');
+        const int first = std::stoi(part.substr(0,dash));
+        const int last = dash == string::npos ? first : std::stoi(part.substr(dash + 1));
+        for(int c=first; c<=last; ++c) out.push_back(c);
+    }
+    return out;
+}
+
+static bool read_line(const string& path,string& out){
+    ifstream in(path);
+    return in && std::getline(in,out);
+}
+
+static vector<int> allowed_cpus(){
+    vector<int> out;
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if(sched_getaffinity(0,sizeof(set),&set) == 0){
+        for(int c=0; c<CPU_SETSIZE; ++c) if(CPU_ISSET(c,&set)) out.push_back(c);
+    }
+    if(out.empty()) out.push_back(0);
+    return out;
+}
+
+NumaTopology NumaTopology::Detect() {
+    NumaTopology t;
+    const vector<int> allowed = allowed_cpus();
+    string online;
+    if(read_line("/sys/devices/system/node/online",online)){
+        try{
+            for(int id : parse_cpu_list(online)){
+                string list;
+                if(!read_line("/sys/devices/system/node/node" + std::to_string(id) + "/cpulist",list))continue;
+                Node n{id,{}};
+                for(int c : parse_cpu_list(list)){
+                    if(std::find(allowed.begin(),allowed.end(),c) != allowed.end()) n.Cpus.push_back(c);
+                }
+                // Memory-only nodes and nodes outside our cpuset cannot host a worker.
+                if(!n.Cpus.empty()) t.Nodes.push_back(std::move(n));
+            }
+        }catch(const std::exception&){
+            t.Nodes.clear();
+        }
+    }
+    if(t.Nodes.empty()) t.Nodes.push_back(Node{0,allowed});
+    return t;
+}
+
+NumaTopology NumaTopology::Simulated(size_t nodes) {
+    NumaTopology t;
+    t.Simulation = true;
+    const vector<int> cpus = allowed_cpus();
+    nodes = std::max<size_t>(1,nodes);
+    for(size_t i=0; i<nodes; ++i) t.Nodes.push_back(Node{static_cast<int>(i),{}});
+    // Round-robin; with fewer CPUs than nodes, nodes share CPUs.
+    for(size_t i=0; i<std::max(nodes,cpus.size()); ++i){
+        t.Nodes[i % nodes].Cpus.push_back(cpus[i % cpus.size()]);
+    }
+    for(auto& n : t.Nodes){
+        std::sort(n.Cpus.begin(),n.Cpus.end());
+        n.Cpus.erase(std::unique(n.Cpus.begin(),n.Cpus.end()),n.Cpus.end());
+    }
+    return t;
+}
+
+size_t NumaTopology::NodeCount() const {
+    return Nodes.size();
+}
+
+const NumaTopology::Node &NumaTopology::GetNode(size_t i) const {
+    return Nodes[i];
+}
+
+bool NumaTopology::IsSimulated() const {
+    return Simulation;
+}
+
+bool NumaTopology::PinCurrentThread(size_t node, string *err) const {
+    if(node >= Nodes.size()){
+        if(err) *err = "Error! node is out of range.";
+        return false;
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for(int c : Nodes[node].Cpus) CPU_SET(c,&set);
+    if(sched_setaffinity(0,sizeof(set),&set) != 0){
+        if(err) *err = "Error! sched_setaffinity failed.";
+        return false;
+    }
+    if(err) err->clear();
+    return true;
+}
+
+static bool set_mempolicy_mask(int mode,unsigned long mask,string* err){
+    if(syscall(SYS_set_mempolicy,mode,&mask,sizeof(mask) * 8) != 0){
+        if(err) *err = "Error! set_mempolicy failed.";
+        return false;
+    }
+    if(err) err->clear();
+    return true;
+}
+
+bool NumaTopology::PreferLocalMemory(size_t node, string *err) const {
+    if(Simulation || node >= Nodes.size() || Nodes[node].Id >= 64){
+        if(err) *err = "Error! no memory policy for this node.";
+        return false;
+    }
+    return set_mempolicy_mask(MPOL_PREFERRED,1UL << Nodes[node].Id,err);
+}
+
+bool NumaTopology::InterleaveMemory(string *err) const {
+    unsigned long mask = 0;
+    for(const auto& n : Nodes) if(n.Id < 64) mask |= 1UL << n.Id;
+    if(Simulation || !mask){
+        if(err) *err = "Error! no memory policy for this topology.";
+        return false;
+    }
+    return set_mempolicy_mask(MPOL_INTERLEAVE,mask,err);
+}
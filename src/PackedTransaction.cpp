@@ -0,0 +1,47 @@
+#include "PackedTransaction.h"
+#include "Utils.h"
+
+
+
+static uint64_t pack_endpoint(const string& s,PackedTransaction::Endpoint& tag){
+    using Endpoint = PackedTransaction::Endpoint;
+    uint64_t packed = pack_account_number(s);
+    if(packed || (!s.empty() && is_Digit(s))) tag = Endpoint::Account;
+    else if(s == "Cash") tag = Endpoint::Cash;
+    else if(s == "Interest") tag = Endpoint::Interest;
+    else if(s == "Closed") tag = Endpoint::Closed;
+    else tag = Endpoint::Other;
+    return packed;
+}
+
+static void unpack_endpoint(uint64_t packed,PackedTransaction::Endpoint tag,string& out){
+    switch(tag){
+        case PackedTransaction::Endpoint::Account: out = unpack_account_number(packed); return;
+        case PackedTransaction::Endpoint::Cash: out = "Cash"; return;
+        case PackedTransaction::Endpoint::Interest: out = "Interest"; return;
+        case PackedTransaction::Endpoint::Closed: out = "Closed"; return;
+        case PackedTransaction::Endpoint::Other: out.clear(); return;
+    }
+}
+
+PackedTransaction PackedTransaction::Pack(const Account::Transaction &t) {
+    PackedTransaction p;
+    p.Source = pack_endpoint(t.source,p.SourceTag);
+    p.Destination = pack_endpoint(t.destination,p.DestinationTag);
+    p.Cents = std::llround(t.amount * 100.0L);
+    p.BalanceCents = std::llround(t.balance_after * 100.0L);
+    p.Date = pack_date(t.trans);
+    p.Type = t.type;
+    p.CurrencyCode = t.currency;
+    return p;
+}
+
+void PackedTransaction::UnpackInto(Account::Transaction &out) const {
+    unpack_endpoint(Source,SourceTag,out.source);
+    unpack_endpoint(Destination,DestinationTag,out.destination);
+    out.amount = static_cast<long double>(Cents) / 100.0L;
+    out.balance_after = static_cast<long double>(BalanceCents) / 100.0L;
+    out.trans = unpack_date(Date);
+    out.type = Type;
+    out.currency = CurrencyCode;
+}
@@ -0,0 +1,225 @@
+#include "PartitionedBank.h"
+#include "Utils.h"
+
+
+
+PartitionedBank::PartitionedBank(NumaTopology topology, Placement placement)
+        : Topology(std::move(topology)),Mode(placement) {
+    for(size_t i=0; i<Topology.NodeCount(); ++i){
+        Workers.push_back(make_unique<Worker>());
+        Workers.back()->Busy = true;     // until the worker has built its Management
+    }
+    for(size_t i=0; i<Workers.size(); ++i){
+        Workers[i]->Thread = thread([this,i]{ WorkerLoop(i); });
+    }
+    for(size_t i=0; i<Workers.size(); ++i) Wait(i);
+}
+
+PartitionedBank::~PartitionedBank() {
+    for(auto& w : Workers){
+        {
+            lock_guard<mutex> lk(w->Lock);
+            w->Stop = true;
+        }
+        w->Wake.notify_one();
+    }
+    for(auto& w : Workers) w->Thread.join();
+}
+
+void PartitionedBank::WorkerLoop(size_t node) {
+    Worker& w = *Workers[node];
+    bool pinned = false,policy = false;
+    if(Mode == Placement::Local){
+        pinned = Topology.PinCurrentThread(node);
+        policy = Topology.PreferLocalMemory(node);
+    }
+    else policy = Topology.InterleaveMemory();
+
+    // Built here so its memory is first touched by this node's thread.
+    auto bank = make_unique<Management>();
+    bank->SetNumberPartition(static_cast<uint32_t>(node),static_cast<uint32_t>(Workers.size()));
+    {
+        lock_guard<mutex> lk(w.Lock);
+        w.Bank = std::move(bank);
+        w.Pinned = pinned;
+        w.MemoryPolicy = policy;
+        w.Busy = false;
+    }
+    w.Done.notify_all();
+
+    for(;;){
+        function<void(Management&)> task;
+        {
+            unique_lock<mutex> lk(w.Lock);
+            w.Wake.wait(lk,[&]{ return w.Stop || w.Task; });
+            if(!w.Task)return;
+            task = std::move(w.Task);
+            w.Task = nullptr;
+        }
+        task(*w.Bank);
+        {
+            lock_guard<mutex> lk(w.Lock);
+            w.Busy = false;
+        }
+        w.Done.notify_all();
+    }
+}
+
+void PartitionedBank::Post(size_t node, function<void(Management &)> fn) {
+    Worker& w = *Workers[node];
+    {
+        lock_guard<mutex> lk(w.Lock);
+        w.Task = std::move(fn);
+        w.Busy = true;
+    }
+    w.Wake.notify_one();
+}
+
+void PartitionedBank::Wait(size_t node) {
+    Worker& w = *Workers[node];
+    unique_lock<mutex> lk(w.Lock);
+    w.Done.wait(lk,[&]{ return !w.Busy; });
+}
+
+void PartitionedBank::RunOn(size_t node, const function<void(Management &)> &fn) {
+    Post(node,fn);
+    Wait(node);
+}
+
+void PartitionedBank::RunOnAll(const function<void(size_t, Management &)> &fn) {
+    for(size_t i=0; i<Workers.size(); ++i) Post(i,[&fn,i](Management& bank){ fn(i,bank); });
+    for(size_t i=0; i<Workers.size(); ++i) Wait(i);
+}
+
+size_t PartitionedBank::NodeCount() const {
+    return Workers.size();
+}
+
+size_t PartitionedBank::NodeOf(const string &account_number) const {
+    // Malformed numbers go to node 0, whose Management reports them as not found.
+    if(account_number.size() != 10 || !is_Digit(account_number))return 0;
+    return pack_account_number(account_number) % Workers.size();
+}
+
+const NumaTopology &PartitionedBank::GetTopology() const {
+    return Topology;
+}
+
+PartitionedBank::Placement PartitionedBank::GetPlacement() const {
+    return Mode;
+}
+
+bool PartitionedBank::Pinned() const {
+    for(const auto& w : Workers) if(!w->Pinned)return false;
+    return true;
+}
+
+bool PartitionedBank::MemoryPolicyApplied() const {
+    for(const auto& w : Workers) if(!w->MemoryPolicy)return false;
+    return true;
+}
+
+const Management &PartitionedBank::Shard(size_t node) const {
+    return *Workers[node]->Bank;
+}
+
+bool PartitionedBank::OpenAccount(const Person &p, long double initial_balance, Account::AccountType type,
+                                  const Date &date, string *number, string *err) {
+    const size_t node = std::hash<string>{}(p.GetIdCode()) % Workers.size();
+    bool ok = false;
+    RunOn(node,[&](Management& bank){
+        ok = bank.OpenAccount(p,initial_balance,type,date,err);
+        if(ok && number) *number = bank.GetAccountsOf(p.GetIdCode())->back();
+    });
+    return ok;
+}
+
+bool PartitionedBank::RunBatch(const vector<Op> &ops, const Date &date, vector<uint8_t> *ok,
+                               PartitionedBank::BatchStats *stats, string *err) {
+    if(ops.size() > UINT32_MAX){
+        if(err) *err = "Error! batch is too large.";
+        return false;
+    }
+    BatchStats st;
+    for(auto& w : Workers){
+        w->LocalOps.clear();
+        w->Debits.clear();
+        w->Credits.clear();
+        w->Refunds.clear();
+    }
+    for(size_t i=0; i<ops.size(); ++i){
+        const Op& op = ops[i];
+        const size_t src = NodeOf(op.Source);
+        if(op.Type == Op::Kind::Transfer){
+            const size_t dst = NodeOf(op.Destination);
+            if(dst != src){
+                Workers[src]->Debits.push_back(static_cast<uint32_t>(i));
+                Workers[dst]->Credits.push_back(static_cast<uint32_t>(i));
+                ++st.CrossNode;
+                continue;
+            }
+        }
+        Workers[src]->LocalOps.push_back(static_cast<uint32_t>(i));
+        ++st.Local;
+    }
+
+    // 0 failed, 1 done, 2 debited but the credit failed. Workers write disjoint entries.
+    vector<uint8_t> result(ops.size(),0);
+    // Currency of each debited source; the credit is refused in any other currency.
+    vector<Currency> debited(st.CrossNode ? ops.size() : 0);
+
+    RunOnAll([&](size_t node,Management& bank){
+        Worker& w = *Workers[node];
+        for(uint32_t i : w.LocalOps){
+            const Op& op = ops[i];
+            bool done = false;
+            switch (op.Type) {
+                case Op::Kind::Deposit: done = bank.DepositAccount(op.Source,op.Amount,date); break;
+                case Op::Kind::Withdraw: done = bank.WithdrawFromAccount(op.Source,op.Amount,date); break;
+                case Op::Kind::Transfer:
+                    done = bank.TransferBetweenAccounts(op.Source,op.Destination,op.Amount,date);
+                    break;
+            }
+            result[i] = done;
+        }
+        for(uint32_t i : w.Debits){
+            result[i] = bank.TransferOut(ops[i].Source,ops[i].Destination,ops[i].Amount,date);
+            if(result[i]) debited[i] = bank.GetAccount(ops[i].Source)->GetCurrency();
+        }
+    });
+
+    if(st.CrossNode){
+        RunOnAll([&](size_t node,Management& bank){
+            for(uint32_t i : Workers[node]->Credits){
+                if(result[i] && !bank.TransferIn(ops[i].Destination,ops[i].Source,ops[i].Amount,debited[i],date))
+                    result[i] = 2;
+            }
+        });
+        for(auto& w : Workers){
+            for(uint32_t i : w->Debits) if(result[i] == 2) w->Refunds.push_back(i);
+            st.Refunded += w->Refunds.size();
+        }
+    }
+
+    bool refunded = true;
+    if(st.Refunded){
+        vector<uint8_t> refund_ok(Workers.size(),1);
+        RunOnAll([&](size_t node,Management& bank){
+            for(uint32_t i : Workers[node]->Refunds){
+                if(!bank.TransferIn(ops[i].Source,ops[i].Destination,ops[i].Amount,debited[i],date)) refund_ok[node] = 0;
+                result[i] = 0;
+            }
+        });
+        for(uint8_t r : refund_ok) refunded = refunded && r;
+    }
+
+    for(uint8_t r : result) st.Failed += r != 1;
+    if(ok) ok->assign(result.begin(),result.end());
+    if(stats) *stats = st;
+    if(!refunded){
+        if(err) *err = "Error! a cross-node refund failed.";
+        return false;
+    }
+    if(err) err->clear();
+    return true;
+}
@@ -189,6 +189,10 @@ string Person::GetGender(bool gender) {
     return gender ? "Man" : "Woman";
 }
 
+bool Person::IsMale() const {
+    return this->Gender;
+}
+
 const Person::BirthDate &Person::GetBirthDate() const {
     return birthdate_;
 }
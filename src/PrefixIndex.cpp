@@ -0,0 +1,123 @@
+#include "PrefixIndex.h"
+#include <algorithm>
+#include <cmath>
+
+
+
+static constexpr uint64_t LengthBits = 32;
+
+PrefixIndex::PrefixIndex(unsigned width) : Width(std::min(std::max(width,1u),MaxWidth)),Scale(1) {
+    for(unsigned i=0; i<Width; ++i) Scale *= 10;
+}
+
+bool PrefixIndex::Encode(const string &digits, uint64_t &key, string *err) const {
+    if(digits.empty() || digits.size() > Width){
+        if(err) *err = "Error! key must have 1 to " + std::to_string(Width) + " digits.";
+        return false;
+    }
+    uint64_t v = 0;
+    for(unsigned char ch : digits){
+        if(ch < '0' || ch > '9'){
+            if(err) *err = "Error! key must include only digits.";
+            return false;
+        }
+        v = v * 10 + (ch - '0');
+    }
+    for(size_t i=digits.size(); i<Width; ++i) v *= 10;
+    key = v * LengthBits + digits.size();
+    return true;
+}
+
+bool PrefixIndex::PrefixRange(const string &prefix, PrefixIndex::Range &r, string *err) const {
+    if(prefix.empty()){
+        r = Range{0,Scale * LengthBits,0};
+        return true;
+    }
+    uint64_t key;
+    if(!Encode(prefix,key,err))return false;
+    uint64_t span = 1;
+    for(size_t i=prefix.size(); i<Width; ++i) span *= 10;
+    const uint64_t padded = key / LengthBits;
+    r = Range{padded * LengthBits,(padded + span) * LengthBits,static_cast<unsigned>(prefix.size())};
+    return true;
+}
+
+string PrefixIndex::Decode(uint64_t key) const {
+    const size_t len = key % LengthBits;
+    uint64_t v = key / LengthBits;
+    string out(Width,'0');
+    for(size_t i=Width; i-- > 0 && v; v /= 10) out[i] = static_cast<char>('0' + v % 10);
+    out.resize(len);
+    return out;
+}
+
+bool PrefixIndex::Insert(const string &digits, string *err) {
+    uint64_t key;
+    if(!Encode(digits,key,err))return false;
+    if(!std::binary_search(Sorted.begin(),Sorted.end(),key)){
+        auto at = std::lower_bound(Delta.begin(),Delta.end(),key);
+        if(at == Delta.end() || *at != key) Delta.insert(at,key);
+    }
+    const size_t limit = std::max<size_t>(1024,static_cast<size_t>(4 * std::sqrt(static_cast<double>(Sorted.size()))));
+    if(Delta.size() > limit) Merge();
+    if(err) err->clear();
+    return true;
+}
+
+bool PrefixIndex::Contains(const string &digits) const {
+    uint64_t key;
+    if(!Encode(digits,key,nullptr))return false;
+    return std::binary_search(Sorted.begin(),Sorted.end(),key) || std::binary_search(Delta.begin(),Delta.end(),key);
+}
+
+bool PrefixIndex::Find(const string &prefix, size_t limit, vector<string> &out, string *err) const {
+    Range r{};
+    if(!PrefixRange(prefix,r,err))return false;
+    auto a = std::lower_bound(Sorted.begin(),Sorted.end(),r.Low);
+    auto a_end = std::lower_bound(a,Sorted.end(),r.High);
+    auto b = std::lower_bound(Delta.begin(),Delta.end(),r.Low);
+    auto b_end = std::lower_bound(b,Delta.end(),r.High);
+
+    size_t found = 0;
+    while(found < limit && (a != a_end || b != b_end)){
+        const uint64_t key = (b == b_end || (a != a_end && *a < *b)) ? *a++ : *b++;
+        if(key % LengthBits < r.Length)continue;
+        out.push_back(Decode(key));
+        ++found;
+    }
+    if(err) err->clear();
+    return true;
+}
+
+size_t PrefixIndex::CountPrefix(const string &prefix) const {
+    Range r{};
+    if(!PrefixRange(prefix,r,nullptr))return 0;
+    size_t n = 0;
+    for(const vector<uint64_t>* keys : {&Sorted,&Delta}){
+        auto lo = std::lower_bound(keys->begin(),keys->end(),r.Low);
+        auto hi = std::lower_bound(lo,keys->end(),r.High);
+        n += static_cast<size_t>(hi - lo);
+        // Only keys padding to the prefix itself can be shorter than it, and they sort first.
+        for(auto it=lo; it!=hi && *it / LengthBits == r.Low / LengthBits && *it % LengthBits < r.Length; ++it) --n;
+    }
+    return n;
+}
+
+size_t PrefixIndex::Size() const {
+    return Sorted.size() + Delta.size();
+}
+
+unsigned PrefixIndex::GetWidth() const {
+    return Width;
+}
+
+// Merges from the back into the grown array, so no second copy of Sorted is needed.
+void PrefixIndex::Merge() {
+    size_t a = Sorted.size(),b = Delta.size();
+    Sorted.resize(a + b);
+    for(size_t out = a + b; b; ){
+        if(a && Sorted[a - 1] > Delta[b - 1]) Sorted[--out] = Sorted[--a];
+        else Sorted[--out] = Delta[--b];
+    }
+    Delta.clear();
+}
@@ -0,0 +1,169 @@
+#include "Screening.h"
+#include <algorithm>
+
+
+
+static inline uint64_t mix64(uint64_t x){
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+const char *ScreeningAlert::KindToString(ScreeningAlert::Kind kind) {
+    switch(kind){
+        case Kind::FanOut: return "FanOut";
+        case Kind::RoundTrip: return "RoundTrip";
+        case Kind::BalanceDrain: return "BalanceDrain";
+    }
+    return "Unknown";
+}
+
+ScreeningPipeline::ScreeningPipeline(TransactionStream &stream, ScreeningConfig config)
+        : Stream(stream),Config(config) {
+    if(Config.FanOutDestinations > MaxFanOut) Config.FanOutDestinations = MaxFanOut;
+}
+
+ScreeningPipeline::~ScreeningPipeline() {
+    Stop();
+}
+
+bool ScreeningPipeline::Start(std::string *err) {
+    if(!Workers.empty()){
+        if(err) *err = "Error! screening is already running.";
+        return false;
+    }
+    if(Config.Workers == 0){
+        if(err) *err = "Error! screening needs at least one worker.";
+        return false;
+    }
+    for(std::size_t i=0; i<Config.Workers; ++i){
+        int id = Stream.Subscribe();
+        if(id < 0){
+            for(int c : Consumers) Stream.Unsubscribe(c);
+            Consumers.clear();
+            if(err) *err = "Error! transaction stream has no free consumer slots.";
+            return false;
+        }
+        Consumers.push_back(id);
+    }
+    WorkerDays = std::vector<std::atomic<uint32_t>>(Config.Workers);
+    Stopping.store(false,std::memory_order_relaxed);
+    for(std::size_t i=0; i<Config.Workers; ++i)
+        Workers.emplace_back(&ScreeningPipeline::Run,this,i,Consumers[i]);
+    return true;
+}
+
+void ScreeningPipeline::Stop() {
+    if(Workers.empty())return;
+    Stopping.store(true,std::memory_order_release);
+    for(auto& w : Workers) w.join();
+    Workers.clear();
+    for(int c : Consumers) Stream.Unsubscribe(c);
+    Consumers.clear();
+}
+
+void ScreeningPipeline::Run(std::size_t worker, int consumer) {
+    TransactionEvent batch[256];
+    for(;;){
+        bool stopping = Stopping.load(std::memory_order_acquire);
+        std::size_t n = Stream.Poll(consumer,batch,256);
+        uint64_t mine = 0;
+        uint32_t day = 0;
+        for(std::size_t i=0; i<n; ++i){
+            day = std::max(day,batch[i].Date);
+            // Every worker sees every event; the account hash decides who screens it.
+            if(mix64(batch[i].Account) % Config.Workers != worker)continue;
+            Screen(batch[i]);
+            ++mine;
+        }
+        if(mine) Events.fetch_add(mine,std::memory_order_relaxed);
+        if(n) Advance(worker,day);
+        if(n == 0){
+            if(stopping)break;
+            std::this_thread::yield();
+        }
+    }
+}
+
+void ScreeningPipeline::Screen(const TransactionEvent &e) {
+    using Type = Account::TransactionTypes;
+    if(e.Type != Type::Withdraw && e.Type != Type::TransferOut)return;
+
+    const long double before = e.BalanceAfter + e.Amount;
+    if(before >= Config.DrainMinimum && e.Amount >= before * Config.DrainFraction)
+        Raise(ScreeningAlert::Kind::BalanceDrain,e,e.Destination);
+
+    if(e.Type != Type::TransferOut || e.Destination == 0 || e.Destination == e.Account)return;
+
+    if(e.Amount <= Config.SmallTransfer){
+        bool fan_out = Accounts.Update({e.Account,e.Date},[&](AccountState& s){
+            s.Day = e.Date;
+            ++s.SmallTransfers;
+            if(s.FanOutFlagged)return false;
+            const auto h = static_cast<uint32_t>(mix64(e.Destination));
+            if(std::find(s.Destinations,s.Destinations + s.DistinctDestinations,h) == s.Destinations + s.DistinctDestinations)
+                s.Destinations[s.DistinctDestinations++] = h;
+            if(s.DistinctDestinations < Config.FanOutDestinations)return false;
+            s.FanOutFlagged = true;
+            return true;
+        });
+        if(fan_out) Raise(ScreeningAlert::Kind::FanOut,e,0);
+    }
+
+    // Both directions of a pair land in one entry, whichever worker screens them.
+    const bool forward = e.Account < e.Destination;
+    const PairKey key = forward ? PairKey{e.Account,e.Destination,e.Date} : PairKey{e.Destination,e.Account,e.Date};
+    bool round_trip = Pairs.Update(key,[&](PairState& p){
+        p.Day = e.Date;
+        ++(forward ? p.Forward : p.Backward);
+        if(p.Flagged || p.Forward == 0 || p.Backward == 0)return false;
+        p.Flagged = true;
+        return true;
+    });
+    if(round_trip) Raise(ScreeningAlert::Kind::RoundTrip,e,e.Destination);
+}
+
+void ScreeningPipeline::Raise(ScreeningAlert::Kind kind, const TransactionEvent &e, uint64_t counterparty) {
+    AlertCounts[static_cast<int>(kind)].fetch_add(1,std::memory_order_relaxed);
+    std::lock_guard<std::mutex> g(AlertsLock);
+    Alerts.push_back(ScreeningAlert{kind,e.Account,counterparty,e.Date,e.Sequence,e.Amount});
+}
+
+void ScreeningPipeline::Advance(std::size_t worker, uint32_t day) {
+    if(day <= WorkerDays[worker].load(std::memory_order_relaxed))return;
+    WorkerDays[worker].store(day,std::memory_order_release);
+    // A worker still on an earlier day may yet pair an event with state from that day.
+    uint32_t low = day;
+    for(const auto& d : WorkerDays) low = std::min(low,d.load(std::memory_order_acquire));
+    uint32_t done = ExpiredBefore.load(std::memory_order_relaxed);
+    while(low > done){
+        if(ExpiredBefore.compare_exchange_weak(done,low,std::memory_order_relaxed)){
+            Expire(low);
+            break;
+        }
+    }
+}
+
+void ScreeningPipeline::Expire(uint32_t day) {
+    std::size_t n = Accounts.EraseIf([day](const AccountState& s){ return s.Day < day; });
+    n += Pairs.EraseIf([day](const PairState& p){ return p.Day < day; });
+    if(n) Expired.fetch_add(n,std::memory_order_relaxed);
+}
+
+std::vector<ScreeningAlert> ScreeningPipeline::TakeAlerts() {
+    std::lock_guard<std::mutex> g(AlertsLock);
+    std::vector<ScreeningAlert> out;
+    out.swap(Alerts);
+    return out;
+}
+
+ScreeningPipeline::Stats ScreeningPipeline::GetStats() const {
+    Stats s;
+    s.Events = Events.load(std::memory_order_relaxed);
+    for(int i=0; i<3; ++i) s.Alerts[i] = AlertCounts[i].load(std::memory_order_relaxed);
+    s.TrackedAccounts = Accounts.Size();
+    s.TrackedPairs = Pairs.Size();
+    s.Expired = Expired.load(std::memory_order_relaxed);
+    return s;
+}
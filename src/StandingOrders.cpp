@@ -0,0 +1,257 @@
+#include "StandingOrders.h"
+#include "Bank Management.h"
+#include "Utils.h"
+#include <algorithm>
+#include <chrono>
+#include <thread>
+
+
+
+static uint64_t now_ns(){
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+static bool valid_account_number(const string& s){
+    return s.size() == 10 && is_Digit(s);
+}
+
+StandingOrders::OrderId StandingOrders::AddTransfer(const string &source, const string &destination, long double amount,
+                                                    const Account::Date &first, StandingOrders::Frequency freq,
+                                                    uint16_t every, const Account::Date *until, string *err) {
+    if(!valid_account_number(source) || !valid_account_number(destination)){
+        if(err) *err = "Error! AccountNumber must be 10 digits.";
+        return NoOrder;
+    }
+    if(source == destination){
+        if(err) *err = "Error! AccountNumber is same as Destination.";
+        return NoOrder;
+    }
+    Order o{};
+    o.Source = pack_account_number(source);
+    o.Destination = pack_account_number(destination);
+    o.Amount = amount;
+    o.Every = every;
+    o.Freq = freq;
+    return Add(o,first,until,err);
+}
+
+StandingOrders::OrderId StandingOrders::AddDeposit(const string &account, long double amount, const Account::Date &first,
+                                                   StandingOrders::Frequency freq, uint16_t every,
+                                                   const Account::Date *until, string *err) {
+    if(!valid_account_number(account)){
+        if(err) *err = "Error! AccountNumber must be 10 digits.";
+        return NoOrder;
+    }
+    Order o{};
+    o.Destination = pack_account_number(account);
+    o.Amount = amount;
+    o.Every = every;
+    o.Freq = freq;
+    o.Deposit = true;
+    return Add(o,first,until,err);
+}
+
+StandingOrders::OrderId StandingOrders::Add(StandingOrders::Order o, const Account::Date &first,
+                                            const Account::Date *until, string *err) {
+    auto fail = [&](const char* msg){
+        if(err) *err = msg;
+        return NoOrder;
+    };
+    if(!is_finite_ld(o.Amount) || o.Amount <= 0.0L)return fail("Error! the amount must be finite positive number.");
+    if(o.Every == 0)return fail("Error! interval must be at least 1.");
+    if(!is_Digit(first.day) || !is_Digit(first.month) || !is_Digit(first.year))return fail("Error! first date must be digits only.");
+    const unsigned day = parse_digits(first.day),month = parse_digits(first.month);
+    const int year = static_cast<int>(parse_digits(first.year));
+    if(month < 1 || month > 12 || day < 1 || static_cast<int>(day) > days_in_month(static_cast<int>(month),year))
+        return fail("Error! first date is not a valid date.");
+    if(Orders.size() >= UINT32_MAX - 1)return fail("Error! too many standing orders.");
+
+    o.Next = days_from_civil(year,month,day);
+    o.Until = until ? date_to_days(*until) : INT32_MAX;
+    if(o.Until < o.Next)return fail("Error! end date is before the first run.");
+    o.Anchor = static_cast<uint8_t>(day);
+    o.Active = true;
+
+    Orders.push_back(o);
+    const auto id = static_cast<OrderId>(Orders.size());
+    // Days up to LastRun have run; an order starting before the wheel's first day but
+    // after them pulls the wheel back, or it would wait for Current.
+    const int32_t start = LastRun == INT32_MIN ? o.Next : std::max(o.Next,LastRun + 1);
+    if(Current == INT32_MIN || start < Current) Rebase(start);
+    Schedule(id);
+    ++ActiveOrders;
+    if(err) err->clear();
+    return id;
+}
+
+bool StandingOrders::Cancel(StandingOrders::OrderId id, string *err) {
+    if(id == NoOrder || id > Orders.size() || !Orders[id - 1].Active){
+        if(err) *err = "Error! standing order not found.";
+        return false;
+    }
+    // Stays in its wheel slot and is dropped when that day comes.
+    Orders[id - 1].Active = false;
+    --ActiveOrders;
+    if(err) err->clear();
+    return true;
+}
+
+size_t StandingOrders::Size() const {
+    return ActiveOrders;
+}
+
+int32_t StandingOrders::NextRun(StandingOrders::OrderId id) const {
+    if(id == NoOrder || id > Orders.size() || !Orders[id - 1].Active)return INT32_MIN;
+    return Orders[id - 1].Next;
+}
+
+void StandingOrders::Schedule(StandingOrders::OrderId id) {
+    const int32_t day = std::max(Orders[id - 1].Next,Current);
+    const int32_t block = day >> 8,current_block = Current >> 8;
+    if(block == current_block) Near[day & (Slots - 1)].push_back(id);
+    else if(block - current_block < static_cast<int32_t>(Slots)) Far[block & (Slots - 1)].push_back(id);
+    else Overflow.push_back(id);
+}
+
+void StandingOrders::Rebase(int32_t day) {
+    Cascade.clear();
+    for(auto& slot : Near){
+        Cascade.insert(Cascade.end(),slot.begin(),slot.end());
+        slot.clear();
+    }
+    for(auto& slot : Far){
+        Cascade.insert(Cascade.end(),slot.begin(),slot.end());
+        slot.clear();
+    }
+    Cascade.insert(Cascade.end(),Overflow.begin(),Overflow.end());
+    Overflow.clear();
+    Current = day;
+    for(OrderId id : Cascade) Schedule(id);
+    Cascade.clear();
+}
+
+void StandingOrders::Advance(int32_t today, vector<OrderId> &due) {
+    if(LastRun == INT32_MIN || today > LastRun) LastRun = today;
+    if(Current == INT32_MIN)return;
+    for(int32_t d=Current; d<=today; ++d){
+        Current = d;
+        if((d & (Slots - 1)) == 0){
+            // Entering a new block: bring its orders down from the far wheel, and every
+            // 256 blocks re-sort the overflow list.
+            if(((d >> 8) & (Slots - 1)) == 0){
+                Cascade.swap(Overflow);
+                for(OrderId id : Cascade) Schedule(id);
+                Cascade.clear();
+            }
+            Cascade.swap(Far[(d >> 8) & (Slots - 1)]);
+            for(OrderId id : Cascade) Schedule(id);
+            Cascade.clear();
+        }
+        auto& slot = Near[d & (Slots - 1)];
+        due.insert(due.end(),slot.begin(),slot.end());
+        slot.clear();
+    }
+    if(today >= Current) Current = today + 1;
+}
+
+int32_t StandingOrders::Following(const StandingOrders::Order &o) const {
+    switch(o.Freq){
+        case Frequency::Daily: return o.Next + o.Every;
+        case Frequency::Weekly: return o.Next + 7 * o.Every;
+        case Frequency::Monthly:
+        case Frequency::Yearly:{
+            int y;
+            unsigned m,d;
+            civil_from_days(o.Next,y,m,d);
+            int months = static_cast<int>(m) - 1 + (o.Freq == Frequency::Monthly ? o.Every : 12 * o.Every);
+            y += months / 12;
+            m = static_cast<unsigned>(months % 12) + 1;
+            d = std::min<unsigned>(o.Anchor,static_cast<unsigned>(days_in_month(static_cast<int>(m),y)));
+            return days_from_civil(y,m,d);
+        }
+    }
+    return INT32_MAX;
+}
+
+bool StandingOrders::RunDue(Management &bank, const Account::Date &today, size_t threads,
+                            StandingOrders::RunStats *stats, vector<Result> *results, string *err) {
+    if(!is_Digit(today.day) || !is_Digit(today.month) || !is_Digit(today.year)){
+        if(err) *err = "Error! date must be digits only.";
+        return false;
+    }
+    RunStats st;
+    const int32_t day = date_to_days(today);
+
+    uint64_t t0 = now_ns();
+    Due.clear();
+    Advance(day,Due);
+    // Slots fill in id order except after a cascade; cancelled orders are dropped below.
+    if(!std::is_sorted(Due.begin(),Due.end())) std::sort(Due.begin(),Due.end());
+    st.FindNs = now_ns() - t0;
+
+    // Read-only against the bank, so it can be split across threads.
+    t0 = now_ns();
+    if(Work.size() < Due.size()) Work.resize(Due.size());
+    auto prepare = [&](size_t begin,size_t end){
+        for(size_t i=begin; i<end; ++i){
+            const Order& o = Orders[Due[i] - 1];
+            Prepared& p = Work[i];
+            p.Cancelled = !o.Active;
+            if(p.Cancelled)continue;
+            p.Destination = unpack_account_number(o.Destination);
+            const Account* dst = bank.GetAccount(p.Destination);
+            p.Runnable = dst && !dst->is_closed();
+            if(!o.Deposit){
+                p.Source = unpack_account_number(o.Source);
+                const Account* src = bank.GetAccount(p.Source);
+                p.Runnable = p.Runnable && src && !src->is_closed();
+            }
+        }
+    };
+    threads = std::max<size_t>(1,std::min(threads,Due.size() / 4096));
+    if(threads == 1) prepare(0,Due.size());
+    else{
+        vector<std::thread> workers;
+        for(size_t t=0; t<threads; ++t)
+            workers.emplace_back(prepare,Due.size() * t / threads,Due.size() * (t + 1) / threads);
+        for(auto& w : workers) w.join();
+    }
+    st.PrepareNs = now_ns() - t0;
+
+    t0 = now_ns();
+    if(results) results->reserve(results->size() + Due.size());
+    for(size_t i=0; i<Due.size(); ++i){
+        Order& o = Orders[Due[i] - 1];
+        const Prepared& p = Work[i];
+        if(p.Cancelled)continue;
+        // When days were skipped, every occurrence up to today runs now, booked on today.
+        do{
+            ++st.Due;
+            bool ok = false;
+            if(!p.Runnable) ++st.Skipped;
+            else{
+                ok = o.Deposit ? bank.DepositAccount(p.Destination,o.Amount,today)
+                               : bank.TransferBetweenAccounts(p.Source,p.Destination,o.Amount,today);
+                ++(ok ? st.Executed : st.Failed);
+            }
+            if(results) results->push_back(Result{Due[i],ok});
+            o.Next = Following(o);
+        } while(o.Next <= day && o.Next <= o.Until);
+    }
+    for(OrderId id : Due){
+        Order& o = Orders[id - 1];
+        if(!o.Active)continue;
+        if(o.Next > o.Until){
+            o.Active = false;
+            --ActiveOrders;
+            ++st.Finished;
+        }
+        else Schedule(id);
+    }
+    st.ApplyNs = now_ns() - t0;
+
+    if(stats) *stats = st;
+    if(err) err->clear();
+    return true;
+}
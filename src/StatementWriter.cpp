@@ -0,0 +1,220 @@
+#include "StatementWriter.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <charconv>
+#include <cmath>
+#include <cstring>
+
+#include <sys/uio.h>
+#include <unistd.h>
+
+
+
+char *StatementBuffer::Reserve(std::size_t n) {
+    if(Used + n > Bytes.size()) Bytes.resize(std::max(Bytes.size() * 2,Used + n + 4096));
+    return Bytes.data() + Used;
+}
+
+void StatementBuffer::Append(const char *p, std::size_t n) {
+    std::memcpy(Reserve(n),p,n);
+    Used += n;
+}
+
+void StatementBuffer::Append(const string &s) {
+    Append(s.data(),s.size());
+}
+
+void StatementBuffer::Append(const char *s) {
+    Append(s,std::strlen(s));
+}
+
+void StatementBuffer::Append(char c) {
+    *Reserve(1) = c;
+    ++Used;
+}
+
+void StatementBuffer::AppendUnsigned(unsigned long long v) {
+    char* p = Reserve(20);
+    Used = static_cast<std::size_t>(std::to_chars(p,p + 20,v).ptr - Bytes.data());
+}
+
+void StatementBuffer::AppendMoney(long double v) {
+    constexpr std::size_t cap = 64;
+    char* p = Reserve(cap);
+    // Integer cents keep the common case off the long double formatting path.
+    if(v > -1e15L && v < 1e15L){
+        long long cents = std::llround(v * 100.0L);
+        if(cents < 0){
+            *p++ = '-';
+            cents = -cents;
+        }
+        p = std::to_chars(p,p + 20,cents / 100).ptr;
+        *p++ = '.';
+        *p++ = static_cast<char>('0' + cents % 100 / 10);
+        *p++ = static_cast<char>('0' + cents % 10);
+        Used = static_cast<std::size_t>(p - Bytes.data());
+        return;
+    }
+    auto res = std::to_chars(p,p + cap,v,std::chars_format::fixed,2);
+    if(res.ec != std::errc()){
+        res = std::to_chars(p,p + cap,v,std::chars_format::scientific);
+    }
+    Used = static_cast<std::size_t>(res.ptr - Bytes.data());
+}
+
+void StatementBuffer::AppendDate(const Account::Date &d, char sep) {
+    Append(d.day);
+    Append(sep);
+    Append(d.month);
+    Append(sep);
+    Append(d.year);
+}
+
+void StatementBuffer::AppendJsonString(const string &s) {
+    Append('"');
+    for(char c : s){
+        if(c == '"' || c == '\\') Append('\\');
+        Append(c);
+    }
+    Append('"');
+}
+
+const char *StatementBuffer::Data() const {
+    return Bytes.data();
+}
+
+std::size_t StatementBuffer::Size() const {
+    return Used;
+}
+
+void StatementBuffer::Clear() {
+    Used = 0;
+}
+
+
+
+StatementWriter::StatementWriter(StatementWriter::Format f) : Fmt(f) {}
+
+StatementWriter::Format StatementWriter::GetFormat() const {
+    return Fmt;
+}
+
+void StatementWriter::FormatHeader(StatementBuffer &out) const {
+    if(Fmt == Format::Csv){
+        static constexpr char header[] = "account,date,type,amount,source,destination,balance_after\n";
+        out.Append(header,sizeof(header) - 1);
+    }
+}
+
+#define LIT(s) s,sizeof(s) - 1
+
+void StatementWriter::FormatAccount(const Account &acc, StatementBuffer &out, const LedgerArchive *archive) const {
+    const string number = acc.GetAccountNumber();
+    const auto& txs = acc.GetTransactions();
+    const uint64_t archived = archive ? acc.GetArchivedCount() : 0;
+    char currency[3];
+    currency_to_chars(acc.GetCurrency(),currency);
+    // Archived entries first, then the ones still in memory: the full history in order.
+    Account::Transaction unpacked;
+    auto for_each = [&](auto&& fn){
+        if(archived){
+            archive->ForEach(number,[&](const PackedTransaction& p){
+                p.UnpackInto(unpacked);
+                fn(static_cast<const Account::Transaction&>(unpacked));
+            });
+        }
+        for(const auto& t : txs) fn(t);
+    };
+
+    switch (Fmt) {
+        case Format::Text:
+            out.Append(LIT("Account Number:"));out.Append(number);out.Append('\n');
+            out.Append(LIT("Balance:"));out.AppendMoney(acc.GetBalance());out.Append('\n');
+            out.Append(LIT("AccountType:"));out.Append(Account::AccountTypeToString(acc.GetAccountType()));out.Append('\n');
+            out.Append(LIT("Currency:"));out.Append(currency,3);out.Append('\n');
+            out.Append(LIT("Status:"));out.Append(acc.is_closed() ? "Closed" : "Open");out.Append('\n');
+            out.Append(LIT("OpeningsDate:"));out.AppendDate(acc.GetOpeningsDate(),'/');out.Append('\n');
+            out.Append(LIT("Number of Transactions:"));out.AppendUnsigned(archived + txs.size());out.Append('\n');
+            for_each([&](const Account::Transaction& t){
+                out.Append(LIT("Date:"));out.AppendDate(t.trans,'/');out.Append('\n');
+                out.Append(LIT("Amount:"));out.AppendMoney(t.amount);out.Append('\n');
+                out.Append(LIT("Source:"));out.Append(t.source);out.Append('\n');
+                out.Append(LIT("Destination:"));out.Append(t.destination);out.Append('\n');
+                out.Append(LIT("TransactionType:"));out.Append(Account::TransactionTypeToString(t.type));out.Append('\n');
+                out.Append(LIT("Updated Balance:"));out.AppendMoney(t.balance_after);out.Append('\n');
+                out.Append(LIT("---\n"));
+            });
+            break;
+
+        case Format::Csv:
+            for_each([&](const Account::Transaction& t){
+                out.Append(number);out.Append(',');
+                out.AppendDate(t.trans,'/');out.Append(',');
+                out.Append(Account::TransactionTypeToString(t.type));out.Append(',');
+                out.AppendMoney(t.amount);out.Append(',');
+                out.Append(t.source);out.Append(',');
+                out.Append(t.destination);out.Append(',');
+                out.AppendMoney(t.balance_after);out.Append('\n');
+            });
+            break;
+
+        case Format::Json:{
+            // One object per line so per-thread buffers concatenate without separators.
+            out.Append(LIT("{\"account\":"));out.AppendJsonString(number);
+            out.Append(LIT(",\"type\":\""));out.Append(Account::AccountTypeToString(acc.GetAccountType()));
+            out.Append(LIT("\",\"currency\":\""));out.Append(currency,3);
+            out.Append(LIT("\",\"status\":\""));out.Append(acc.is_closed() ? "Closed" : "Open");
+            out.Append(LIT("\",\"opened\":\""));out.AppendDate(acc.GetOpeningsDate(),'/');
+            out.Append(LIT("\",\"balance\":"));out.AppendMoney(acc.GetBalance());
+            out.Append(LIT(",\"transactions\":["));
+            bool first = true;
+            for_each([&](const Account::Transaction& t){
+                if(!first) out.Append(',');
+                first = false;
+                out.Append(LIT("{\"date\":\""));out.AppendDate(t.trans,'/');
+                out.Append(LIT("\",\"type\":\""));out.Append(Account::TransactionTypeToString(t.type));
+                out.Append(LIT("\",\"amount\":"));out.AppendMoney(t.amount);
+                out.Append(LIT(",\"source\":"));out.AppendJsonString(t.source);
+                out.Append(LIT(",\"destination\":"));out.AppendJsonString(t.destination);
+                out.Append(LIT(",\"balance_after\":"));out.AppendMoney(t.balance_after);
+                out.Append('}');
+            });
+            out.Append(LIT("]}\n"));
+            break;
+        }
+    }
+}
+
+#undef LIT
+
+bool StatementWriter::WriteBuffers(int fd, const std::vector<StatementBuffer> &buffers, string *err) {
+    std::vector<iovec> iov;
+    iov.reserve(buffers.size());
+    for(const auto& b : buffers){
+        if(b.Size() == 0)continue;
+        iov.push_back(iovec{const_cast<char*>(b.Data()),b.Size()});
+    }
+
+    std::size_t first = 0;
+    while(first < iov.size()){
+        int count = static_cast<int>(std::min<std::size_t>(iov.size() - first,IOV_MAX));
+        ssize_t n = ::writev(fd,iov.data() + first,count);
+        if(n < 0){
+            if(errno == EINTR)continue;
+            if(err) *err = string("Error! writev failed: ") + std::strerror(errno);
+            return false;
+        }
+        auto left = static_cast<std::size_t>(n);
+        while(first < iov.size() && left >= iov[first].iov_len){
+            left -= iov[first].iov_len;
+            ++first;
+        }
+        if(left){
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+    if(err) err->clear();
+    return true;
+}
@@ -0,0 +1,208 @@
+#include "Trace.h"
+#include "Utils.h"
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+
+
+static constexpr char TraceMagic[8] = {'B','A','N','K','T','R','C','2'};
+static constexpr size_t TraceVersionAt = 7;
+static constexpr size_t FlushBytes = size_t{1} << 20;
+
+struct TraceRecordHeader{
+    uint8_t Kind;
+    uint8_t Ok;
+    uint8_t Type;
+    uint8_t Strings;
+    uint32_t Date;
+    uint64_t AccountNumber;
+    uint64_t Counterparty;
+    uint32_t CurrencyCode;      // version 2; padding before Amount in version 1
+    uint32_t Reserved;
+    long double Amount;
+};
+static_assert(sizeof(TraceRecordHeader) == 48,"trace records are 48 bytes");
+
+const char *TraceOp::KindToString(TraceOp::Kind k) {
+    switch(k){
+        case Kind::AddPerson: return "AddPerson";
+        case Kind::Open: return "OpenAccount";
+        case Kind::Close: return "CloseAccount";
+        case Kind::Deposit: return "DepositAccount";
+        case Kind::Withdraw: return "WithdrawFromAccount";
+        case Kind::Transfer: return "TransferBetweenAccounts";
+        case Kind::Interest: return "ApplyMonthlyInterest";
+        case Kind::Balance: return "Balance";
+        case Kind::Count: break;
+    }
+    return "Unknown";
+}
+
+void TraceOp::PersonToStrings(const Person &p, vector<string> &out) {
+    const Person::BirthDate& b = p.GetBirthDate();
+    out = {p.GetName(),p.GetFamilyName(),p.GetNationality(),p.GetIdCode(),p.IsMale() ? "1" : "2",b.day,b.month,b.year};
+}
+
+bool TraceOp::PersonFromStrings(const vector<string> &in, Person &out, string *err) {
+    if(in.size() != PersonFields){
+        if(err) *err = "Error! trace record has no person.";
+        return false;
+    }
+    out = Person();
+    string e;
+    auto fail = [&]{
+        if(err) *err = e;
+        return false;
+    };
+    if(!in[0].empty() && !out.SetName(in[0],&e))return fail();
+    if(!in[1].empty() && !out.SetFamilyName(in[1],&e))return fail();
+    if(!in[2].empty() && !out.SetNationality(in[2],&e))return fail();
+    if(!out.SetIdCode(in[3],&e))return fail();
+    if(!out.SetGender(in[4],&e))return fail();
+    if(!in[7].empty() && !out.SetBirthday(in[5],in[6],in[7],&e))return fail();
+    if(err) err->clear();
+    return true;
+}
+
+TraceRecorder::~TraceRecorder() {
+    Close();
+}
+
+bool TraceRecorder::Open(const string &path, string *err) {
+    if(Fd >= 0){
+        if(err) *err = "Error! trace is already open.";
+        return false;
+    }
+    Fd = open(path.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,0644);
+    if(Fd < 0){
+        if(err) *err = "Error! cannot open trace: " + string(strerror(errno));
+        return false;
+    }
+    Buffer.reserve(FlushBytes + 4096);
+    Buffer.insert(Buffer.end(),TraceMagic,TraceMagic + sizeof(TraceMagic));
+    Count = 0;
+    Failed = false;
+    if(err) err->clear();
+    return true;
+}
+
+void TraceRecorder::Record(const TraceOp &op) {
+    if(Fd < 0)return;
+    TraceRecordHeader h{static_cast<uint8_t>(op.Op),static_cast<uint8_t>(op.Ok),static_cast<uint8_t>(op.Type),
+                        static_cast<uint8_t>(std::min<size_t>(op.Strings.size(),UINT8_MAX)),
+                        op.Date,op.AccountNumber,op.Counterparty,op.CurrencyCode,0,op.Amount};
+    const char* p = reinterpret_cast<const char*>(&h);
+    Buffer.insert(Buffer.end(),p,p + sizeof(h));
+    for(size_t i=0; i<h.Strings; ++i){
+        const string& s = op.Strings[i];
+        const auto len = static_cast<uint8_t>(std::min<size_t>(s.size(),UINT8_MAX));
+        Buffer.push_back(static_cast<char>(len));
+        Buffer.insert(Buffer.end(),s.data(),s.data() + len);
+    }
+    ++Count;
+    if(Buffer.size() >= FlushBytes) Flush();
+}
+
+bool TraceRecorder::Flush(string *err) {
+    if(Fd < 0){
+        if(err) *err = "Error! trace is not open.";
+        return false;
+    }
+    size_t done = 0;
+    while(done < Buffer.size() && !Failed){
+        ssize_t w = write(Fd,Buffer.data() + done,Buffer.size() - done);
+        if(w < 0 && errno == EINTR)continue;
+        if(w <= 0){
+            Failed = true;
+            Error = "Error! cannot write trace: " + string(strerror(errno));
+            break;
+        }
+        done += static_cast<size_t>(w);
+    }
+    Buffer.clear();
+    if(err) *err = Failed ? Error : string();
+    return !Failed;
+}
+
+bool TraceRecorder::Close(string *err) {
+    if(Fd < 0){
+        if(err) err->clear();
+        return true;
+    }
+    bool ok = Flush(err);
+    if(ok && fsync(Fd) != 0){
+        if(err) *err = "Error! cannot sync trace: " + string(strerror(errno));
+        ok = false;
+    }
+    close(Fd);
+    Fd = -1;
+    return ok;
+}
+
+uint64_t TraceRecorder::Recorded() const {
+    return Count;
+}
+
+bool ReadTrace(const string &path, vector<TraceOp> &out, string *err) {
+    int fd = open(path.c_str(),O_RDONLY | O_CLOEXEC);
+    if(fd < 0){
+        if(err) *err = "Error! cannot open trace: " + string(strerror(errno));
+        return false;
+    }
+    vector<char> data;
+    char chunk[1 << 16];
+    for(ssize_t n; (n = read(fd,chunk,sizeof(chunk))) != 0; ){
+        if(n < 0 && errno == EINTR)continue;
+        if(n < 0){
+            if(err) *err = "Error! cannot read trace: " + string(strerror(errno));
+            close(fd);
+            return false;
+        }
+        data.insert(data.end(),chunk,chunk + n);
+    }
+    close(fd);
+
+    if(data.size() < sizeof(TraceMagic) || memcmp(data.data(),TraceMagic,TraceVersionAt) != 0 ||
+       (data[TraceVersionAt] != '1' && data[TraceVersionAt] != '2')){
+        if(err) *err = "Error! not a trace file.";
+        return false;
+    }
+    const bool has_currency = data[TraceVersionAt] != '1';
+    out.clear();
+    for(size_t at = sizeof(TraceMagic); at < data.size(); ){
+        TraceRecordHeader h{};
+        if(at + sizeof(h) > data.size()){
+            if(err) *err = "Error! trace ends inside a record.";
+            return false;
+        }
+        memcpy(&h,data.data() + at,sizeof(h));
+        at += sizeof(h);
+        if(h.Kind >= static_cast<uint8_t>(TraceOp::Kind::Count)){
+            if(err) *err = "Error! unknown trace record kind.";
+            return false;
+        }
+        TraceOp op;
+        op.Op = static_cast<TraceOp::Kind>(h.Kind);
+        op.Ok = h.Ok != 0;
+        op.Type = static_cast<Account::AccountType>(h.Type);
+        op.Date = h.Date;
+        op.Amount = h.Amount;
+        op.AccountNumber = h.AccountNumber;
+        op.Counterparty = h.Counterparty;
+        if(has_currency) op.CurrencyCode = h.CurrencyCode;
+        for(uint8_t i=0; i<h.Strings; ++i){
+            const size_t len = at < data.size() ? static_cast<uint8_t>(data[at]) : 0;
+            if(at + 1 + len > data.size()){
+                if(err) *err = "Error! trace ends inside a record.";
+                return false;
+            }
+            op.Strings.emplace_back(data.data() + at + 1,len);
+            at += 1 + len;
+        }
+        out.push_back(std::move(op));
+    }
+    if(err) err->clear();
+    return true;
+}
@@ -0,0 +1,142 @@
+#include "TransactionStream.h"
+#include "Utils.h"
+#include <stdexcept>
+#include <thread>
+
+
+
+static std::size_t round_up_pow2(std::size_t n){
+    std::size_t p = 1;
+    while(p < n) p <<= 1;
+    return p;
+}
+
+TransactionStream::TransactionStream(std::size_t capacity, Backpressure policy, const std::string &spill_path)
+        : Mask(round_up_pow2(capacity < 2 ? 2 : capacity) - 1),Policy_(policy),Ring(new Slot[Mask + 1]) {
+    if(policy == Backpressure::Spill){
+        if(spill_path.empty())throw std::runtime_error("TransactionStream: spill policy needs a file path");
+        SpillFile = std::fopen(spill_path.c_str(),"ab");
+        if(!SpillFile)throw std::runtime_error("TransactionStream: cannot open spill file " + spill_path);
+    }
+}
+
+TransactionStream::~TransactionStream() {
+    if(SpillFile) std::fclose(SpillFile);
+}
+
+uint64_t TransactionStream::MinCursor(uint64_t head) const {
+    uint64_t min = head;
+    for(const auto& c : Consumers){
+        uint64_t next = c.Next.load(std::memory_order_acquire);
+        if(next < min) min = next;
+    }
+    return min;
+}
+
+bool TransactionStream::Claim(uint64_t &pos) {
+    const uint64_t capacity = Mask + 1;
+    uint64_t head = Head.load(std::memory_order_relaxed);
+    for(;;){
+        uint64_t gate = GateCache.load(std::memory_order_relaxed);
+        if(gate > head || head - gate >= capacity){
+            gate = MinCursor(head);
+            GateCache.store(gate,std::memory_order_relaxed);
+            if(head - gate >= capacity){
+                if(Policy_ != Backpressure::Block)return false;
+                std::this_thread::yield();
+                head = Head.load(std::memory_order_relaxed);
+                continue;
+            }
+        }
+        if(Head.compare_exchange_weak(head,head + 1,std::memory_order_acq_rel,std::memory_order_relaxed)){
+            pos = head;
+            return true;
+        }
+    }
+}
+
+void TransactionStream::SpillEvent(const TransactionEvent &ev) {
+    std::lock_guard<std::mutex> g(SpillLock);
+    std::fwrite(&ev,sizeof(ev),1,SpillFile);
+}
+
+void TransactionStream::Publish(const Account &acc, const Account::Transaction &t) {
+    TransactionEvent ev;
+    ev.Account = pack_account_number(acc.GetAccountNumber());
+    ev.Source = pack_account_number(t.source);
+    ev.Destination = pack_account_number(t.destination);
+    ev.Amount = t.amount;
+    ev.BalanceAfter = t.balance_after;
+    ev.Date = pack_date(t.trans);
+    ev.Type = t.type;
+
+    uint64_t pos;
+    if(!Claim(pos)){
+        PendingLost.fetch_add(1,std::memory_order_relaxed);
+        if(Policy_ == Backpressure::Spill){
+            ev.Sequence = Head.load(std::memory_order_relaxed);
+            SpillEvent(ev);
+            Spilled.fetch_add(1,std::memory_order_relaxed);
+        }
+        else{
+            Dropped.fetch_add(1,std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    // The sequence is the claimed position, so it follows the order consumers read in.
+    ev.Sequence = pos;
+    ev.Lost = PendingLost.load(std::memory_order_relaxed) ? PendingLost.exchange(0,std::memory_order_relaxed) : 0;
+    Slot& s = Ring[pos & Mask];
+    s.Event = ev;
+    s.Ready.store(pos + 1,std::memory_order_release);
+}
+
+int TransactionStream::Subscribe() {
+    for(std::size_t i=0; i<MaxConsumers; ++i){
+        uint64_t unused = UINT64_MAX;
+        if(Consumers[i].Next.compare_exchange_strong(unused,Head.load(std::memory_order_acquire)))
+            return static_cast<int>(i);
+    }
+    return -1;
+}
+
+void TransactionStream::Unsubscribe(int consumer) {
+    Consumers[consumer].Next.store(UINT64_MAX,std::memory_order_release);
+}
+
+std::size_t TransactionStream::Poll(int consumer, TransactionEvent *out, std::size_t max) {
+    std::atomic<uint64_t>& cursor = Consumers[consumer].Next;
+    const uint64_t next = cursor.load(std::memory_order_relaxed);
+    std::size_t n = 0;
+    while(n < max){
+        const Slot& s = Ring[(next + n) & Mask];
+        if(s.Ready.load(std::memory_order_acquire) != next + n + 1)break;
+        out[n] = s.Event;
+        ++n;
+    }
+    if(n) cursor.store(next + n,std::memory_order_release);
+    return n;
+}
+
+uint64_t TransactionStream::Lag(int consumer) const {
+    uint64_t next = Consumers[consumer].Next.load(std::memory_order_acquire);
+    uint64_t head = Head.load(std::memory_order_acquire);
+    return next > head ? 0 : head - next;
+}
+
+TransactionStream::Stats TransactionStream::GetStats() const {
+    Stats s;
+    s.Dropped = Dropped.load(std::memory_order_relaxed);
+    s.Spilled = Spilled.load(std::memory_order_relaxed);
+    s.Published = Head.load(std::memory_order_relaxed) + s.Dropped + s.Spilled;
+    return s;
+}
+
+std::size_t TransactionStream::Capacity() const {
+    return Mask + 1;
+}
+
+TransactionStream::Backpressure TransactionStream::Policy() const {
+    return Policy_;
+}
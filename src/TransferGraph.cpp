@@ -0,0 +1,283 @@
+#include "TransferGraph.h"
+#include "Utils.h"
+#include <thread>
+
+
+
+static inline int64_t to_cents(long double amount){
+    return std::llround(amount * 100.0L);
+}
+
+void TransferGraph::MergeRow(vector<TransferGraph::Edge> &row) {
+    if(row.empty())return;
+    sort(row.begin(),row.end(),[](const auto& a,const auto& b){ return a.Vertex < b.Vertex; });
+    size_t w = 0;
+    for(size_t r=1; r<row.size(); ++r){
+        if(row[r].Vertex == row[w].Vertex){
+            row[w].Cents += row[r].Cents;
+            row[w].Transfers += row[r].Transfers;
+        }
+        else row[++w] = row[r];
+    }
+    row.resize(w + 1);
+}
+
+bool TransferGraph::Build(const vector<const Account *> &accounts, const Account::Date &from,
+                          const Account::Date &to, size_t threads, const LedgerArchive *archive, string *err) {
+    const uint32_t lo = pack_date(from),hi = pack_date(to);
+    if(lo == 0 || hi == 0 || lo > hi){
+        if(err) *err = "Error! invalid date range.";
+        return false;
+    }
+
+    vector<pair<uint64_t,const Account*>> order;
+    order.reserve(accounts.size());
+    const Currency currency = accounts.empty() ? Currency{} : accounts.front()->GetCurrency();
+    for(const Account* acc : accounts){
+        if(acc->GetCurrency() != currency){
+            if(err) *err = "Error! accounts have different currencies; build one graph per currency.";
+            return false;
+        }
+        uint64_t packed = pack_account_number(acc->GetAccountNumber());
+        if(packed) order.emplace_back(packed,acc);
+    }
+    if(order.size() > UINT32_MAX){
+        if(err) *err = "Error! too many accounts for a transfer graph.";
+        return false;
+    }
+    sort(order.begin(),order.end(),[](const auto& a,const auto& b){ return a.first < b.first; });
+
+    const size_t vertices = order.size();
+    CurrencyCode = currency;
+    Numbers.resize(vertices);
+    NumberLength.resize(vertices);
+    for(size_t v=0; v<vertices; ++v){
+        Numbers[v] = order[v].first;
+        NumberLength[v] = static_cast<uint8_t>(order[v].second->GetAccountNumber().size());
+    }
+
+    if(threads == 0) threads = 1;
+    threads = min(threads,max<size_t>(1,vertices));
+
+    // Each thread owns a contiguous vertex range, so its rows are already in CSR order.
+    struct Part{
+        vector<uint32_t> Degree;
+        vector<Edge> Edges;
+        uint64_t Transfers{},Unresolved{};
+    };
+    vector<Part> parts(threads);
+    auto build_part = [&](size_t t){
+        Part& part = parts[t];
+        const size_t begin = vertices * t / threads,end = vertices * (t + 1) / threads;
+        part.Degree.reserve(end - begin);
+        vector<Edge> row;
+        auto add = [&](uint32_t day,uint64_t destination,int64_t cents){
+            if(day < lo || day > hi)return;
+            int64_t dst = VertexOf(destination);
+            if(dst < 0){
+                ++part.Unresolved;
+                return;
+            }
+            row.push_back(Edge{static_cast<uint32_t>(dst),1,cents});
+            ++part.Transfers;
+        };
+        for(size_t v=begin; v<end; ++v){
+            row.clear();
+            const Account& acc = *order[v].second;
+            // Archived entries stay packed; segments outside the range are skipped unread.
+            if(archive && acc.GetArchivedCount()){
+                archive->ForEachOverlapping(acc.GetAccountNumber(),lo,hi,[&](const PackedTransaction& p){
+                    if(p.Type == Account::TransactionTypes::TransferOut) add(p.Date,p.Destination,p.Cents);
+                });
+            }
+            for(const auto& tx : acc.GetTransactions()){
+                if(tx.type != Account::TransactionTypes::TransferOut)continue;
+                add(pack_date(tx.trans),pack_account_number(tx.destination),to_cents(tx.amount));
+            }
+            MergeRow(row);
+            part.Degree.push_back(static_cast<uint32_t>(row.size()));
+            part.Edges.insert(part.Edges.end(),row.begin(),row.end());
+        }
+    };
+    vector<thread> workers;
+    for(size_t t=1; t<threads; ++t) workers.emplace_back(build_part,t);
+    build_part(0);
+    for(auto& w : workers) w.join();
+
+    Out.Offsets.assign(vertices + 1,0);
+    Out.Edges.clear();
+    Transfers = UnresolvedTransfers = 0;
+    size_t v = 0;
+    for(Part& part : parts){
+        for(uint32_t d : part.Degree){
+            Out.Offsets[v + 1] = Out.Offsets[v] + d;
+            ++v;
+        }
+        Out.Edges.insert(Out.Edges.end(),part.Edges.begin(),part.Edges.end());
+        Transfers += part.Transfers;
+        UnresolvedTransfers += part.Unresolved;
+        part = Part{};
+    }
+    Transpose();
+    if(err) err->clear();
+    return true;
+}
+
+void TransferGraph::Transpose() {
+    const size_t vertices = Numbers.size();
+    In.Offsets.assign(vertices + 1,0);
+    for(const Edge& e : Out.Edges) ++In.Offsets[e.Vertex + 1];
+    for(size_t v=0; v<vertices; ++v) In.Offsets[v + 1] += In.Offsets[v];
+
+    In.Edges.resize(Out.Edges.size());
+    vector<uint64_t> next(In.Offsets.begin(),In.Offsets.end() - 1);
+    // Sources are visited in ascending order, so every incoming row comes out sorted.
+    for(size_t v=0; v<vertices; ++v){
+        for(uint64_t i=Out.Offsets[v]; i<Out.Offsets[v + 1]; ++i){
+            const Edge& e = Out.Edges[i];
+            In.Edges[next[e.Vertex]++] = Edge{static_cast<uint32_t>(v),e.Transfers,e.Cents};
+        }
+    }
+}
+
+int64_t TransferGraph::VertexOf(uint64_t packed) const {
+    if(packed == 0)return -1;
+    auto it = lower_bound(Numbers.begin(),Numbers.end(),packed);
+    if(it == Numbers.end() || *it != packed)return -1;
+    return it - Numbers.begin();
+}
+
+int64_t TransferGraph::VertexOf(const string &account) const {
+    return VertexOf(pack_account_number(account));
+}
+
+string TransferGraph::AccountOf(uint32_t vertex) const {
+    return unpack_account_number(Numbers[vertex],NumberLength[vertex]);
+}
+
+size_t TransferGraph::VertexCount() const {
+    return Numbers.size();
+}
+
+size_t TransferGraph::EdgeCount() const {
+    return Out.Edges.size();
+}
+
+uint64_t TransferGraph::TransferCount() const {
+    return Transfers;
+}
+
+Currency TransferGraph::GetCurrency() const {
+    return CurrencyCode;
+}
+
+uint64_t TransferGraph::Unresolved() const {
+    return UnresolvedTransfers;
+}
+
+vector<TransferGraph::Counterparty> TransferGraph::TopCounterparties(const string &account, size_t k,
+                                                                     TransferGraph::Direction dir) const {
+    int64_t v = VertexOf(account);
+    if(v < 0 || k == 0)return {};
+
+    auto row = [&](const Adjacency& adj){
+        return pair<const Edge*,const Edge*>{adj.Edges.data() + adj.Offsets[v],adj.Edges.data() + adj.Offsets[v + 1]};
+    };
+    vector<Edge> candidates;
+    if(dir != Direction::In){
+        auto [b,e] = row(Out);
+        candidates.assign(b,e);
+    }
+    if(dir != Direction::Out){
+        auto [b,e] = row(In);
+        vector<Edge> merged;
+        merged.reserve(candidates.size() + static_cast<size_t>(e - b));
+        // Both rows are sorted by neighbour; add up the neighbours present in both.
+        auto o = candidates.begin();
+        for(; b != e; ++b){
+            while(o != candidates.end() && o->Vertex < b->Vertex) merged.push_back(*o++);
+            if(o != candidates.end() && o->Vertex == b->Vertex){
+                merged.push_back(Edge{b->Vertex,o->Transfers + b->Transfers,o->Cents + b->Cents});
+                ++o;
+            }
+            else merged.push_back(*b);
+        }
+        merged.insert(merged.end(),o,candidates.end());
+        candidates.swap(merged);
+    }
+
+    k = min(k,candidates.size());
+    partial_sort(candidates.begin(),candidates.begin() + static_cast<ptrdiff_t>(k),candidates.end(),
+                 [](const Edge& a,const Edge& b){
+                     return a.Cents != b.Cents ? a.Cents > b.Cents : a.Vertex < b.Vertex;
+                 });
+    vector<Counterparty> out;
+    out.reserve(k);
+    for(size_t i=0; i<k; ++i){
+        const Edge& e = candidates[i];
+        out.push_back(Counterparty{AccountOf(e.Vertex),static_cast<long double>(e.Cents) / 100.0L,e.Transfers});
+    }
+    return out;
+}
+
+TransferGraph::Flow TransferGraph::GroupFlow(const vector<string> &accounts) const {
+    vector<uint32_t> group;
+    for(const auto& a : accounts){
+        int64_t v = VertexOf(a);
+        if(v >= 0) group.push_back(static_cast<uint32_t>(v));
+    }
+    sort(group.begin(),group.end());
+    group.erase(unique(group.begin(),group.end()),group.end());
+
+    int64_t in = 0,out = 0;
+    Flow f;
+    for(uint32_t v : group){
+        for(uint64_t i=Out.Offsets[v]; i<Out.Offsets[v + 1]; ++i){
+            const Edge& e = Out.Edges[i];
+            if(binary_search(group.begin(),group.end(),e.Vertex))continue;
+            out += e.Cents;
+            f.TransfersOut += e.Transfers;
+        }
+        for(uint64_t i=In.Offsets[v]; i<In.Offsets[v + 1]; ++i){
+            const Edge& e = In.Edges[i];
+            if(binary_search(group.begin(),group.end(),e.Vertex))continue;
+            in += e.Cents;
+            f.TransfersIn += e.Transfers;
+        }
+    }
+    f.In = static_cast<long double>(in) / 100.0L;
+    f.Out = static_cast<long double>(out) / 100.0L;
+    return f;
+}
+
+vector<string> TransferGraph::ReachableWithin(const string &account, size_t max_hops,
+                                              TransferGraph::Direction dir) const {
+    int64_t start = VertexOf(account);
+    if(start < 0)return {};
+
+    vector<uint8_t> seen(Numbers.size(),0);
+    seen[start] = 1;
+    vector<uint32_t> frontier{static_cast<uint32_t>(start)},next,found;
+    auto visit = [&](const Adjacency& adj,uint32_t v){
+        for(uint64_t i=adj.Offsets[v]; i<adj.Offsets[v + 1]; ++i){
+            uint32_t n = adj.Edges[i].Vertex;
+            if(seen[n])continue;
+            seen[n] = 1;
+            next.push_back(n);
+        }
+    };
+    for(size_t hop=0; hop<max_hops && !frontier.empty(); ++hop){
+        next.clear();
+        for(uint32_t v : frontier){
+            if(dir != Direction::In) visit(Out,v);
+            if(dir != Direction::Out) visit(In,v);
+        }
+        found.insert(found.end(),next.begin(),next.end());
+        frontier.swap(next);
+    }
+
+    vector<string> out;
+    out.reserve(found.size());
+    for(uint32_t v : found) out.push_back(AccountOf(v));
+    return out;
+}
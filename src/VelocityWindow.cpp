@@ -0,0 +1,68 @@
+#include "VelocityWindow.h"
+#include <cmath>
+
+
+
+static inline std::size_t ring_index(int32_t day){
+    auto d = static_cast<int64_t>(day) % static_cast<int64_t>(VelocityWindow::Days);
+    return static_cast<std::size_t>(d < 0 ? d + static_cast<int64_t>(VelocityWindow::Days) : d);
+}
+
+static inline int64_t to_cents(long double amount){
+    return std::llround(amount * 100.0L);
+}
+
+VelocityWindow::Slot *VelocityWindow::SlotFor(int32_t day, bool create) {
+    Slot& s = Ring[ring_index(day)];
+    if(s.Day == day)return &s;
+    if(!create || (s.Day != INT32_MIN && s.Day > day))return nullptr;
+    s = Slot{};
+    s.Day = day;
+    return &s;
+}
+
+const VelocityWindow::Slot *VelocityWindow::SlotFor(int32_t day) const {
+    const Slot& s = Ring[ring_index(day)];
+    return s.Day == day ? &s : nullptr;
+}
+
+void VelocityWindow::Record(int32_t day, VelocityWindow::Kind kind, long double amount) {
+    if(Slot* s = SlotFor(day,true)){
+        s->Cents[kind] += to_cents(amount);
+        ++s->Count[kind];
+    }
+}
+
+void VelocityWindow::Remove(int32_t day, VelocityWindow::Kind kind, long double amount) {
+    if(Slot* s = SlotFor(day,false)){
+        s->Cents[kind] -= to_cents(amount);
+        if(s->Count[kind]) --s->Count[kind];
+    }
+}
+
+void VelocityWindow::Clear() {
+    for(auto& s : Ring) s = Slot{};
+}
+
+VelocityWindow::Totals VelocityWindow::Today(int32_t day, VelocityWindow::Kind kind) const {
+    Totals t;
+    if(const Slot* s = SlotFor(day)){
+        t.Amount = static_cast<long double>(s->Cents[kind]) / 100.0L;
+        t.Count = s->Count[kind];
+    }
+    return t;
+}
+
+VelocityWindow::Totals VelocityWindow::Rolling(int32_t day, VelocityWindow::Kind kind, std::size_t days) const {
+    if(days > Days) days = Days;
+    int64_t cents = 0;
+    Totals t;
+    for(std::size_t i=0; i<days; ++i){
+        if(const Slot* s = SlotFor(day - static_cast<int32_t>(i))){
+            cents += s->Cents[kind];
+            t.Count += s->Count[kind];
+        }
+    }
+    t.Amount = static_cast<long double>(cents) / 100.0L;
+    return t;
+}